@@ -178,7 +178,7 @@ namespace brep
   }
 
   static int
-  clean_builds (const options&,
+  clean_builds (const options& ops,
                 cli::argv_scanner& scan,
                 odb::pgsql::database& db)
   {
@@ -441,6 +441,22 @@ namespace brep
       return 3;
     }
 
+    // Delete the expired webhook delivery records.
+    //
+    // Note that the deliveries are received at a rate of not more than a few
+    // thousands per hour and so we just delete them all at once.
+    //
+    {
+      using query = query<service_delivery>;
+
+      timestamp et (system_clock::now () -
+                    chrono::hours (ops.delivery_timeout ()));
+
+      transaction t (conn->begin ());
+      db.erase_query<service_delivery> (query::receipt_timestamp < et);
+      t.commit ();
+    }
+
     return 0;
   }
 
@@ -6,6 +6,25 @@
 -- package-extra.sql file for details.
 --
 
+DROP FUNCTION IF EXISTS build_result_log_chunks(IN tenant TEXT,
+                                               IN name CITEXT,
+                                               IN version_epoch INTEGER,
+                                               IN version_canonical_upstream TEXT,
+                                               IN version_canonical_release TEXT,
+                                               IN version_revision INTEGER,
+                                               IN target TEXT,
+                                               IN target_config_name TEXT,
+                                               IN package_config_name TEXT,
+                                               IN toolchain_name TEXT,
+                                               IN toolchain_version_epoch INTEGER,
+                                               IN toolchain_version_canonical_upstream TEXT,
+                                               IN toolchain_version_canonical_release TEXT,
+                                               IN toolchain_version_revision INTEGER,
+                                               IN result_operation TEXT,
+                                               IN build_timestamp BIGINT,
+                                               IN chunk_offset BIGINT,
+                                               IN chunk_size BIGINT);
+
 DROP FOREIGN TABLE IF EXISTS build_package_config_bot_keys;
 
 DROP FOREIGN TABLE IF EXISTS build_package_config_auxiliaries;
@@ -324,3 +343,110 @@ CREATE FOREIGN TABLE build_package_config_bot_keys (
   key_tenant TEXT NOT NULL,
   key_fingerprint TEXT NOT NULL)
 SERVER package_server OPTIONS (table_name 'package_build_config_bot_keys');
+
+-- Return the build operation results as a set of rows containing the
+-- operation name and status as well as the operation log size in bytes and
+-- the requested log chunk. If operation is NULL, then return all the build
+-- operation results ordered by their position in the results list. Return
+-- no rows if the build timestamp differs from the specified one (the build
+-- has been rebuilt, etc).
+--
+-- The chunk is specified as the zero-based byte offset and size in the UTF-8
+-- encoded log. If the log is stored compressed (see build_result_logs
+-- table), then the compressed flag is set and the whole compressed log is
+-- returned instead, regardless of the chunk offset. If the chunk size is 0,
+-- then the empty data is returned for both compressed and uncompressed logs.
+-- This way the caller can obtain the results and log sizes without loading
+-- the logs.
+--
+-- Note that only the log prefix up to the chunk end is detoasted and
+-- converted to obtain the chunk (the log characters are at least one byte
+-- long and the database is UTF-8 encoded). Thus, the chunk fetching cost
+-- grows with its offset rather than with the log size.
+--
+CREATE FUNCTION
+build_result_log_chunks(IN tenant TEXT,
+                       IN name CITEXT,
+                       IN version_epoch INTEGER,
+                       IN version_canonical_upstream TEXT,
+                       IN version_canonical_release TEXT,
+                       IN version_revision INTEGER,
+                       IN target TEXT,
+                       IN target_config_name TEXT,
+                       IN package_config_name TEXT,
+                       IN toolchain_name TEXT,
+                       IN toolchain_version_epoch INTEGER,
+                       IN toolchain_version_canonical_upstream TEXT,
+                       IN toolchain_version_canonical_release TEXT,
+                       IN toolchain_version_revision INTEGER,
+                       IN result_operation TEXT,
+                       IN build_timestamp BIGINT,
+                       IN chunk_offset BIGINT,
+                       IN chunk_size BIGINT,
+                       OUT operation TEXT,
+                       OUT status TEXT,
+                       OUT size BIGINT,
+                       OUT compressed BOOLEAN,
+                       OUT data BYTEA)
+RETURNS SETOF record AS $$
+  SELECT r.operation,
+         r.status,
+         COALESCE(l.size, octet_length(r.log))::BIGINT,
+         l.data IS NOT NULL,
+         CASE
+           WHEN $18 = 0 THEN ''::BYTEA
+           WHEN l.data IS NOT NULL THEN l.data
+           ELSE substring(convert_to(substring(r.log
+                                               FOR ($17 + $18)::INTEGER),
+                                     'UTF8')
+                          FROM ($17 + 1)::INTEGER
+                          FOR $18::INTEGER)
+         END
+  FROM build_results r
+    JOIN build b USING (package_tenant,
+                        package_name,
+                        package_version_epoch,
+                        package_version_canonical_upstream,
+                        package_version_canonical_release,
+                        package_version_revision,
+                        target,
+                        target_config_name,
+                        package_config_name,
+                        toolchain_name,
+                        toolchain_version_epoch,
+                        toolchain_version_canonical_upstream,
+                        toolchain_version_canonical_release,
+                        toolchain_version_revision)
+    LEFT JOIN build_result_logs l USING (package_tenant,
+                                         package_name,
+                                         package_version_epoch,
+                                         package_version_canonical_upstream,
+                                         package_version_canonical_release,
+                                         package_version_revision,
+                                         target,
+                                         target_config_name,
+                                         package_config_name,
+                                         toolchain_name,
+                                         toolchain_version_epoch,
+                                         toolchain_version_canonical_upstream,
+                                         toolchain_version_canonical_release,
+                                         toolchain_version_revision,
+                                         operation)
+  WHERE r.package_tenant = $1                          AND
+        r.package_name = $2                            AND
+        r.package_version_epoch = $3                   AND
+        r.package_version_canonical_upstream = $4      AND
+        r.package_version_canonical_release = $5       AND
+        r.package_version_revision = $6                AND
+        r.target = $7                                  AND
+        r.target_config_name = $8                      AND
+        r.package_config_name = $9                     AND
+        r.toolchain_name = $10                         AND
+        r.toolchain_version_epoch = $11                AND
+        r.toolchain_version_canonical_upstream = $12   AND
+        r.toolchain_version_canonical_release = $13    AND
+        r.toolchain_version_revision = $14             AND
+        ($15 IS NULL OR r.operation = $15)             AND
+        b.timestamp = $16
+  ORDER BY r.index;
+$$ LANGUAGE SQL STABLE;
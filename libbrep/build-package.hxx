@@ -392,6 +392,18 @@ namespace brep
     //
     #pragma db member(result) column("count(" + build_package::id.name + ")")
   };
+
+  #pragma db view object(build_tenant)
+  struct build_tenant_count
+  {
+    size_t result;
+
+    operator size_t () const {return result;}
+
+    // Database mapping.
+    //
+    #pragma db member(result) column("count(" + build_tenant::id + ")")
+  };
 }
 
 #endif // LIBBREP_BUILD_PACKAGE_HXX
@@ -183,6 +183,8 @@ namespace brep
         auxiliary_machines_section (move (b.auxiliary_machines_section)),
         results (move (b.results)),
         results_section (move (b.results_section)),
+        result_logs (move (b.result_logs)),
+        result_logs_section (move (b.result_logs_section)),
         controller_checksum (move (b.controller_checksum)),
         machine_checksum (move (b.machine_checksum)),
         agent_checksum (move (b.agent_checksum)),
@@ -213,6 +215,8 @@ namespace brep
       auxiliary_machines_section = move (b.auxiliary_machines_section);
       results = move (b.results);
       results_section = move (b.results_section);
+      result_logs = move (b.result_logs);
+      result_logs_section = move (b.result_logs_section);
       controller_checksum = move (b.controller_checksum);
       machine_checksum = move (b.machine_checksum);
       agent_checksum = move (b.agent_checksum);
@@ -249,4 +253,58 @@ namespace brep
         package_timestamp (ptm)
   {
   }
+
+  // tenant_service_job
+  //
+  tenant_service_job::
+  tenant_service_job (string t, string i, string tnt)
+      : id (move (t), move (i)),
+        service_type (id.service_type),
+        service_id (id.service_id),
+        tenant (move (tnt)),
+        creation_timestamp (timestamp::clock::now ()),
+        scheduled_timestamp (creation_timestamp)
+  {
+  }
+
+  // service_access_token
+  //
+  service_access_token::
+  service_access_token (string t, string k, string tk, timestamp e)
+      : id (move (t), move (k)),
+        service_type (id.service_type),
+        key (id.key),
+        token (move (tk)),
+        expiration_timestamp (e)
+  {
+  }
+
+  // service_rate_limit
+  //
+  service_rate_limit::
+  service_rate_limit (string t,
+                      string k,
+                      uint64_t l,
+                      uint64_t r,
+                      timestamp rs)
+      : id (move (t), move (k)),
+        service_type (id.service_type),
+        key (id.key),
+        limit (l),
+        remaining (r),
+        reset_timestamp (rs),
+        allocated (0)
+  {
+  }
+
+  // service_delivery
+  //
+  service_delivery::
+  service_delivery (string t, string i)
+      : id (move (t), move (i)),
+        service_type (id.service_type),
+        delivery_id (id.delivery_id),
+        receipt_timestamp (timestamp::clock::now ())
+  {
+  }
 }
@@ -26,7 +26,7 @@
 //
 #define LIBBREP_BUILD_SCHEMA_VERSION_BASE 29
 
-#pragma db model version(LIBBREP_BUILD_SCHEMA_VERSION_BASE, 29, closed)
+#pragma db model version(LIBBREP_BUILD_SCHEMA_VERSION_BASE, 30, open)
 
 // We have to keep these mappings at the global scope instead of inside the
 // brep namespace because they need to be also effective in the bbot namespace
@@ -228,6 +228,18 @@ namespace brep
 
   using bbot::operation_results;
 
+  // Compressed operation result log (see build::result_logs for details).
+  //
+  #pragma db value
+  struct build_result_log
+  {
+    string operation;
+    uint64_t size;           // Uncompressed log size.
+    std::vector<char> data;  // zstd-compressed log.
+  };
+
+  using build_result_logs = vector<build_result_log>;
+
   #pragma db value
   struct build_machine
   {
@@ -356,6 +368,18 @@ namespace brep
     operation_results results;
     odb::section results_section;
 
+    // Compressed operation result logs (see the
+    // build-result-log-compression brep module configuration option for
+    // details).
+    //
+    // If the compressed log is present for an operation, then the
+    // respective log member in the results container is empty. Storing the
+    // compressed logs in a separate table/section also allows to load the
+    // operation names and statuses without loading the logs.
+    //
+    build_result_logs result_logs;
+    odb::section result_logs_section;
+
     // Checksums of entities involved in the build.
     //
     // Optional checksums are provided by the external entities (agent and
@@ -408,6 +432,11 @@ namespace brep
 
     #pragma db member(results_section) load(lazy) update(always)
 
+    #pragma db member(result_logs) id_column("") value_column("") \
+      section(result_logs_section)
+
+    #pragma db member(result_logs_section) load(lazy) update(always)
+
   private:
     friend class odb::access;
 
@@ -511,6 +540,53 @@ namespace brep
     operator build_id& () {return id;}
   };
 
+  // Compressed operation result logs statistics. Also contains the total
+  // (including indexes and TOAST data) sizes of the operation results and
+  // compressed logs tables.
+  //
+  #pragma db view table("build_result_logs")
+  struct build_result_log_stats
+  {
+    uint64_t count;
+    uint64_t size;             // Uncompressed logs size.
+    uint64_t compressed_size;
+    uint64_t stored_size;      // On-disk compressed logs size.
+
+    uint64_t results_table_size;
+    uint64_t logs_table_size;
+
+    // Database mapping.
+    //
+    #pragma db member(count) column("count(*)")
+
+    #pragma db member(size) column("coalesce(sum(size), 0)::BIGINT")
+
+    #pragma db member(compressed_size) \
+      column("coalesce(sum(length(data)), 0)::BIGINT")
+
+    #pragma db member(stored_size) \
+      column("coalesce(sum(pg_column_size(data)), 0)::BIGINT")
+
+    #pragma db member(results_table_size) \
+      column("pg_total_relation_size('build_results')")
+
+    #pragma db member(logs_table_size) \
+      column("pg_total_relation_size('build_result_logs')")
+  };
+
+  // Build operation result log chunk (see build_result_log_chunks() in
+  // build-extra.sql for details).
+  //
+  #pragma db view query("/*CALL*/ SELECT * FROM build_result_log_chunks(?)")
+  struct build_result_log_chunk
+  {
+    string operation;
+    result_status status;
+    uint64_t size;        // Uncompressed log size.
+    bool compressed;
+    std::vector<char> data;
+  };
+
   // Used to track the package build delays since the last build or, if not
   // present, since the first opportunity to build the package.
   //
@@ -584,6 +660,276 @@ namespace brep
           package_config_name (id.package_config_name),
           toolchain_name (id.toolchain_name) {}
   };
+
+  // Pending outbound request of a tenant service to the third-party service
+  // it represents (for example, creation of the GitHub check runs), which is
+  // performed asynchronously rather than while handling a web request or a
+  // build notification.
+  //
+  // There is at most one job per tenant service, so that the requests are
+  // coalesced: the job only indicates that the service state needs to be
+  // synchronized with the third-party service, while the data to send is
+  // taken from the service state at the time the job is performed.
+  //
+  #pragma db value
+  struct tenant_service_job_id
+  {
+    string service_type;
+    string service_id;
+
+    tenant_service_job_id () = default;
+    tenant_service_job_id (string t, string i)
+        : service_type (move (t)), service_id (move (i)) {}
+  };
+
+  inline bool
+  operator< (const tenant_service_job_id& x, const tenant_service_job_id& y)
+  {
+    if (int r = x.service_type.compare (y.service_type))
+      return r < 0;
+
+    return x.service_id < y.service_id;
+  }
+
+  #pragma db object pointer(shared_ptr) session
+  class tenant_service_job
+  {
+  public:
+    // Create the job scheduled to be performed right away.
+    //
+    tenant_service_job (string service_type,
+                        string service_id,
+                        string tenant);
+
+    tenant_service_job_id id;
+
+    string& service_type; // Tracks id.service_type.
+    string& service_id;   // Tracks id.service_id.
+
+    string tenant;        // Tenant at the time of the (latest) enqueuing.
+
+    // Incremented every time the job is enqueued while already present, so
+    // that the sender can detect that the service state has changed while
+    // the job was being performed.
+    //
+    uint64_t generation = 0;
+
+    timestamp creation_timestamp;
+
+    // Time not before which the job is performed (next attempt, rate limit
+    // window reset, etc).
+    //
+    timestamp scheduled_timestamp;
+
+    // Time until which the job is claimed by some sender (which may not
+    // complete it, for example, due to the process termination, in which
+    // case it becomes available again once expired). Initialized with
+    // timestamp_nonexistent by default, meaning that the job is not claimed.
+    //
+    timestamp lease_timestamp;
+
+    // Number of consecutive failed attempts to perform the job.
+    //
+    uint16_t attempts = 0;
+
+    // Database mapping.
+    //
+    #pragma db member(id) id column("")
+
+    #pragma db member(service_type) transient
+    #pragma db member(service_id) transient
+
+    // Speed-up queries for the jobs which are due.
+    //
+    #pragma db member(scheduled_timestamp) index
+
+  private:
+    friend class odb::access;
+
+    tenant_service_job ()
+        : service_type (id.service_type), service_id (id.service_id) {}
+  };
+
+  // Access token for a third-party service API (for example, GitHub App
+  // installation access token) which is shared between the web server
+  // processes, so that a new token is not obtained for every request.
+  //
+  #pragma db value
+  struct service_access_token_id
+  {
+    string service_type;
+    string key;          // Service-specific (installation id, etc).
+
+    service_access_token_id () = default;
+    service_access_token_id (string t, string k)
+        : service_type (move (t)), key (move (k)) {}
+  };
+
+  inline bool
+  operator< (const service_access_token_id& x,
+             const service_access_token_id& y)
+  {
+    if (int r = x.service_type.compare (y.service_type))
+      return r < 0;
+
+    return x.key < y.key;
+  }
+
+  #pragma db object pointer(shared_ptr) session
+  class service_access_token
+  {
+  public:
+    service_access_token (string service_type,
+                          string key,
+                          string token,
+                          timestamp expiration);
+
+    service_access_token_id id;
+
+    string& service_type; // Tracks id.service_type.
+    string& key;          // Tracks id.key.
+
+    string token;
+    timestamp expiration_timestamp;
+
+    // Database mapping.
+    //
+    #pragma db member(id) id column("")
+
+    #pragma db member(service_type) transient
+    #pragma db member(key) transient
+
+  private:
+    friend class odb::access;
+
+    service_access_token ()
+        : service_type (id.service_type), key (id.key) {}
+  };
+
+  // API rate limit budget of a third-party service account (for example,
+  // GitHub App installation) which is shared between the web server
+  // processes. Contains the latest rate limit status observed by any of them
+  // in the current rate limit window and the number of points allocated to
+  // the CI jobs in this window.
+  //
+  #pragma db value
+  struct service_rate_limit_id
+  {
+    string service_type;
+    string key;          // Service-specific (installation id, etc).
+
+    service_rate_limit_id () = default;
+    service_rate_limit_id (string t, string k)
+        : service_type (move (t)), key (move (k)) {}
+  };
+
+  inline bool
+  operator< (const service_rate_limit_id& x, const service_rate_limit_id& y)
+  {
+    if (int r = x.service_type.compare (y.service_type))
+      return r < 0;
+
+    return x.key < y.key;
+  }
+
+  #pragma db object pointer(shared_ptr) session
+  class service_rate_limit
+  {
+  public:
+    // Create the rate limit status with no points allocated.
+    //
+    service_rate_limit (string service_type,
+                        string key,
+                        uint64_t limit,
+                        uint64_t remaining,
+                        timestamp reset);
+
+    service_rate_limit_id id;
+
+    string& service_type; // Tracks id.service_type.
+    string& key;          // Tracks id.key.
+
+    uint64_t limit;
+    uint64_t remaining;
+    timestamp reset_timestamp;
+
+    uint64_t allocated;
+
+    // Database mapping.
+    //
+    #pragma db member(id) id column("")
+
+    #pragma db member(service_type) transient
+    #pragma db member(key) transient
+
+    // Note: "limit" is a reserved word in SQL.
+    //
+    #pragma db member(limit) column("rate_limit")
+
+  private:
+    friend class odb::access;
+
+    service_rate_limit ()
+        : service_type (id.service_type), key (id.key) {}
+  };
+
+  // Webhook delivery of a third-party service (for example, GitHub webhook
+  // delivery) which has already been received, so that the redeliveries and
+  // duplicate deliveries can be detected and ignored. The old deliveries are
+  // expected to be cleaned up by brep-clean.
+  //
+  #pragma db value
+  struct service_delivery_id
+  {
+    string service_type;
+    string delivery_id;  // Service-specific (GitHub delivery GUID, etc).
+
+    service_delivery_id () = default;
+    service_delivery_id (string t, string i)
+        : service_type (move (t)), delivery_id (move (i)) {}
+  };
+
+  inline bool
+  operator< (const service_delivery_id& x, const service_delivery_id& y)
+  {
+    if (int r = x.service_type.compare (y.service_type))
+      return r < 0;
+
+    return x.delivery_id < y.delivery_id;
+  }
+
+  #pragma db object pointer(shared_ptr) session
+  class service_delivery
+  {
+  public:
+    // Create the delivery received right now.
+    //
+    service_delivery (string service_type, string delivery_id);
+
+    service_delivery_id id;
+
+    string& service_type; // Tracks id.service_type.
+    string& delivery_id;  // Tracks id.delivery_id.
+
+    timestamp receipt_timestamp;
+
+    // Database mapping.
+    //
+    #pragma db member(id) id column("")
+
+    #pragma db member(service_type) transient
+    #pragma db member(delivery_id) transient
+
+    // Speed-up queries for the expired deliveries.
+    //
+    #pragma db member(receipt_timestamp) index
+
+  private:
+    friend class odb::access;
+
+    service_delivery ()
+        : service_type (id.service_type), delivery_id (id.delivery_id) {}
+  };
 }
 
 #endif // LIBBREP_BUILD_HXX
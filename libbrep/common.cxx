@@ -3,6 +3,9 @@
 
 #include <libbrep/common.hxx>
 
+#include <mutex>
+#include <unordered_map>
+
 namespace brep
 {
   const version wildcard_version (0, "0", nullopt, nullopt, 0);
@@ -32,4 +35,44 @@ namespace brep
     else if (r == "unbuildable") return unbuildable_reason::unbuildable;
     else throw invalid_argument ("invalid unbuildable reason '" + r + '\'');
   }
+
+  // build_class_expr
+  //
+  // The maximum number of the cached expressions. Normally, there are only a
+  // handful of distinct expressions across all the packages. However, we
+  // don't want the cache to grow indefinitely if that's not the case, so we
+  // just drop the whole cache when it reaches this limit.
+  //
+  static const size_t build_class_expr_cache_max (10000);
+
+  static std::mutex build_class_expr_cache_mutex;
+  static std::unordered_map<string, build_class_expr> build_class_expr_cache;
+
+  build_class_expr
+  parse_build_class_expr (const string& s)
+  {
+    using namespace std;
+
+    {
+      lock_guard<mutex> l (build_class_expr_cache_mutex);
+
+      auto i (build_class_expr_cache.find (s));
+      if (i != build_class_expr_cache.end ())
+        return i->second;
+    }
+
+    // Parse outside the lock. Note that the expression is expected to be
+    // valid (it has been verified when the package was loaded into the
+    // database), so let the exception propagate if that's not the case.
+    //
+    build_class_expr r (s, "" /* comment */);
+
+    lock_guard<mutex> l (build_class_expr_cache_mutex);
+
+    if (build_class_expr_cache.size () == build_class_expr_cache_max)
+      build_class_expr_cache.clear ();
+
+    build_class_expr_cache.emplace (s, r);
+    return r;
+  }
 }
@@ -365,9 +365,20 @@ namespace brep
   #pragma db member(build_class_expr::expr) transient
   #pragma db member(build_class_expr::underlying_classes) transient
 
+  // Return the build class expression parsed from the specified string.
+  //
+  // Note that the same expressions are loaded over and over again from the
+  // database (for example, for each package build candidate), so we cache
+  // the parsed expressions (without comments) keyed by their string
+  // representations and return copies of the cached ones. The cache is
+  // shared between threads and is bounded (see common.cxx for details).
+  //
+  build_class_expr
+  parse_build_class_expr (const string&);
+
   #pragma db member(build_class_expr::expression) virtual(string) before \
     get(this.string ())                                                  \
-    set(this = brep::build_class_expr ((?), "" /* comment */))
+    set(this = brep::parse_build_class_expr (?))
 
   // build_constraints
   //
@@ -6,12 +6,17 @@
 #include <errno.h> // EIO
 
 #include <map>
+#include <mutex>
+#include <tuple>
+#include <chrono>
 #include <sstream>
 
 #include <libbutl/sha256.hxx>
+#include <libbutl/process.hxx>      // process::current_id()
 #include <libbutl/utility.hxx>      // throw_generic_error()
 #include <libbutl/openssl.hxx>
-#include <libbutl/filesystem.hxx>   // dir_iterator, dir_entry
+#include <libbutl/fdstream.hxx>
+#include <libbutl/filesystem.hxx>   // dir_iterator, dir_entry, file_mtime()
 
 namespace brep
 {
@@ -19,109 +24,488 @@ namespace brep
   using namespace butl;
   using namespace bpkg;
 
-  // Return pointer to the shared build target configurations instance,
-  // creating one on the first call. Throw tab_parsing on parsing error,
-  // io_error on the underlying OS error. Note: not thread-safe.
-  //
-  static shared_ptr<const build_target_configs>
-  shared_build_config (const path& p)
-  {
-    static map<path, weak_ptr<build_target_configs>> configs;
+  using bot_agent_key_map = map<string, path>;
 
-    auto i (configs.find (p));
-    if (i != configs.end ())
-    {
-      if (shared_ptr<build_target_configs> c = i->second.lock ())
-        return c;
-    }
+  using conf_map_type = map<build_target_config_id,
+                            const build_target_config*>;
 
-    shared_ptr<build_target_configs> c (
-      make_shared<build_target_configs> (bbot::parse_buildtab (p)));
+  // Build bot agent public key fingerprint together with the key file
+  // modification time it was calculated for.
+  //
+  struct key_fingerprint
+  {
+    timestamp mtime;
+    string fingerprint;
+  };
 
-    configs[p] = c;
-    return c;
-  }
+  using key_fingerprints = map<path, key_fingerprint>;
 
-  // Return pointer to the shared build bot agent public keys map, creating
-  // one on the first call. Throw system_error on the underlying openssl or OS
-  // error. Note: not thread-safe.
+  // Build configurations snapshot.
   //
-  using bot_agent_key_map = map<string, path>;
-
-  static shared_ptr<const bot_agent_key_map>
-  shared_bot_agent_keys (const options::openssl_options& o, const dir_path& d)
+  struct build_config_module::config_snapshot
   {
-    static map<dir_path, weak_ptr<bot_agent_key_map>> keys;
+    build_target_configs configs;
+    build_class_index    class_index;
+    conf_map_type        config_map;
+
+    // NULL if the agent authentication is disabled.
+    //
+    shared_ptr<const bot_agent_key_map> bot_agent_keys;
 
-    auto i (keys.find (d));
-    if (i != keys.end ())
+    config_snapshot (build_target_configs&& cs,
+                     shared_ptr<const bot_agent_key_map> ks)
+        : configs (move (cs)),
+          class_index (configs),
+          bot_agent_keys (move (ks))
     {
-      if (shared_ptr<bot_agent_key_map> k = i->second.lock ())
-        return k;
+      for (const auto& c: configs)
+        config_map[build_target_config_id {c.target, c.name}] = &c;
     }
+  };
+
+  // Build configuration source and its current snapshot.
+  //
+  // Note that the source is shared by all the handlers of a web server
+  // process that use the same build configuration options.
+  //
+  struct build_config_module::config_source
+  {
+    const path                     buildtab;
+    const optional<dir_path>       keys_dir;
+    const optional<path>           keys_cache;
+    const options::openssl_options openssl_ops;
+    const chrono::seconds          reload_interval; // Zero if never reload.
+
+    // The following members are protected by the mutex.
+    //
+    std::mutex mutex;
 
-    shared_ptr<bot_agent_key_map> ak (make_shared<bot_agent_key_map> ());
+    shared_ptr<const config_snapshot> snapshot;
+    timestamp                         checked; // Last changes check time.
+    bool                              reloading = false;
 
-    // Intercept exception handling to make error descriptions more
-    // informative.
+    // The following members are only accessed by the thread reloading the
+    // snapshot (see current() for details).
     //
-    // Path of the key being converted. Used for diagnostics.
+    timestamp        buildtab_mtime;
+    key_fingerprints keys;
+
+    explicit
+    config_source (const options::build& o)
+        : buildtab (o.build_config ()),
+          keys_dir (o.build_bot_agent_keys_specified ()
+                    ? o.build_bot_agent_keys ()
+                    : optional<dir_path> ()),
+          keys_cache (o.build_bot_agent_keys_cache_specified ()
+                      ? o.build_bot_agent_keys_cache ()
+                      : optional<path> ()),
+          openssl_ops (o),
+          reload_interval (o.build_config_reload_interval ()) {}
+
+    // Return pointer to the shared build configuration source, creating one
+    // and loading its snapshot on the first call. Throw tab_parsing on
+    // parsing error, io_error on the underlying OS error reading the build
+    // configuration file, and system_error on the underlying openssl or OS
+    // error converting the agent keys.
     //
-    path p;
+    static shared_ptr<config_source>
+    instance (const options::build& o)
+    {
+      // Note that all the options the source depends on are part of the key.
+      //
+      using key = tuple<path,             // Build configuration file.
+                        dir_path,         // Agent keys directory.
+                        path,             // Agent keys cache.
+                        chrono::seconds,  // Reload interval.
+                        path,             // openssl program.
+                        strings,          // openssl environment.
+                        strings>;         // openssl options.
+
+      static std::mutex m;
+      static map<key, weak_ptr<config_source>> sources;
+
+      key k (o.build_config (),
+             o.build_bot_agent_keys_specified ()
+             ? o.build_bot_agent_keys ()
+             : dir_path (),
+             o.build_bot_agent_keys_cache_specified ()
+             ? o.build_bot_agent_keys_cache ()
+             : path (),
+             o.build_config_reload_interval (),
+             o.openssl (),
+             o.openssl_envvar (),
+             o.openssl_option ());
+
+      lock_guard<std::mutex> l (m);
+
+      auto i (sources.find (k));
+      if (i != sources.end ())
+      {
+        if (shared_ptr<config_source> s = i->second.lock ())
+          return s;
+      }
 
-    try
+      shared_ptr<config_source> s (make_shared<config_source> (o));
+      s->snapshot = s->load ();
+      s->checked = chrono::system_clock::now ();
+
+      sources[move (k)] = s;
+      return s;
+    }
+
+    // Return the current snapshot, reloading it first if the reload is
+    // enabled, the reload interval has elapsed since the last check, and the
+    // build configuration file or agent keys have changed since the snapshot
+    // has been loaded.
+    //
+    // Note that the changes check and reload are performed by a single
+    // thread at a time without holding the mutex, so that the other threads
+    // can keep using the current snapshot meanwhile. The new snapshot is
+    // made current when loaded.
+    //
+    // Also note that we keep using the current snapshot if the changes check
+    // or reload fails (the configuration is being edited, etc), log the
+    // failure, and retry on the next check.
+    //
+    shared_ptr<const config_snapshot>
+    current (const diag_epilogue& log_writer)
     {
-      for (const dir_entry& de: dir_iterator (d, dir_iterator::no_follow))
       {
-        if (de.path ().extension () == "pem" &&
-            de.type () == entry_type::regular)
-        {
-          p = d / de.path ();
+        lock_guard<std::mutex> l (mutex);
 
-          openssl os (p, path ("-"), 2,
-                      process_env (o.openssl (), o.openssl_envvar ()),
-                      "pkey",
-                      o.openssl_option (), "-pubin", "-outform", "DER");
+        if (reload_interval == chrono::seconds::zero () || reloading)
+          return snapshot;
 
-          string fp (sha256 (os.in).string ());
-          os.in.close ();
+        timestamp now (chrono::system_clock::now ());
 
-          if (!os.wait ())
-            throw io_error ("");
+        if (now - checked < reload_interval)
+          return snapshot;
 
-          ak->emplace (move (fp), move (p));
-        }
+        checked = now;
+        reloading = true;
       }
+
+      shared_ptr<const config_snapshot> s;
+
+      try
+      {
+        if (changed ())
+          s = load ();
+      }
+      catch (const exception& e)
+      {
+        basic_mark error (severity::error, log_writer, __PRETTY_FUNCTION__);
+
+        error << "unable to reload build configuration '" << buildtab
+              << "': " << e;
+      }
+
+      lock_guard<std::mutex> l (mutex);
+
+      if (s != nullptr)
+        snapshot = move (s);
+
+      reloading = false;
+      return snapshot;
     }
-    catch (const io_error&)
+
+  private:
+    // Load the build configuration file and the agent keys into a new
+    // snapshot, updating the build configuration file modification time and
+    // the agent keys fingerprints.
+    //
+    shared_ptr<const config_snapshot>
+    load ()
     {
-      ostringstream os;
-      os << "unable to convert bbot agent pubkey " << p;
-      throw_generic_error (EIO, os.str ().c_str ());
+      // Note that we query the modification time prior to parsing the file,
+      // so that changes made in between are not missed by the next check.
+      //
+      timestamp mt (file_mtime (buildtab));
+
+      build_target_configs cs (bbot::parse_buildtab (buildtab));
+
+      key_fingerprints ks;
+      shared_ptr<const bot_agent_key_map> km (keys_dir
+                                              ? load_keys (ks)
+                                              : nullptr);
+
+      shared_ptr<const config_snapshot> r (
+        make_shared<config_snapshot> (move (cs), move (km)));
+
+      buildtab_mtime = mt;
+      keys = move (ks);
+
+      return r;
     }
-    catch (const process_error& e)
+
+    // Return true if the build configuration file or the agent keys
+    // directory contents have changed since the current snapshot has been
+    // loaded.
+    //
+    bool
+    changed () const
     {
-      ostringstream os;
-      os << "unable to convert bbot agent pubkey " << p;
-      throw_generic_error (e.code ().value (), os.str ().c_str ());
+      if (file_mtime (buildtab) != buildtab_mtime)
+        return true;
+
+      if (keys_dir)
+      {
+        size_t n (0);
+
+        for (const dir_entry& de: dir_iterator (*keys_dir,
+                                                dir_iterator::no_follow))
+        {
+          if (de.path ().extension () == "pem" &&
+              de.type () == entry_type::regular)
+          {
+            path p (*keys_dir / de.path ());
+            auto i (keys.find (p));
+
+            if (i == keys.end () || i->second.mtime != file_mtime (p))
+              return true;
+
+            ++n;
+          }
+        }
+
+        if (n != keys.size ())
+          return true;
+      }
+
+      return false;
     }
-    catch (const system_error& e)
+
+    // Establish mapping of the agent public keys fingerprints to their paths,
+    // saving the fingerprints together with the key modification times.
+    // Only convert the new and modified keys, reusing the fingerprints
+    // calculated for the current snapshot or by other processes (see the
+    // build-bot-agent-keys-cache option for details). Throw system_error on
+    // the underlying openssl or OS error.
+    //
+    shared_ptr<const bot_agent_key_map>
+    load_keys (key_fingerprints& r) const
     {
-      ostringstream os;
-      os << "unable to iterate over agents keys directory '" << d << "'";
-      throw_generic_error (e.code ().value (), os.str ().c_str ());
+      assert (keys_dir);
+
+      const dir_path& d (*keys_dir);
+
+      shared_ptr<bot_agent_key_map> ak (make_shared<bot_agent_key_map> ());
+
+      optional<key_fingerprints> cache; // Loaded lazily.
+      bool converted (false);
+
+      // Intercept exception handling to make error descriptions more
+      // informative.
+      //
+      // Path of the key being converted. Used for diagnostics.
+      //
+      path p;
+
+      try
+      {
+        for (const dir_entry& de: dir_iterator (d, dir_iterator::no_follow))
+        {
+          if (de.path ().extension () == "pem" &&
+              de.type () == entry_type::regular)
+          {
+            p = d / de.path ();
+
+            timestamp mt (file_mtime (p));
+
+            // Return the key fingerprint if present in the specified map for
+            // the current key modification time and NULL otherwise.
+            //
+            auto find = [&p, &mt] (const key_fingerprints& ks) -> const string*
+            {
+              auto i (ks.find (p));
+              return i != ks.end () && i->second.mtime == mt
+                     ? &i->second.fingerprint
+                     : nullptr;
+            };
+
+            const string* f (find (keys));
+
+            if (f == nullptr && keys_cache)
+            {
+              if (!cache)
+                cache = load_keys_cache ();
+
+              f = find (*cache);
+            }
+
+            string fp;
+
+            if (f != nullptr)
+            {
+              fp = *f;
+            }
+            else
+            {
+              request_phase rp ("openssl");
+
+              openssl os (p, path ("-"), 2,
+                          process_env (openssl_ops.openssl (),
+                                       openssl_ops.openssl_envvar ()),
+                          "pkey",
+                          openssl_ops.openssl_option (),
+                          "-pubin", "-outform", "DER");
+
+              fp = sha256 (os.in).string ();
+              os.in.close ();
+
+              if (!os.wait ())
+                throw io_error ("");
+
+              converted = true;
+            }
+
+            ak->emplace (fp, p);
+            r.emplace (move (p), key_fingerprint {mt, move (fp)});
+          }
+        }
+      }
+      catch (const io_error&)
+      {
+        ostringstream os;
+        os << "unable to convert bbot agent pubkey " << p;
+        throw_generic_error (EIO, os.str ().c_str ());
+      }
+      catch (const process_error& e)
+      {
+        ostringstream os;
+        os << "unable to convert bbot agent pubkey " << p;
+        throw_generic_error (e.code ().value (), os.str ().c_str ());
+      }
+      catch (const system_error& e)
+      {
+        ostringstream os;
+        os << "unable to iterate over agents keys directory '" << d << "'";
+        throw_generic_error (e.code ().value (), os.str ().c_str ());
+      }
+
+      if (converted && keys_cache)
+        save_keys_cache (r);
+
+      return ak;
+    }
+
+    // The agent keys fingerprints cache file format version. Increment when
+    // the format changes, so that the files in the old format are ignored.
+    //
+    static const uint16_t keys_cache_version = 1;
+
+    // Load the agent keys fingerprints from the cache file. Return an empty
+    // map if the file doesn't exist, is invalid, or cannot be read.
+    //
+    // The file contains the version header line followed by a line per key
+    // in the following form:
+    //
+    // <mtime> <fingerprint> <path>
+    //
+    // Where <mtime> is the key modification time in nanoseconds since epoch.
+    //
+    key_fingerprints
+    load_keys_cache () const
+    {
+      assert (keys_cache);
+
+      key_fingerprints r;
+
+      try
+      {
+        ifdstream is (*keys_cache, ifdstream::badbit);
+
+        string l;
+        if (!getline (is, l) ||
+            l != "version: " + to_string (keys_cache_version))
+          return r;
+
+        while (getline (is, l))
+        {
+          size_t p1 (l.find (' '));
+          size_t p2 (p1 != string::npos ? l.find (' ', p1 + 1) : p1);
+
+          if (p2 == string::npos || p2 + 1 == l.size ())
+            return key_fingerprints ();
+
+          uint64_t ns (stoull (string (l, 0, p1)));
+
+          r.emplace (path (string (l, p2 + 1)),
+                     key_fingerprint {
+                       timestamp (
+                         chrono::duration_cast<duration> (
+                           chrono::nanoseconds (ns))),
+                       string (l, p1 + 1, p2 - p1 - 1)});
+        }
+
+        is.close ();
+      }
+      // Note that we also end up here if the file doesn't exist.
+      //
+      catch (const io_error&)              {r.clear ();}
+      catch (const invalid_argument&)      {r.clear ();}
+      catch (const out_of_range&)          {r.clear ();}
+
+      return r;
     }
 
-    keys[d] = ak;
-    return ak;
+    // Save the agent keys fingerprints into the cache file, replacing it
+    // atomically. Ignore errors since the cache is only an optimization.
+    //
+    void
+    save_keys_cache (const key_fingerprints& ks) const
+    {
+      assert (keys_cache);
+
+      path t (*keys_cache + ("." + to_string (process::current_id ())));
+
+      try
+      {
+        ofdstream os (t);
+
+        os << "version: " << keys_cache_version << '\n';
+
+        for (const auto& k: ks)
+        {
+          os << chrono::duration_cast<chrono::nanoseconds> (
+                  k.second.mtime.time_since_epoch ()).count () << ' '
+             << k.second.fingerprint << ' '
+             << k.first.string () << '\n';
+        }
+
+        os.close ();
+
+        mventry (t, *keys_cache);
+      }
+      catch (const system_error&)
+      {
+        try_rmfile (t, true /* ignore_error */);
+      }
+    }
+  };
+
+  build_config_module::
+  build_config_module (const build_config_module& m)
+      : target_conf_ (m.target_conf_),
+        target_conf_map_ (m.target_conf_map_),
+        class_index_ (m.class_index_),
+        bot_agent_key_map_ (m.bot_agent_key_map_),
+        source_ (m.source_),
+        reload_log_writer_ (m.reload_log_writer_)
+  {
+    if (source_ != nullptr &&
+        source_->reload_interval != chrono::seconds::zero ())
+      snapshot (source_->current (*reload_log_writer_));
   }
 
   void build_config_module::
-  init (const options::build& bo)
+  init (const options::build& bo, const diag_epilogue& log_writer)
   {
+    reload_log_writer_ = &log_writer;
+
     try
     {
-      target_conf_ = shared_build_config (bo.build_config ());
+      source_ = config_source::instance (bo);
     }
     catch (const io_error& e)
     {
@@ -132,53 +516,34 @@ namespace brep
       throw_generic_error (EIO, os.str ().c_str ());
     }
 
-    if (bo.build_bot_agent_keys_specified ())
-      bot_agent_key_map_ =
-        shared_bot_agent_keys (bo, bo.build_bot_agent_keys ());
-
-    using conf_map_type = map<build_target_config_id,
-                              const build_target_config*>;
-
-    conf_map_type conf_map;
+    snapshot (source_->current (log_writer));
+  }
 
-    for (const auto& c: *target_conf_)
-      conf_map[build_target_config_id {c.target, c.name}] = &c;
+  void build_config_module::
+  snapshot (shared_ptr<const config_snapshot> s)
+  {
+    // Skip if the snapshot is already in use.
+    //
+    if (target_conf_.get () == &s->configs)
+      return;
 
-    target_conf_map_ = make_shared<conf_map_type> (move (conf_map));
+    // Share the snapshot ownership between the configuration data pointers.
+    //
+    target_conf_ = shared_ptr<const build_target_configs> (s, &s->configs);
+    target_conf_map_ = shared_ptr<const conf_map_type> (s, &s->config_map);
+    class_index_ = shared_ptr<const build_class_index> (s, &s->class_index);
+    bot_agent_key_map_ = s->bot_agent_keys;
   }
 
   bool build_config_module::
   derived (const string& c, const char* bc) const
   {
-    if (c == bc)
-      return true;
-
-    // Go through base classes.
-    //
-    const map<string, string>& im (target_conf_->class_inheritance_map);
-
-    for (auto i (im.find (c)); i != im.end (); )
-    {
-      const string& base (i->second);
-
-      if (base == bc)
-        return true;
-
-      i = im.find (base);
-    }
-
-    return false;
+    return class_index_->derived (c, bc);
   }
 
   bool build_config_module::
   belongs (const build_target_config& cfg, const char* cls) const
   {
-    for (const string& c: cfg.classes)
-    {
-      if (derived (c, cls))
-        return true;
-    }
-
-    return false;
+    return class_index_->belongs (cfg, cls);
   }
 }
@@ -13,6 +13,7 @@
 #include <libbrep/types.hxx>
 #include <libbrep/utility.hxx>
 
+#include <mod/diagnostics.hxx>
 #include <mod/module-options.hxx>
 #include <mod/build-target-config.hxx>
 
@@ -29,12 +30,23 @@ namespace brep
   class build_config_module
   {
   protected:
+    build_config_module () = default;
+
+    // Share the build configuration with the exemplar, picking up its latest
+    // snapshot if the configuration reload is enabled (see the
+    // build-config-reload-interval option for details).
+    //
+    build_config_module (const build_config_module&);
+
     // Parse build configuration file and establish mapping of build bot agent
     // public keys fingerprints to their paths. Throw tab_parsing on parsing
     // error, system_error on the underlying OS error.
     //
+    // The log writer is used to report the configuration reload failures and
+    // must be the handler exemplar's one (which outlives its copies).
+    //
     void
-    init (const options::build&);
+    init (const options::build&, const diag_epilogue& log_writer);
 
     template <typename K>
     bool
@@ -49,7 +61,7 @@ namespace brep
                             common_builds,
                             common_constraints,
                             tc,
-                            target_conf_->class_inheritance_map,
+                            *class_index_,
                             reason,
                             default_all_ucs);
     }
@@ -114,9 +126,28 @@ namespace brep
                               const build_target_config*>>
     target_conf_map_;
 
+    // Compiled class inheritance for the build configurations.
+    //
+    shared_ptr<const build_class_index> class_index_;
+
     // Map of build bot agent public keys fingerprints to the key file paths.
     //
     shared_ptr<const std::map<string, path>> bot_agent_key_map_;
+
+  private:
+    // Build configuration source (the build configuration file and bot
+    // agent keys directory) and its snapshot (the build configurations and
+    // bot agent keys map) that the above pointers refer to. Note that the
+    // above pointers share the snapshot ownership.
+    //
+    struct config_source;
+    struct config_snapshot;
+
+    void
+    snapshot (shared_ptr<const config_snapshot>);
+
+    shared_ptr<config_source> source_;
+    const diag_epilogue* reload_log_writer_ = nullptr;
   };
 }
 
@@ -35,7 +35,7 @@ namespace brep
   {
     HANDLER_DIAG;
 
-    build_config_module::init (bo);
+    build_config_module::init (bo, log_writer_);
     database_module::init (bdo, bdo.build_db_retry ());
 
     try
@@ -247,6 +247,8 @@ namespace brep
 
         try
         {
+          request_phase rp ("openssl");
+
           openssl os ([&trace, this] (const char* args[], size_t n)
                       {
                         l2 ([&]{trace << process_args {args, n};});
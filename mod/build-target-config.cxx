@@ -3,6 +3,8 @@
 
 #include <mod/build-target-config.hxx>
 
+#include <functional> // less
+
 #include <libbutl/utility.hxx>      // alpha(), etc.
 #include <libbutl/path-pattern.hxx>
 
@@ -20,11 +22,15 @@ namespace brep
   static const build_class_expr all_ucs_expr (
     {"all"}, '+', "All.");
 
-  bool
+  // Implement exclude() using the specified function for matching the
+  // configuration against a build class expression.
+  //
+  template <typename M>
+  static bool
   exclude (const build_class_exprs& exprs,
            const build_constraints& constrs,
            const build_target_config& tc,
-           const map<string, string>& class_inheritance_map,
+           const M& match_expr,
            string* reason,
            bool default_all_ucs)
   {
@@ -73,11 +79,11 @@ namespace brep
     // (changing the result from true to false) or non-including one (leaving
     // the false result) as an exclusion reason.
     //
-    auto match = [&tc, &m, reason, &sanitize, &class_inheritance_map]
+    auto match = [&m, reason, &sanitize, &match_expr]
                  (const build_class_expr& e)
     {
       bool pm (m);
-      e.match (tc.classes, class_inheritance_map, m);
+      match_expr (e, m);
 
       if (reason != nullptr)
       {
@@ -197,6 +203,224 @@ namespace brep
     return false;
   }
 
+  bool
+  exclude (const build_class_exprs& exprs,
+           const build_constraints& constrs,
+           const build_target_config& tc,
+           const map<string, string>& class_inheritance_map,
+           string* reason,
+           bool default_all_ucs)
+  {
+    return exclude (exprs,
+                    constrs,
+                    tc,
+                    [&tc, &class_inheritance_map] (const build_class_expr& e,
+                                                   bool& r)
+                    {
+                      e.match (tc.classes, class_inheritance_map, r);
+                    },
+                    reason,
+                    default_all_ucs);
+  }
+
+  bool
+  exclude (const build_class_exprs& exprs,
+           const build_constraints& constrs,
+           const build_target_config& tc,
+           const build_class_index& class_index,
+           string* reason,
+           bool default_all_ucs)
+  {
+    return exclude (exprs,
+                    constrs,
+                    tc,
+                    [&tc, &class_index] (const build_class_expr& e, bool& r)
+                    {
+                      class_index.match (tc, e, r);
+                    },
+                    reason,
+                    default_all_ucs);
+  }
+
+  // build_class_index
+  //
+  build_class_index::
+  build_class_index (const build_target_configs& cs)
+      : configs_ (cs)
+  {
+    const map<string, string>& im (cs.class_inheritance_map);
+
+    // Assign the class ids.
+    //
+    auto add = [this] (const string& c)
+    {
+      ids_.emplace (c, ids_.size ());
+    };
+
+    for (const build_target_config& c: cs)
+    {
+      for (const string& cl: c.classes)
+        add (cl);
+    }
+
+    for (const auto& p: im)
+    {
+      add (p.first);
+      add (p.second);
+    }
+
+    size_t n ((ids_.size () + 63) / 64);
+
+    auto set = [] (class_set& s, size_t id)
+    {
+      s[id / 64] |= uint64_t (1) << (id % 64);
+    };
+
+    // Compute the class ancestor sets, walking the inheritance chains.
+    //
+    bases_.resize (ids_.size (), class_set (n, 0));
+
+    for (const auto& p: ids_)
+    {
+      class_set& s (bases_[p.second]);
+      set (s, p.second);
+
+      for (auto i (im.find (p.first)); i != im.end (); i = im.find (i->second))
+        set (s, ids_[i->second]);
+    }
+
+    // Compute the configuration class sets.
+    //
+    config_classes_.reserve (cs.size ());
+
+    for (const build_target_config& c: cs)
+    {
+      class_set s (n, 0);
+
+      for (const string& cl: c.classes)
+      {
+        const class_set& bs (bases_[ids_[cl]]);
+
+        for (size_t i (0); i != n; ++i)
+          s[i] |= bs[i];
+      }
+
+      config_classes_.push_back (move (s));
+    }
+  }
+
+  size_t build_class_index::
+  id (const string& c) const
+  {
+    auto i (ids_.find (c));
+    return i != ids_.end () ? i->second : size_t (-1);
+  }
+
+  const build_class_index::class_set* build_class_index::
+  classes (const build_target_config& c) const
+  {
+    // Note that the configuration may well be a copy of an indexed one or
+    // come from some other list.
+    //
+    // Also note that the built-in pointer comparison is unspecified for
+    // pointers to unrelated objects, so we use less which is guaranteed to
+    // be total.
+    //
+    less<const build_target_config*> lt;
+
+    return !configs_.empty ()                &&
+           !lt (&c, &configs_.front ())      &&
+           !lt (&configs_.back (), &c)
+           ? &config_classes_[&c - &configs_.front ()]
+           : nullptr;
+  }
+
+  bool build_class_index::
+  derived (const string& c, const string& bc) const
+  {
+    size_t i (id (c));
+    size_t bi (id (bc));
+
+    return i != size_t (-1) && bi != size_t (-1)
+           ? test (bases_[i], bi)
+           : c == bc;
+  }
+
+  bool build_class_index::
+  belongs (const build_target_config& cfg, const string& cls) const
+  {
+    if (const class_set* cs = classes (cfg))
+    {
+      size_t i (id (cls));
+      return i != size_t (-1) && test (*cs, i);
+    }
+
+    for (const string& c: cfg.classes)
+    {
+      if (derived (c, cls))
+        return true;
+    }
+
+    return false;
+  }
+
+  void build_class_index::
+  match (const build_target_config& cfg,
+         const build_class_expr& e,
+         bool& r) const
+  {
+    if (const class_set* cs = classes (cfg))
+      match (*cs, e.expr, r);
+    else
+      e.match (cfg.classes, configs_.class_inheritance_map, r);
+  }
+
+  void build_class_index::
+  match (const class_set& cs,
+         const vector<build_class_term>& expr,
+         bool& r) const
+  {
+    for (const build_class_term& t: expr)
+    {
+      // Note that the '+' and '-' terms can only change the result if it is
+      // false and true, respectively, and the '&' term only if it is true.
+      // Thus, skip the term evaluation if that's not the case.
+      //
+      if (t.operation == '+' ? r : !r)
+        continue;
+
+      bool m (false);
+
+      if (t.simple)
+      {
+        // Note that, as in bpkg::build_class_expr::match(), the reserved
+        // `all` and `none` class names match all and no configurations,
+        // respectively.
+        //
+        if (t.name == "all")
+          m = true;
+        else if (t.name != "none")
+        {
+          size_t i (id (t.name));
+          m = i != size_t (-1) && test (cs, i);
+        }
+      }
+      else
+        match (cs, t.expr, m);
+
+      if (t.inverted)
+        m = !m;
+
+      switch (t.operation)
+      {
+      case '+': if (m) r = true;  break;
+      case '-': if (m) r = false; break;
+      case '&': r &= m;           break;
+      default: assert (false);
+      }
+    }
+  }
+
   path
   dash_components_to_path (const string& pattern)
   {
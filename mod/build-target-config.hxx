@@ -5,6 +5,7 @@
 #define MOD_BUILD_TARGET_CONFIG_HXX
 
 #include <map>
+#include <unordered_map>
 
 #include <libbutl/target-triplet.hxx>
 
@@ -22,6 +23,84 @@ namespace brep
   using build_target_config  = bbot::build_target_config;
   using build_target_configs = bbot::build_target_configs;
 
+  // Compiled build class inheritance for a list of build target
+  // configurations.
+  //
+  // Assign dense ids to all the classes mentioned in the configurations and
+  // the class inheritance map and precompute for each class and
+  // configuration the bitset of classes it belongs to, directly or via
+  // inheritance. This way the class membership test and build class
+  // expression matching become bitset operations rather than the inheritance
+  // map walks with string comparisons.
+  //
+  // Note that the index refers to the configurations list, which must not
+  // change or move while the index is in use.
+  //
+  class build_class_index
+  {
+  public:
+    explicit
+    build_class_index (const build_target_configs&);
+
+    // Return true if a class is derived from the base class, recursively.
+    //
+    bool
+    derived (const string&, const string& base_class) const;
+
+    // Return true if the configuration belongs to the specified class.
+    //
+    bool
+    belongs (const build_target_config&, const string&) const;
+
+    // Match the configuration against the build class expression, updating
+    // the result (see bpkg::build_class_expr::match() for details).
+    //
+    void
+    match (const build_target_config&,
+           const build_class_expr&,
+           bool& result) const;
+
+  private:
+    using class_set = vector<std::uint64_t>;
+
+    static bool
+    test (const class_set& s, size_t id)
+    {
+      return (s[id / 64] & (std::uint64_t (1) << (id % 64))) != 0;
+    }
+
+    // Return the class id or -1 if the class is unknown.
+    //
+    size_t
+    id (const string&) const;
+
+    // Return the configuration class set or NULL if the configuration
+    // doesn't belong to the indexed list, in which case the functions above
+    // fall back to walking the class inheritance map.
+    //
+    const class_set*
+    classes (const build_target_config&) const;
+
+    void
+    match (const class_set&,
+           const vector<bpkg::build_class_term>&,
+           bool& result) const;
+
+  private:
+    const build_target_configs& configs_;
+
+    std::unordered_map<string, size_t> ids_;
+
+    // Class ancestor sets, including the class itself, indexed by class ids.
+    //
+    vector<class_set> bases_;
+
+    // Configuration class sets, indexed by configuration positions in the
+    // list.
+    //
+    vector<class_set> config_classes_;
+  };
+
   // Return true if the specified build target configuration is excluded by a
   // package configuration based on its underlying build class set, build
   // class expressions, and build constraints, potentially extending the
@@ -57,6 +136,35 @@ namespace brep
                     default_all_ucs);
   }
 
+  // As above but match the build class expressions using the compiled class
+  // inheritance (see above).
+  //
+  bool
+  exclude (const build_class_exprs& builds,
+           const build_constraints& constraints,
+           const build_target_config&,
+           const build_class_index&,
+           string* reason = nullptr,
+           bool default_all_ucs = false);
+
+  template <typename K>
+  inline bool
+  exclude (const build_package_config_template<K>& pc,
+           const build_class_exprs& common_builds,
+           const build_constraints& common_constraints,
+           const build_target_config& tc,
+           const build_class_index& class_index,
+           string* reason = nullptr,
+           bool default_all_ucs = false)
+  {
+    return exclude (pc.effective_builds (common_builds),
+                    pc.effective_constraints (common_constraints),
+                    tc,
+                    class_index,
+                    reason,
+                    default_all_ucs);
+  }
+
   // Convert dash-separated components (target, build target configuration
   // name, machine name) or a pattern thereof into a path, replacing dashes
   // with slashes (directory separators), `**` with `*/**/*`, and appending
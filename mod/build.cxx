@@ -15,6 +15,7 @@
 #include <libbrep/build-package-odb.hxx>
 
 #include <mod/utility.hxx>
+#include <mod/request-profile.hxx>
 
 namespace brep
 {
@@ -30,15 +31,33 @@ namespace brep
     // needs to be url-encoded, and only in the query part of the URL. We embed
     // the package version into the URL path part and so don't encode it.
     //
-    string url (
-      host + tenant_dir (root, b.tenant).representation ()             +
-      mime_url_encode (b.package_name.string (), false) + '/'          +
-      b.package_version.string () + "/log/"                            +
-      mime_url_encode (b.target.string (), false /* query */) + '/'    +
-      mime_url_encode (b.target_config_name, false /* query */) + '/'  +
-      mime_url_encode (b.package_config_name, false /* query */) + '/' +
-      mime_url_encode (b.toolchain_name, false /* query */) + '/'      +
-      b.toolchain_version.string ());
+    // Also note that we compose the URL in a single buffer to avoid creating
+    // the temporary strings, since this function is called multiple times
+    // for every build on the builds pages.
+    //
+    string url;
+    url.reserve (256);
+
+    auto add = [&url] (const string& v)
+    {
+      mime_url_encode (v.c_str (), v.size (), url, false /* query */);
+      url += '/';
+    };
+
+    url += host;
+    url += tenant_dir (root, b.tenant).representation ();
+
+    add (b.package_name.string ());
+
+    url += b.package_version.string ();
+    url += "/log/";
+
+    add (b.target.string ());
+    add (b.target_config_name);
+    add (b.package_config_name);
+    add (b.toolchain_name);
+
+    url += b.toolchain_version.string ();
 
     if (op != nullptr)
     {
@@ -57,15 +76,36 @@ namespace brep
     // we embed the package version into the URL query part, where it is not
     // encoded by design.
     //
-    return host + tenant_dir (root, b.tenant).string ()               +
-      "?build-force&pn=" + mime_url_encode (b.package_name.string ()) +
-      "&pv=" + b.package_version.string ()                            +
-      "&tg=" + mime_url_encode (b.target.string ())                   +
-      "&tc=" + mime_url_encode (b.target_config_name)                 +
-      "&pc=" + mime_url_encode (b.package_config_name)                +
-      "&tn=" + mime_url_encode (b.toolchain_name)                     +
-      "&tv=" + b.toolchain_version.string ()                          +
-      "&reason=";
+    // Also note that we compose the URL in a single buffer (see
+    // build_log_url() for details).
+    //
+    string url;
+    url.reserve (256);
+
+    auto add = [&url] (const char* n, const string& v)
+    {
+      url += n;
+      mime_url_encode (v.c_str (), v.size (), url);
+    };
+
+    url += host;
+    url += tenant_dir (root, b.tenant).string ();
+
+    add ("?build-force&pn=", b.package_name.string ());
+
+    url += "&pv=";
+    url += b.package_version.string ();
+
+    add ("&tg=", b.target.string ());
+    add ("&tc=", b.target_config_name);
+    add ("&pc=", b.package_config_name);
+    add ("&tn=", b.toolchain_name);
+
+    url += "&tv=";
+    url += b.toolchain_version.string ();
+    url += "&reason=";
+
+    return url;
   }
 
   void
@@ -133,6 +173,8 @@ namespace brep
         if (trace != nullptr)
           *trace << "email '" << subj << "' to " << to;
 
+        request_phase rp ("sendmail");
+
         // Redirect the diagnostics to webserver error log.
         //
         sendmail sm ([trace] (const char* args[], size_t n)
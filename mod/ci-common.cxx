@@ -22,6 +22,7 @@
 #include <mod/utility.hxx>          // sleep_before_retry()
 #include <mod/database-module.hxx>  // database_module::cancel_tenant()
 #include <mod/external-handler.hxx>
+#include <mod/request-profile.hxx>
 
 namespace brep
 {
@@ -426,6 +427,8 @@ namespace brep
     if (ops.ci_email_specified () && !simulate)
     try
     {
+      request_phase rp ("sendmail");
+
       // Redirect the diagnostics to the web server error log.
       //
       sendmail sm ([trace] (const char* args[], size_t n)
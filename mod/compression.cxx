@@ -0,0 +1,83 @@
+// file      : mod/compression.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/compression.hxx>
+
+#include <zstd.h>
+
+using namespace std;
+
+namespace brep
+{
+  vector<char>
+  zstd_compress (const char* data, size_t size, int level)
+  {
+    vector<char> r (ZSTD_compressBound (size));
+
+    size_t n (ZSTD_compress (r.data (), r.size (), data, size, level));
+
+    if (ZSTD_isError (n))
+      throw runtime_error (string ("unable to compress data: ") +
+                           ZSTD_getErrorName (n));
+
+    r.resize (n);
+    r.shrink_to_fit ();
+    return r;
+  }
+
+  void
+  zstd_decompress (const char* data, size_t size,
+                   const function<void (const char*, size_t)>& f)
+  {
+    struct context_deleter
+    {
+      void operator() (ZSTD_DCtx* c) const {ZSTD_freeDCtx (c);}
+    };
+
+    unique_ptr<ZSTD_DCtx, context_deleter> ctx (ZSTD_createDCtx ());
+
+    if (ctx == nullptr)
+      throw runtime_error ("unable to create zstd decompression context");
+
+    vector<char> buf (ZSTD_DStreamOutSize ());
+
+    ZSTD_inBuffer in {data, size, 0};
+
+    // Note that the last ZSTD_decompressStream() call result is zero if the
+    // frame is completely decoded and flushed.
+    //
+    size_t r (0);
+    while (in.pos != in.size)
+    {
+      ZSTD_outBuffer out {buf.data (), buf.size (), 0};
+
+      r = ZSTD_decompressStream (ctx.get (), &out, &in);
+
+      if (ZSTD_isError (r))
+        throw runtime_error (string ("unable to decompress data: ") +
+                             ZSTD_getErrorName (r));
+
+      if (out.pos != 0)
+        f (buf.data (), out.pos);
+
+      // Drain the decoder's internal buffers if the input is exhausted but
+      // the decompressed data doesn't fit into the output buffer.
+      //
+      while (in.pos == in.size && r != 0 && out.pos == out.size)
+      {
+        out = ZSTD_outBuffer {buf.data (), buf.size (), 0};
+        r = ZSTD_decompressStream (ctx.get (), &out, &in);
+
+        if (ZSTD_isError (r))
+          throw runtime_error (string ("unable to decompress data: ") +
+                               ZSTD_getErrorName (r));
+
+        if (out.pos != 0)
+          f (buf.data (), out.pos);
+      }
+    }
+
+    if (r != 0)
+      throw runtime_error ("unable to decompress data: truncated input");
+  }
+}
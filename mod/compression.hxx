@@ -0,0 +1,43 @@
+// file      : mod/compression.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_COMPRESSION_HXX
+#define MOD_COMPRESSION_HXX
+
+#include <libbrep/types.hxx>
+#include <libbrep/utility.hxx>
+
+namespace brep
+{
+  // Compress the data using the zstd algorithm with the specified compression
+  // level. Throw runtime_error on failure.
+  //
+  vector<char>
+  zstd_compress (const char* data, size_t size, int level);
+
+  inline vector<char>
+  zstd_compress (const string& s, int level)
+  {
+    return zstd_compress (s.data (), s.size (), level);
+  }
+
+  // Decompress the zstd-compressed data, passing the decompressed data to the
+  // specified function in fixed-size chunks as they become available. Thus,
+  // the memory consumption doesn't depend on the decompressed data size.
+  // Throw runtime_error if the data is corrupted or truncated. Note that in
+  // this case some decompressed data may have already been passed to the
+  // function.
+  //
+  void
+  zstd_decompress (const char* data, size_t size,
+                   const function<void (const char*, size_t)>&);
+
+  inline void
+  zstd_decompress (const vector<char>& d,
+                   const function<void (const char*, size_t)>& f)
+  {
+    zstd_decompress (d.data (), d.size (), f);
+  }
+}
+
+#endif // MOD_COMPRESSION_HXX
@@ -9,6 +9,9 @@
 #include <odb/pgsql/database.hxx>
 #include <odb/pgsql/connection-factory.hxx>
 
+#include <mod/handler-metrics.hxx>
+#include <mod/request-profile.hxx>
+
 namespace brep
 {
   struct db_key
@@ -66,6 +69,16 @@ namespace brep
       return conn;
     }
 
+    // Note that acquiring a connection may block until one is returned to
+    // the pool, so record it as a separate request phase.
+    //
+    virtual pgsql::connection_ptr
+    connect () override
+    {
+      request_phase p ("db-connect");
+      return pgsql::connection_pool_factory::connect ();
+    }
+
   private:
     string role_;
   };
@@ -106,6 +119,11 @@ namespace brep
         "",
         move (f)));
 
+    // Measure the time spent in the database transactions for the handler
+    // metrics.
+    //
+    d->tracer (handler_metrics::db_tracer ());
+
     databases[move (k)] = d;
     return d;
   }
@@ -18,6 +18,8 @@
 #include <libbutl/process-io.hxx>      // operator<<(ostream, process_args)
 #include <libbutl/manifest-parser.hxx>
 
+#include <mod/request-profile.hxx>
+
 using namespace std;
 using namespace butl;
 
@@ -78,6 +80,8 @@ namespace brep
       for (;;) // Breakout loop.
       try
       {
+        request_phase rp ("external-handler");
+
         fdpipe pipe (fdopen_pipe ()); // Can throw io_error.
 
         // Redirect the diagnostics to the web server error log.
@@ -0,0 +1,418 @@
+// file      : mod/handler-metrics.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/handler-metrics.hxx>
+
+#include <odb/tracer.hxx>
+
+#include <libbutl/process.hxx> // process::current_id()
+
+#include <mod/request-profile.hxx>
+
+#include <mutex>
+#include <atomic>
+#include <algorithm> // stable_sort()
+#include <cstdio>    // snprintf()
+#include <cstring>   // strcmp()
+#include <cinttypes> // PRIu64
+#include <stdexcept> // runtime_error
+
+using namespace std;
+using namespace std::chrono;
+
+namespace brep
+{
+  // The maximum number of the handlers which can be registered. Should be
+  // enough for all the handler types.
+  //
+  static const size_t max_handlers = 32;
+
+  static const size_t outcome_count = 5;
+
+  static const char* const outcome_names[outcome_count] = {
+    "handled", "declined", "retried", "invalid", "failed"};
+
+  // Latency histogram bucket upper bounds (the last +Inf bucket is
+  // implied).
+  //
+  static const struct
+  {
+    uint64_t    ns;
+    const char* le;
+  } bucket_bounds[] = {
+    {5000000,     "0.005"},
+    {10000000,    "0.01"},
+    {25000000,    "0.025"},
+    {50000000,    "0.05"},
+    {100000000,   "0.1"},
+    {250000000,   "0.25"},
+    {500000000,   "0.5"},
+    {1000000000,  "1"},
+    {2500000000,  "2.5"},
+    {5000000000,  "5"},
+    {10000000000, "10"}};
+
+  static const size_t bucket_count =
+    sizeof (bucket_bounds) / sizeof (bucket_bounds[0]) + 1;
+
+  // Counters of a single handler. Note that the histogram buckets are not
+  // cumulative.
+  //
+  template <typename T>
+  struct handler_counters
+  {
+    T outcomes[outcome_count];
+    T buckets[bucket_count];
+    T latency; // Nanoseconds.
+    T db;      // Nanoseconds.
+    T bytes;
+  };
+
+  // Counters of all the handlers for a single thread.
+  //
+  struct shard
+  {
+    handler_counters<atomic<uint64_t>> handlers[max_handlers];
+  };
+
+  // Note that the registry is never destroyed, so that it outlives the
+  // thread-local shard owners (see below).
+  //
+  struct registry
+  {
+    mutex m;
+    vector<unique_ptr<handler_metrics>> handlers;
+    vector<unique_ptr<shard>> shards;
+    vector<shard*> free_shards;
+  };
+
+  static registry&
+  metrics_registry ()
+  {
+    static registry& r (*new registry ());
+    return r;
+  }
+
+  // Return the thread's shard to the registry on the thread termination.
+  //
+  struct shard_owner
+  {
+    shard* s = nullptr;
+
+    ~shard_owner ()
+    {
+      if (s != nullptr)
+      {
+        registry& r (metrics_registry ());
+
+        lock_guard<mutex> l (r.m);
+        r.free_shards.push_back (s);
+      }
+    }
+  };
+
+  static thread_local shard_owner this_shard;
+
+  static shard&
+  current_shard ()
+  {
+    if (this_shard.s == nullptr)
+    {
+      registry& r (metrics_registry ());
+
+      lock_guard<mutex> l (r.m);
+
+      if (!r.free_shards.empty ())
+      {
+        this_shard.s = r.free_shards.back ();
+        r.free_shards.pop_back ();
+      }
+      else
+      {
+        r.shards.push_back (unique_ptr<shard> (new shard ()));
+        this_shard.s = r.shards.back ().get ();
+      }
+    }
+
+    return *this_shard.s;
+  }
+
+  // Note that the counter is only modified by the owning thread and so we
+  // don't need the (more expensive) atomic increment.
+  //
+  static inline void
+  add (atomic<uint64_t>& c, uint64_t v)
+  {
+    c.store (c.load (memory_order_relaxed) + v, memory_order_relaxed);
+  }
+
+  handler_metrics& handler_metrics::
+  instance (const string& n)
+  {
+    registry& r (metrics_registry ());
+
+    lock_guard<mutex> l (r.m);
+
+    for (const unique_ptr<handler_metrics>& h: r.handlers)
+    {
+      if (h->name_ == n)
+        return *h;
+    }
+
+    if (r.handlers.size () == max_handlers)
+      throw runtime_error ("too many handlers for metrics");
+
+    r.handlers.push_back (
+      unique_ptr<handler_metrics> (
+        new handler_metrics (r.handlers.size (), n)));
+
+    return *r.handlers.back ();
+  }
+
+  handler_metrics::gauge& handler_metrics::
+  add_gauge (const string& n, const string& h)
+  {
+    registry& r (metrics_registry ());
+
+    lock_guard<mutex> l (r.m);
+
+    for (const unique_ptr<gauge>& g: gauges_)
+    {
+      if (g->name_ == n)
+        return *g;
+    }
+
+    gauges_.push_back (unique_ptr<gauge> (new gauge (n, h)));
+    return *gauges_.back ();
+  }
+
+  void handler_metrics::
+  record (outcome o, nanoseconds latency, nanoseconds db, size_t bytes)
+  {
+    handler_counters<atomic<uint64_t>>& c (
+      current_shard ().handlers[index_]);
+
+    uint64_t ns (latency.count ());
+
+    size_t i (0);
+    for (; i != bucket_count - 1 && ns > bucket_bounds[i].ns; ++i) ;
+
+    add (c.outcomes[static_cast<size_t> (o)], 1);
+    add (c.buckets[i], 1);
+    add (c.latency, ns);
+    add (c.db, db.count ());
+    add (c.bytes, bytes);
+  }
+
+  // Print nanoseconds as seconds without losing precision.
+  //
+  static void
+  print_seconds (ostream& os, uint64_t ns)
+  {
+    char b[32];
+    snprintf (b, sizeof (b),
+              "%" PRIu64 ".%09" PRIu64,
+              ns / 1000000000, ns % 1000000000);
+    os << b;
+  }
+
+  void handler_metrics::
+  print (ostream& os)
+  {
+    using counters = handler_counters<uint64_t>;
+
+    // Sum up the per-thread counters and collect the gauge values.
+    //
+    struct gauge_value
+    {
+      string name;
+      string help;
+      string handler;
+      uint64_t value;
+    };
+
+    vector<pair<string, counters>> hs;
+    vector<gauge_value> gs;
+    {
+      registry& r (metrics_registry ());
+
+      lock_guard<mutex> l (r.m);
+
+      hs.reserve (r.handlers.size ());
+
+      for (const unique_ptr<handler_metrics>& h: r.handlers)
+      {
+        counters c {};
+
+        for (const unique_ptr<shard>& s: r.shards)
+        {
+          const handler_counters<atomic<uint64_t>>& sc (
+            s->handlers[h->index_]);
+
+          auto load = [] (const atomic<uint64_t>& v)
+          {
+            return v.load (memory_order_relaxed);
+          };
+
+          for (size_t i (0); i != outcome_count; ++i)
+            c.outcomes[i] += load (sc.outcomes[i]);
+
+          for (size_t i (0); i != bucket_count; ++i)
+            c.buckets[i] += load (sc.buckets[i]);
+
+          c.latency += load (sc.latency);
+          c.db      += load (sc.db);
+          c.bytes   += load (sc.bytes);
+        }
+
+        hs.emplace_back (h->name_, c);
+
+        for (const unique_ptr<gauge>& g: h->gauges_)
+          gs.push_back (gauge_value {g->name_,
+                                     g->help_,
+                                     h->name_,
+                                     g->value_.load (memory_order_relaxed)});
+      }
+    }
+
+    // Label each time series with the process id since the metrics are
+    // accumulated per web server process.
+    //
+    string lb ("{pid=\"" + to_string (butl::process::current_id ()) +
+               "\",handler=\"");
+
+    os << "# HELP brep_requests_total Number of requests by outcome.\n"
+       << "# TYPE brep_requests_total counter\n";
+
+    for (const auto& h: hs)
+    {
+      for (size_t i (0); i != outcome_count; ++i)
+        os << "brep_requests_total" << lb << h.first << "\",outcome=\""
+           << outcome_names[i] << "\"} " << h.second.outcomes[i] << '\n';
+    }
+
+    os << "# HELP brep_request_duration_seconds Request handling latency.\n"
+       << "# TYPE brep_request_duration_seconds histogram\n";
+
+    for (const auto& h: hs)
+    {
+      const counters& c (h.second);
+
+      uint64_t n (0);
+      for (size_t i (0); i != bucket_count; ++i)
+      {
+        n += c.buckets[i];
+
+        os << "brep_request_duration_seconds_bucket" << lb << h.first
+           << "\",le=\""
+           << (i != bucket_count - 1 ? bucket_bounds[i].le : "+Inf")
+           << "\"} " << n << '\n';
+      }
+
+      os << "brep_request_duration_seconds_sum" << lb << h.first << "\"} ";
+      print_seconds (os, c.latency);
+      os << '\n';
+
+      os << "brep_request_duration_seconds_count" << lb << h.first
+         << "\"} " << n << '\n';
+    }
+
+    os << "# HELP brep_request_db_seconds_total Time spent in database "
+       << "transactions.\n"
+       << "# TYPE brep_request_db_seconds_total counter\n";
+
+    for (const auto& h: hs)
+    {
+      os << "brep_request_db_seconds_total" << lb << h.first << "\"} ";
+      print_seconds (os, h.second.db);
+      os << '\n';
+    }
+
+    os << "# HELP brep_response_bytes_total Response content size before "
+       << "compression.\n"
+       << "# TYPE brep_response_bytes_total counter\n";
+
+    for (const auto& h: hs)
+      os << "brep_response_bytes_total" << lb << h.first << "\"} "
+         << h.second.bytes << '\n';
+
+    // Group the gauges by name, so that each metric is only described once
+    // even if the gauge is registered by multiple handlers.
+    //
+    stable_sort (gs.begin (), gs.end (),
+                 [] (const gauge_value& x, const gauge_value& y)
+                 {
+                   return x.name < y.name;
+                 });
+
+    for (size_t i (0); i != gs.size (); ++i)
+    {
+      const gauge_value& g (gs[i]);
+
+      if (i == 0 || gs[i - 1].name != g.name)
+        os << "# HELP brep_" << g.name << ' ' << g.help << '\n'
+           << "# TYPE brep_" << g.name << " gauge\n";
+
+      os << "brep_" << g.name << lb << g.handler << "\"} "
+         << g.value << '\n';
+    }
+  }
+
+  // Database tracer.
+  //
+  // Note that ODB traces the transaction BEGIN, COMMIT, and ROLLBACK
+  // statements right before executing them. Thus, strictly speaking, the
+  // transaction commit/rollback time is not accounted for. Also note that
+  // transactions are never nested within a thread.
+  //
+  struct db_transaction_time
+  {
+    nanoseconds total {0};
+    steady_clock::time_point start;
+    bool active = false;
+  };
+
+  static thread_local db_transaction_time db_transaction;
+
+  class db_time_tracer: public odb::tracer
+  {
+  public:
+    using odb::tracer::execute;
+
+    virtual void
+    execute (odb::connection&, const char* s) override
+    {
+      db_transaction_time& t (db_transaction);
+
+      if (strcmp (s, "BEGIN") == 0)
+      {
+        t.start = steady_clock::now ();
+        t.active = true;
+      }
+      else if (t.active &&
+               (strcmp (s, "COMMIT") == 0 || strcmp (s, "ROLLBACK") == 0))
+      {
+        steady_clock::time_point now (steady_clock::now ());
+
+        t.total += now - t.start;
+        t.active = false;
+
+        if (request_profile* p = request_profile::current ())
+          p->record ("transaction", t.start, now);
+      }
+    }
+  };
+
+  nanoseconds handler_metrics::
+  db_time () noexcept
+  {
+    return db_transaction.total;
+  }
+
+  odb::tracer& handler_metrics::
+  db_tracer ()
+  {
+    static db_time_tracer t;
+    return t;
+  }
+}
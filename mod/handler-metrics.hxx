@@ -0,0 +1,119 @@
+// file      : mod/handler-metrics.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_HANDLER_METRICS_HXX
+#define MOD_HANDLER_METRICS_HXX
+
+#include <atomic>
+#include <chrono>
+
+#include <libbrep/types.hxx>
+#include <libbrep/utility.hxx>
+
+namespace odb
+{
+  class tracer;
+}
+
+namespace brep
+{
+  // Process-wide per-handler request metrics: request counts by outcome,
+  // latency histograms, time spent in the database transactions, and the
+  // response content size.
+  //
+  // The metrics are accumulated in the per-thread (and thus per web server
+  // worker) counters, which are only updated by the owning thread without
+  // any locking or read-modify-write operations, and are only summed up when
+  // printed. The counters of a terminated thread are reused by the thread
+  // created later, so that nothing is lost.
+  //
+  // Note that the metrics are not shared between the web server processes
+  // and so are printed labeled with the process id.
+  //
+  class handler_metrics
+  {
+  public:
+    enum class outcome
+    {
+      handled,  // Handled successfully.
+      declined, // Declined to handle.
+      retried,  // Requested a retry.
+      invalid,  // Thrown invalid_request.
+      failed    // Failed with the internal server error.
+    };
+
+    // Return the metrics for the handler with the specified name, creating
+    // them if not yet present. Should normally only be called during the
+    // handler exemplar initialization. Throw runtime_error if too many
+    // handlers are registered.
+    //
+    static handler_metrics&
+    instance (const string& handler);
+
+    const string&
+    name () const {return name_;}
+
+    void
+    record (outcome,
+            std::chrono::nanoseconds latency,
+            std::chrono::nanoseconds db,
+            size_t bytes);
+
+    // Handler-specific gauge (for example, the currently chosen delay of
+    // some deferred work). Printed as
+    // brep_<name>{pid="<pid>",handler="<handler>"}.
+    //
+    class gauge
+    {
+    public:
+      void
+      set (uint64_t v) noexcept {value_.store (v, std::memory_order_relaxed);}
+
+    private:
+      friend class handler_metrics;
+
+      gauge (string n, string h): name_ (move (n)), help_ (move (h)) {}
+
+      string name_;
+      string help_;
+      std::atomic<uint64_t> value_ {0};
+    };
+
+    // Return the handler gauge with the specified name, registering it with
+    // the specified help text if not yet present. Should normally only be
+    // called during the handler exemplar initialization.
+    //
+    gauge&
+    add_gauge (const string& name, const string& help);
+
+    // Print the metrics of all the handlers in the Prometheus text format,
+    // labeling each time series with the current process id.
+    //
+    static void
+    print (ostream&);
+
+    // Return the total time the current thread spent in the database
+    // transactions, as accumulated by the database tracer (see below). Is
+    // normally used to calculate the request database time as a difference
+    // of the values before and after the request is handled.
+    //
+    static std::chrono::nanoseconds
+    db_time () noexcept;
+
+    // Return the ODB tracer which measures the time spent in the database
+    // transactions (between the BEGIN and COMMIT/ROLLBACK statements).
+    //
+    static odb::tracer&
+    db_tracer ();
+
+  private:
+    handler_metrics (size_t index, string name)
+        : index_ (index), name_ (move (name)) {}
+
+    size_t index_;
+    string name_;
+    vector<unique_ptr<gauge>> gauges_; // Protected by the registry mutex.
+  };
+}
+
+#endif // MOD_HANDLER_METRICS_HXX
@@ -1,7 +1,11 @@
 #include <mod/hmac.hxx>
 
+#include <openssl/evp.h>
+
 #include <libbutl/openssl.hxx>
 
+#include <mod/request-profile.hxx>
+
 using namespace std;
 using namespace butl;
 
@@ -12,6 +16,8 @@ compute_hmac (const options::openssl_options& o,
 {
   try
   {
+    request_phase rp ("openssl");
+
     fdpipe errp (fdopen_pipe ()); // stderr pipe.
 
     // To compute an HMAC over stdin with the key <secret>:
@@ -116,3 +122,129 @@ compute_hmac (const options::openssl_options& o,
       (string ("unable to read openssl stderr : ") + e.what ()).c_str ());
   }
 }
+
+string brep::
+compute_hmac (const void* m, size_t l, const string& k)
+{
+  hmac_sha256 h (k);
+  h.update (m, l);
+  return h.finish ();
+}
+
+namespace brep
+{
+  // hmac_sha256
+  //
+  hmac_sha256::
+  hmac_sha256 (const string& k)
+  {
+    // Note that HMAC is computed via the EVP digest signing interface which,
+    // unlike the HMAC_CTX functions, is not deprecated in OpenSSL 3.0.
+    //
+    EVP_PKEY* pk (
+      EVP_PKEY_new_raw_private_key (
+        EVP_PKEY_HMAC,
+        nullptr,
+        reinterpret_cast<const unsigned char*> (k.data ()),
+        k.size ()));
+
+    if (pk == nullptr)
+      throw_generic_error (EINVAL, "unable to create HMAC key");
+
+    EVP_MD_CTX* c (EVP_MD_CTX_new ());
+
+    if (c == nullptr)
+    {
+      EVP_PKEY_free (pk);
+      throw_generic_error (ENOMEM, "unable to create HMAC context");
+    }
+
+    // Note that the context holds its own reference to the key.
+    //
+    int r (EVP_DigestSignInit (c, nullptr, EVP_sha256 (), nullptr, pk));
+    EVP_PKEY_free (pk);
+
+    if (r != 1)
+    {
+      EVP_MD_CTX_free (c);
+      throw_generic_error (EINVAL, "unable to initialize HMAC context");
+    }
+
+    ctx_ = c;
+  }
+
+  hmac_sha256::
+  ~hmac_sha256 ()
+  {
+    EVP_MD_CTX_free (static_cast<EVP_MD_CTX*> (ctx_));
+  }
+
+  void hmac_sha256::
+  update (const void* d, size_t n)
+  {
+    if (EVP_DigestSignUpdate (static_cast<EVP_MD_CTX*> (ctx_), d, n) != 1)
+      throw_generic_error (EINVAL, "unable to compute HMAC");
+  }
+
+  string hmac_sha256::
+  finish ()
+  {
+    unsigned char d[EVP_MAX_MD_SIZE];
+    size_t n (sizeof (d));
+
+    if (EVP_DigestSignFinal (static_cast<EVP_MD_CTX*> (ctx_), d, &n) != 1)
+      throw_generic_error (EINVAL, "unable to compute HMAC");
+
+    // Return the value in the same (lower-case hexadecimal) form as the
+    // openssl program.
+    //
+    static const char digits[] = "0123456789abcdef";
+
+    string r;
+    r.reserve (n * 2);
+
+    for (size_t i (0); i != n; ++i)
+    {
+      r += digits[d[i] >> 4];
+      r += digits[d[i] & 0x0F];
+    }
+
+    return r;
+  }
+
+  // hmac_istreambuf
+  //
+  hmac_istreambuf::int_type hmac_istreambuf::
+  underflow ()
+  {
+    if (gptr () < egptr ())
+      return traits_type::to_int_type (*gptr ());
+
+    // Note that we read from the underlying stream buffer directly, so that
+    // reaching the end of the message doesn't trigger the failbit exception,
+    // if enabled for the underlying stream.
+    //
+    streamsize n (is_.rdbuf ()->sgetn (buf_, sizeof (buf_)));
+
+    if (n <= 0)
+      return traits_type::eof ();
+
+    hmac_.update (buf_, static_cast<size_t> (n));
+
+    setg (buf_, buf_, buf_ + n);
+    return traits_type::to_int_type (*gptr ());
+  }
+
+  string hmac_istreambuf::
+  finish ()
+  {
+    // Note that the data in the get area is already accounted for.
+    //
+    setg (buf_, buf_, buf_);
+
+    while (underflow () != traits_type::eof ())
+      setg (buf_, buf_, buf_);
+
+    return hmac_.finish ();
+  }
+}
@@ -1,6 +1,8 @@
 #ifndef MOD_HMAC_HXX
 #define MOD_HMAC_HXX
 
+#include <streambuf>
+
 #include <libbrep/types.hxx>
 #include <libbrep/utility.hxx>
 
@@ -20,10 +22,73 @@ namespace brep
   // Note that although any cryptographic hash function can be used to compute
   // an HMAC, this implementation supports only SHA-256.
   //
+  // This version computes the HMAC using the openssl program.
+  //
   string
   compute_hmac (const options::openssl_options&,
                 const void* message, size_t len,
                 const char* key);
+
+  // This version computes the HMAC in-process (using libcrypto).
+  //
+  string
+  compute_hmac (const void* message, size_t len, const string& key);
+
+  // Incremental in-process HMAC-SHA256 computation over a message which is
+  // supplied in chunks. Throw std::system_error in case of an error.
+  //
+  class hmac_sha256
+  {
+  public:
+    explicit
+    hmac_sha256 (const string& key);
+
+    ~hmac_sha256 ();
+
+    hmac_sha256 (const hmac_sha256&) = delete;
+    hmac_sha256& operator= (const hmac_sha256&) = delete;
+
+    void
+    update (const void* data, size_t size);
+
+    // Return the HMAC value in the same form as compute_hmac(). Should only
+    // be called once.
+    //
+    string
+    finish ();
+
+  private:
+    void* ctx_; // EVP_MD_CTX*
+  };
+
+  // Input stream buffer which reads the message from the underlying stream
+  // passing it through the incremental HMAC computation. Can be used to
+  // compute the HMAC of a message in the same pass as it is parsed.
+  //
+  // Note that the underlying stream buffer exceptions are propagated as is
+  // (so normally the badbit exception should be enabled for the stream which
+  // uses this buffer).
+  //
+  class hmac_istreambuf: public std::streambuf
+  {
+  public:
+    hmac_istreambuf (istream& is, const string& key)
+        : is_ (is), hmac_ (key) {}
+
+    // Read the rest of the message, if any, and return its HMAC (see above).
+    //
+    string
+    finish ();
+
+  protected:
+    virtual int_type
+    underflow () override;
+
+  private:
+    istream& is_;
+    hmac_sha256 hmac_;
+    char buf_[4096];
+  };
 }
 
 #endif
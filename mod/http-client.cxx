@@ -0,0 +1,255 @@
+// file      : mod/http-client.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/http-client.hxx>
+
+#include <curl/curl.h>
+
+#include <cerrno>
+
+#include <libbutl/utility.hxx> // throw_generic_error()
+
+using namespace std;
+using namespace butl;
+
+namespace brep
+{
+  // http_client::response
+  //
+  const string* http_client::response::
+  header (const string& n) const
+  {
+    for (const pair<string, string>& h: headers)
+    {
+      if (icasecmp (h.first, n) == 0)
+        return &h.second;
+    }
+
+    return nullptr;
+  }
+
+  // http_client
+  //
+  static once_flag global_init;
+
+  http_client::
+  http_client (size_t max_idle)
+      : max_idle_ (max_idle)
+  {
+    // Note that curl_global_init() is not thread-safe and must be called
+    // before any other libcurl function.
+    //
+    call_once (global_init,
+               [] ()
+               {
+                 CURLcode r (curl_global_init (CURL_GLOBAL_DEFAULT));
+
+                 if (r != CURLE_OK)
+                   throw runtime_error (string ("unable to initialize "
+                                                "libcurl: ") +
+                                        curl_easy_strerror (r));
+               });
+  }
+
+  http_client::
+  ~http_client ()
+  {
+    for (void* h: idle_)
+      curl_easy_cleanup (static_cast<CURL*> (h));
+  }
+
+  void* http_client::
+  acquire ()
+  {
+    {
+      lock_guard<mutex> l (mutex_);
+
+      if (!idle_.empty ())
+      {
+        void* r (idle_.back ());
+        idle_.pop_back ();
+        return r;
+      }
+    }
+
+    CURL* r (curl_easy_init ());
+
+    if (r == nullptr)
+      throw_generic_error (ENOMEM, "unable to create libcurl handle");
+
+    return r;
+  }
+
+  void http_client::
+  release (void* h)
+  {
+    {
+      lock_guard<mutex> l (mutex_);
+
+      if (idle_.size () < max_idle_)
+      {
+        idle_.push_back (h);
+        return;
+      }
+    }
+
+    curl_easy_cleanup (static_cast<CURL*> (h));
+  }
+
+  // libcurl callbacks.
+  //
+  extern "C" size_t
+  brep_http_client_write (char* d, size_t, size_t n, void* p)
+  {
+    static_cast<string*> (p)->append (d, n);
+    return n;
+  }
+
+  extern "C" size_t
+  brep_http_client_header (char* d, size_t, size_t n, void* hd)
+  {
+    auto& hs (*static_cast<vector<pair<string, string>>*> (hd));
+
+    string l (d, n);
+    trim (l); // Strip CRLF.
+
+    // Start over on the status line of each response (redirect, 100
+    // Continue, etc). Note that the header block terminating blank line is
+    // skipped.
+    //
+    if (l.compare (0, 5, "HTTP/") == 0)
+      hs.clear ();
+    else if (!l.empty ())
+    {
+      size_t p (l.find (':'));
+
+      if (p != string::npos)
+      {
+        string v (l, p + 1);
+        l.resize (p);
+
+        hs.emplace_back (move (trim (l)), move (trim (v)));
+      }
+    }
+
+    return n;
+  }
+
+  http_client::response http_client::
+  post (const string& url, const strings& hdrs, const string& body)
+  {
+    struct handle_guard
+    {
+      http_client& client;
+      CURL* handle;
+
+      // Release the handle into the pool unless the request has failed
+      // (in which case its connection is likely in a bad state).
+      //
+      bool failed = true;
+
+      ~handle_guard ()
+      {
+        // Reset the options that refer to the request-local data (error
+        // buffer, header list, etc). Note that this keeps the connection
+        // cache and the TLS session cache.
+        //
+        curl_easy_reset (handle);
+
+        if (!failed)
+          client.release (handle);
+        else
+          curl_easy_cleanup (handle);
+      }
+    };
+
+    struct slist_deleter
+    {
+      void operator() (curl_slist* l) const {curl_slist_free_all (l);}
+    };
+
+    unique_ptr<curl_slist, slist_deleter> hl;
+    {
+      auto append = [&hl] (const char* v)
+      {
+        // Note that the list head only changes on the first append.
+        //
+        curl_slist* l (curl_slist_append (hl.get (), v));
+
+        if (l == nullptr)
+          throw_generic_error (ENOMEM, "unable to create libcurl header list");
+
+        if (hl == nullptr)
+          hl.reset (l);
+      };
+
+      for (const string& v: hdrs)
+        append (v.c_str ());
+
+      // Don't wait for 100 Continue before sending large bodies.
+      //
+      append ("Expect:");
+    }
+
+    response r;
+
+    char eb[CURL_ERROR_SIZE];
+    eb[0] = '\0';
+
+    // Note: must be destroyed first (see above).
+    //
+    handle_guard g {*this, static_cast<CURL*> (acquire ())};
+    CURL* h (g.handle);
+
+    // Note: don't send signals in the multi-threaded environment.
+    //
+    curl_easy_setopt (h, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt (h, CURLOPT_URL, url.c_str ());
+    curl_easy_setopt (h, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    curl_easy_setopt (h, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt (h, CURLOPT_CONNECTTIMEOUT, 30L);
+
+    // Fail if the transfer stalls for a minute.
+    //
+    curl_easy_setopt (h, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt (h, CURLOPT_LOW_SPEED_TIME, 60L);
+
+    curl_easy_setopt (h, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt (h, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
+
+    curl_easy_setopt (h, CURLOPT_POST, 1L);
+    curl_easy_setopt (h, CURLOPT_POSTFIELDS, body.c_str ());
+    curl_easy_setopt (h,
+                      CURLOPT_POSTFIELDSIZE_LARGE,
+                      static_cast<curl_off_t> (body.size ()));
+
+    curl_easy_setopt (h, CURLOPT_HTTPHEADER, hl.get ());
+
+    curl_easy_setopt (h, CURLOPT_WRITEFUNCTION, &brep_http_client_write);
+    curl_easy_setopt (h, CURLOPT_WRITEDATA, &r.body);
+    curl_easy_setopt (h, CURLOPT_HEADERFUNCTION, &brep_http_client_header);
+    curl_easy_setopt (h, CURLOPT_HEADERDATA, &r.headers);
+
+    curl_easy_setopt (h, CURLOPT_ERRORBUFFER, eb);
+
+    CURLcode c (curl_easy_perform (h));
+
+    if (c != CURLE_OK)
+    {
+      string e ("unable to POST to ");
+      e += url;
+      e += ": ";
+      e += eb[0] != '\0' ? eb : curl_easy_strerror (c);
+
+      throw_generic_error (c == CURLE_OPERATION_TIMEDOUT ? ETIMEDOUT : EIO,
+                           e.c_str ());
+    }
+
+    long sc;
+    curl_easy_getinfo (h, CURLINFO_RESPONSE_CODE, &sc);
+    r.status = static_cast<uint16_t> (sc);
+
+    g.failed = false;
+    return r;
+  }
+}
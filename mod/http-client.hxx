@@ -0,0 +1,78 @@
+// file      : mod/http-client.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_HTTP_CLIENT_HXX
+#define MOD_HTTP_CLIENT_HXX
+
+#include <mutex>
+
+#include <libbrep/types.hxx>
+#include <libbrep/utility.hxx>
+
+namespace brep
+{
+  // In-process HTTP/1.1 client (based on libcurl) which keeps the
+  // connections to the servers (and the TLS sessions) alive between the
+  // requests.
+  //
+  // The client maintains a pool of the libcurl easy handles, each with its
+  // own connection cache, which are acquired for the duration of a request.
+  // Thus, the client can be used concurrently by the web server worker
+  // threads and the number of the kept alive connections is proportional to
+  // the number of the concurrent requests.
+  //
+  class http_client
+  {
+  public:
+    struct response
+    {
+      uint16_t status;
+
+      // Response header names and values in the order received. Note that
+      // only the headers of the final response are kept if redirects are
+      // followed.
+      //
+      vector<pair<string, string>> headers;
+
+      string body;
+
+      // Return the value of the header with the specified (case-insensitive)
+      // name or NULL if there is no such header.
+      //
+      const string*
+      header (const string& name) const;
+    };
+
+    // Keep at most the specified number of idle easy handles (and thus their
+    // connections) in the pool.
+    //
+    explicit
+    http_client (size_t max_idle = 16);
+
+    ~http_client ();
+
+    http_client (const http_client&) = delete;
+    http_client& operator= (const http_client&) = delete;
+
+    // Send the POST request with the specified headers (in the "Name: value"
+    // form) and body, following redirects. Return the response whatever its
+    // status code. Throw system_error if unable to send the request or to
+    // receive the response (connection failure, timeout, etc).
+    //
+    response
+    post (const string& url, const strings& headers, const string& body);
+
+  private:
+    void*
+    acquire ();
+
+    void
+    release (void*);
+
+    std::mutex mutex_;
+    vector<void*> idle_; // CURL* handles.
+    size_t max_idle_;
+  };
+}
+
+#endif // MOD_HTTP_CLIENT_HXX
@@ -0,0 +1,90 @@
+// file      : mod/inplace-handler.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_INPLACE_HANDLER_HXX
+#define MOD_INPLACE_HANDLER_HXX
+
+#include <new>         // operator new(size_t, void*)
+#include <cstddef>     // size_t, max_align_t
+#include <utility>     // forward()
+#include <type_traits> // is_base_of
+
+namespace brep
+{
+  // Holder of a per-request sub-handler instance that is constructed in the
+  // holder's own storage of the specified size rather than on the heap. This
+  // way, provided the holder itself is allocated on the stack (as is the
+  // case for the web server handler instances), dispatching a request to a
+  // sub-handler doesn't incur any heap allocations besides the ones the
+  // sub-handler copy constructor may perform.
+  //
+  // The handler type is checked at compile time to fit the storage.
+  //
+  template <typename B, std::size_t N>
+  class inplace_handler
+  {
+  public:
+    inplace_handler () = default;
+
+    inplace_handler (const inplace_handler&) = delete;
+    inplace_handler& operator= (const inplace_handler&) = delete;
+
+    ~inplace_handler () {reset ();}
+
+    // Destroy the existing handler instance, if any, and construct the new
+    // one of the specified type.
+    //
+    template <typename T, typename... A>
+    T&
+    emplace (A&&... a)
+    {
+      static_assert (std::is_base_of<B, T>::value,
+                     "handler type must be derived from the base type");
+
+      static_assert (sizeof (T) <= N,
+                     "handler type doesn't fit the storage");
+
+      static_assert (alignof (T) <= alignof (std::max_align_t),
+                     "handler type is over-aligned");
+
+      reset ();
+
+      T* r (new (data_) T (std::forward<A> (a)...));
+
+      handler_ = r;
+      destroy_ = [] (void* p) {static_cast<T*> (p)->~T ();};
+
+      return *r;
+    }
+
+    void
+    reset () noexcept
+    {
+      if (handler_ != nullptr)
+      {
+        destroy_ (data_);
+        handler_ = nullptr;
+      }
+    }
+
+    B*
+    get () const noexcept {return handler_;}
+
+    B*
+    operator-> () const noexcept {return handler_;}
+
+    B&
+    operator* () const noexcept {return *handler_;}
+
+    explicit
+    operator bool () const noexcept {return handler_ != nullptr;}
+
+  private:
+    B* handler_ = nullptr;
+    void (*destroy_) (void*) = nullptr;
+
+    alignas (std::max_align_t) unsigned char data_[N];
+  };
+}
+
+#endif // MOD_INPLACE_HANDLER_HXX
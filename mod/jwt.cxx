@@ -1,9 +1,16 @@
 #include <mod/jwt.hxx>
 
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
 #include <libbutl/base64.hxx>
 #include <libbutl/openssl.hxx>
 #include <libbutl/json/serializer.hxx>
 
+#include <mod/request-profile.hxx>
+
 using namespace std;
 using namespace butl;
 
@@ -51,12 +58,12 @@ using namespace butl;
 //
 //   base64url($header) + '.' + base64url($payload) + '.' + base64url($signature)
 //
-string brep::
-generate_jwt (const options::openssl_options& o,
-              const path& pk,
-              const string& iss,
-              const chrono::seconds& vp,
-              const chrono::seconds& bd)
+// Return the JWT message (base64url-encoded header and payload).
+//
+static string
+jwt_message (const string& iss,
+             const chrono::seconds& vp,
+             const chrono::seconds& bd)
 {
   // Create the header.
   //
@@ -100,11 +107,25 @@ generate_jwt (const options::openssl_options& o,
     p = base64url_encode (b);
   }
 
+  return h + '.' + p;
+}
+
+string brep::
+generate_jwt (const options::openssl_options& o,
+              const path& pk,
+              const string& iss,
+              const chrono::seconds& vp,
+              const chrono::seconds& bd)
+{
+  string m (jwt_message (iss, vp, bd));
+
   // Create the signature.
   //
   string s; // Signature (base64url-encoded).
   try
   {
+    request_phase rp ("openssl");
+
     // Sign the concatenated header and payload using openssl.
     //
     //   openssl dgst -sha256 -sign <pkey> file...
@@ -135,9 +156,9 @@ generate_jwt (const options::openssl_options& o,
       ifdstream in (os.in.release (), fdstream_mode::skip);
       ofdstream out (os.out.release ());
 
-      // Write the concatenated header and payload to openssl's input.
+      // Write the message to openssl's input.
       //
-      out << h << '.' << p;
+      out << m;
       out.close ();
 
       // Read the binary signature from openssl's output.
@@ -185,5 +206,107 @@ generate_jwt (const options::openssl_options& o,
       (string ("unable to read openssl stderr : ") + e.what ()).c_str ());
   }
 
-  return h + '.' + p + '.' + s; // Return the token.
+  return m + '.' + s; // Return the token.
+}
+
+// jwt_private_key
+//
+// Throw system_error with the description of the last libcrypto error
+// appended to the specified message.
+//
+[[noreturn]] static void
+throw_crypto_error (const string& what)
+{
+  string m (what);
+
+  if (unsigned long e = ERR_get_error ())
+  {
+    char b[256];
+    ERR_error_string_n (e, b, sizeof (b));
+
+    m += ": ";
+    m += b;
+  }
+
+  ERR_clear_error ();
+
+  throw_generic_error (EINVAL, m.c_str ());
+}
+
+brep::jwt_private_key::
+jwt_private_key (const path& f)
+{
+  BIO* b (BIO_new_file (f.string ().c_str (), "r"));
+
+  if (b == nullptr)
+    throw_crypto_error ("unable to open " + f.string ());
+
+  EVP_PKEY* k (PEM_read_bio_PrivateKey (b, nullptr, nullptr, nullptr));
+  BIO_free (b);
+
+  if (k == nullptr)
+    throw_crypto_error ("unable to read private key from " + f.string ());
+
+  if (EVP_PKEY_base_id (k) != EVP_PKEY_RSA)
+  {
+    EVP_PKEY_free (k);
+    throw_generic_error (EINVAL,
+                         ("non-RSA private key in " + f.string ()).c_str ());
+  }
+
+  key_ = k;
+}
+
+brep::jwt_private_key::
+~jwt_private_key ()
+{
+  EVP_PKEY_free (static_cast<EVP_PKEY*> (key_));
+}
+
+vector<char> brep::jwt_private_key::
+sign (const string& m) const
+{
+  struct ctx_deleter
+  {
+    void operator() (EVP_MD_CTX* c) const {EVP_MD_CTX_free (c);}
+  };
+
+  unique_ptr<EVP_MD_CTX, ctx_deleter> c (EVP_MD_CTX_new ());
+
+  if (c == nullptr)
+    throw_generic_error (ENOMEM, "unable to create libcrypto digest context");
+
+  // Note that PKCS #1 v1.5 padding (which is what RS256 requires) is used by
+  // default for RSA keys.
+  //
+  if (EVP_DigestSignInit (c.get (),
+                          nullptr,
+                          EVP_sha256 (),
+                          nullptr,
+                          static_cast<EVP_PKEY*> (key_)) != 1)
+    throw_crypto_error ("unable to initialize signing");
+
+  vector<char> r (EVP_PKEY_size (static_cast<EVP_PKEY*> (key_)));
+  size_t n (r.size ());
+
+  if (EVP_DigestSign (c.get (),
+                      reinterpret_cast<unsigned char*> (r.data ()), &n,
+                      reinterpret_cast<const unsigned char*> (m.data ()),
+                      m.size ()) != 1)
+    throw_crypto_error ("unable to sign");
+
+  r.resize (n);
+  return r;
+}
+
+string brep::
+generate_jwt (const jwt_private_key& pk,
+              const string& iss,
+              const chrono::seconds& vp,
+              const chrono::seconds& bd)
+{
+  string m (jwt_message (iss, vp, bd));
+  string s (base64url_encode (pk.sign (m)));
+
+  return m + '.' + s; // Return the token.
 }
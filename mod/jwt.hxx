@@ -26,12 +26,51 @@ namespace brep
   //
   // Return the token or throw std::system_error in case of an error.
   //
+  // This version signs the token using the openssl program.
+  //
   string
   generate_jwt (const options::openssl_options&,
                 const path& private_key,
                 const string& issuer,
                 const std::chrono::seconds& validity_period,
                 const std::chrono::seconds& backdate = std::chrono::seconds (60));
+
+  // RSA private key for signing the JWTs in-process (using libcrypto).
+  //
+  // The key is loaded and parsed once and can then be used concurrently by
+  // multiple threads.
+  //
+  class jwt_private_key
+  {
+  public:
+    // Load the key from the PEM file. Throw std::system_error if unable to
+    // read or parse the file or if this is not an RSA key.
+    //
+    explicit
+    jwt_private_key (const path&);
+
+    ~jwt_private_key ();
+
+    jwt_private_key (const jwt_private_key&) = delete;
+    jwt_private_key& operator= (const jwt_private_key&) = delete;
+
+    // Sign the message using RSA with SHA256 and return the binary
+    // signature. Throw std::system_error in case of an error.
+    //
+    vector<char>
+    sign (const string& message) const;
+
+  private:
+    void* key_; // EVP_PKEY*
+  };
+
+  // This version signs the token in-process.
+  //
+  string
+  generate_jwt (const jwt_private_key&,
+                const string& issuer,
+                const std::chrono::seconds& validity_period,
+                const std::chrono::seconds& backdate = std::chrono::seconds (60));
 }
 
 #endif
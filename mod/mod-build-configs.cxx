@@ -35,7 +35,7 @@ init (scanner& s)
 
   if (options_->build_config_specified ())
   {
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
 
     if (options_->root ().empty ())
       options_->root (dir_path ("/"));
@@ -50,7 +50,7 @@ init (scanner& s)
   if (options_->build_config_specified ())
   {
     database_module::init (*options_, options_->build_db_retry ());
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
   }
 }
 
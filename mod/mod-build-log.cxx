@@ -3,6 +3,11 @@
 
 #include <mod/mod-build-log.hxx>
 
+#include <deque>
+#include <cstring>   // memchr()
+#include <sstream>
+#include <algorithm> // min(), max()
+
 #include <odb/database.hxx>
 #include <odb/transaction.hxx>
 
@@ -13,12 +18,117 @@
 #include <libbrep/build.hxx>
 #include <libbrep/build-odb.hxx>
 
+#include <mod/utility.hxx>     // sleep_before_retry()
+#include <mod/compression.hxx>
 #include <mod/module-options.hxx>
 
 using namespace std;
 using namespace brep::cli;
 using namespace odb::core;
 
+// The maximum size of the uncompressed operation log chunk we fetch from the
+// database at once.
+//
+static const uint64_t log_chunk_size (64 * 1024);
+
+// Return the build_result_log_chunks() function call arguments. If the
+// operation is NULL, then query all the build operation results. The build
+// timestamp is specified as nanoseconds since epoch.
+//
+static inline query<brep::build_result_log_chunk>
+log_chunks_param (const brep::build_id& id,
+                  const brep::string* op,
+                  uint64_t timestamp,
+                  uint64_t offset,
+                  uint64_t size)
+{
+  using query = query<brep::build_result_log_chunk>;
+
+  const brep::package_id& p (id.package);
+  const brep::canonical_version& tv (id.toolchain_version);
+
+  return "(" +
+    query::_val (p.tenant) + "," +
+    query::_val (p.name) + "," +
+    query::_val (p.version.epoch) + "," +
+    query::_val (p.version.canonical_upstream) + "," +
+    query::_val (p.version.canonical_release) + "," +
+    query::_val (p.version.revision) + "," +
+    query::_val (id.target) + "," +
+    query::_val (id.target_config_name) + "," +
+    query::_val (id.package_config_name) + "," +
+    query::_val (id.toolchain_name) + "," +
+    query::_val (tv.epoch) + "," +
+    query::_val (tv.canonical_upstream) + "," +
+    query::_val (tv.canonical_release) + "," +
+    query::_val (tv.revision) + "," +
+    (op != nullptr ? query (query::_val (*op)) : query ("NULL")) + "," +
+    query::_val (timestamp) + "," +
+    query::_val (offset) + "," +
+    query::_val (size) + ")";
+}
+
+// Parse the HTTP Range request header value for the content of the specified
+// size and return the requested [begin, end) byte range. Return nullopt if
+// the value is malformed or specifies multiple ranges, in which case the
+// header should be ignored, and the empty range if the requested range is
+// not satisfiable.
+//
+static brep::optional<pair<uint64_t, uint64_t>>
+parse_range (const brep::string& v, uint64_t size)
+{
+  using brep::string;
+  using brep::nullopt;
+  using brep::optional;
+
+  if (v.compare (0, 6, "bytes=") != 0 || v.find (',') != string::npos)
+    return nullopt;
+
+  size_t p (v.find ('-', 6));
+
+  if (p == string::npos)
+    return nullopt;
+
+  auto num = [] (const string& s) -> optional<uint64_t>
+  {
+    if (s.empty () || s.size () > 18)
+      return nullopt;
+
+    uint64_t r (0);
+    for (char c: s)
+    {
+      if (c < '0' || c > '9')
+        return nullopt;
+
+      r = r * 10 + (c - '0');
+    }
+
+    return r;
+  };
+
+  optional<uint64_t> f (num (string (v, 6, p - 6)));
+  optional<uint64_t> l (num (string (v, p + 1)));
+
+  // Suffix range (the last l bytes).
+  //
+  if (!f)
+  {
+    if (p != 6 || !l)
+      return nullopt;
+
+    uint64_t n (min (*l, size));
+    return make_pair (size - n, size);
+  }
+
+  if (l && *l < *f)
+    return nullopt;
+
+  if (*f >= size)
+    return make_pair (size, size);
+
+  return make_pair (*f, l ? min (*l + 1, size) : size);
+}
+
 // While currently the user-defined copy constructor is not required (we don't
 // need to deep copy nullptr's), it is a good idea to keep the placeholder
 // ready for less trivial cases.
@@ -40,7 +150,7 @@ init (scanner& s)
   if (options_->build_config_specified ())
   {
     database_module::init (*options_, options_->build_db_retry ());
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
   }
 
   if (options_->root ().empty ())
@@ -178,18 +288,31 @@ handle (request& rq, response& rs)
     throw invalid_request (400, e.what ());
   }
 
-  // Make sure no parameters passed.
-  //
+  size_t tail;
+  optional<string> range;
+
   try
   {
     name_value_scanner s (rq.parameters (1024));
-    params::build_log (s, unknown_mode::fail, unknown_mode::fail);
+    tail = params::build_log (
+      s, unknown_mode::fail, unknown_mode::fail).tail ();
   }
   catch (const cli::exception& e)
   {
     throw invalid_request (400, e.what ());
   }
 
+  // Note that we only support ranges for the complete logs.
+  //
+  if (tail == 0)
+  {
+    for (const name_value& h: rq.headers ())
+    {
+      if (icasecmp (h.name, "range") == 0 && h.value)
+        range = *h.value;
+    }
+  }
+
   // If the package build configuration expired (no such configuration,
   // package, etc), then we log this case with the trace severity and respond
   // with the 404 HTTP code (not found but may be available in the future).
@@ -214,9 +337,23 @@ handle (request& rq, response& rs)
       target_conf_map_->end ())
     config_expired ("no target configuration");
 
-  // Load the package build configuration (if present).
+  // Load the package build configuration (if present) and the operation
+  // results, omitting the logs.
+  //
+  // Note that we do it in a single transaction, so that the response content
+  // prefix and the log sizes are consistent. We then fetch the requested
+  // parts of the operation logs in bounded chunks while writing the response
+  // (see below) rather than loading them all in advance, making sure that
+  // the build hasn't changed in the meantime. Also note that we don't keep
+  // the transaction open while writing the response.
   //
   shared_ptr<build> b;
+  uint64_t ts;                    // Build timestamp (nanoseconds).
+  vector<build_result_log_chunk> results;
+
+  string prefix;                  // Response content prefix.
+  uint64_t size;                  // Response content size.
+  pair<uint64_t, uint64_t> bytes; // Requested [begin, end) content bytes.
   {
     transaction t (build_db_->begin ());
 
@@ -227,27 +364,35 @@ handle (request& rq, response& rs)
 
     b = move (pb.build);
     if (b->state != build_state::built)
-    {
       config_expired ("state is " + to_string (b->state));
-    }
-    else
-    {
-      build_db_->load (*b, b->results_section);
-      build_db_->load (*b, b->auxiliary_machines_section);
-    }
+
+    build_db_->load (*b, b->auxiliary_machines_section);
+
+    ts = static_cast<uint64_t> (
+      chrono::duration_cast<chrono::nanoseconds> (
+        b->timestamp.time_since_epoch ()).count ());
+
+    for (auto& r: build_db_->query<build_result_log_chunk> (
+           log_chunks_param (id,
+                             !op.empty () ? &op : nullptr,
+                             ts,
+                             0 /* offset */,
+                             0 /* size */)))
+      results.push_back (move (r));
+
+    if (!op.empty () && results.empty ())
+      config_expired ("no operation");
 
     t.commit ();
   }
 
-  // We have all the data so don't buffer the response content.
+  // Print the response content prefix (the build information and the
+  // operation statuses) into the string, so that we know its size in advance
+  // for the range requests.
   //
-  // Note that after we started to write the response content we need to be
-  // accurate not throwing any exceptions, that would mess up the response.
-  //
-  ostream& os (rs.content (200, "text/plain;charset=utf-8", false));
-
-  auto print_header = [&os, &b, this] ()
   {
+    ostringstream os;
+
     // Print the build tenant in the multi-tenant mode.
     //
     if (!b->tenant.empty ())
@@ -275,35 +420,338 @@ handle (request& rq, response& rs)
                      true /* local */);
 
     os << endl << endl;
+
+    for (const build_result_log_chunk& r: results)
+      os << r.operation << ": " << r.status << endl;
+
+    os << endl;
+
+    prefix = os.str ();
+  }
+
+  // Parse the requested byte range, if specified, and respond with the 416
+  // HTTP code (range not satisfiable) if it is outside the content.
+  //
+  size = prefix.size ();
+
+  for (const build_result_log_chunk& r: results)
+    size += r.size;
+
+  bytes = make_pair (0, size);
+
+  if (range)
+  {
+    if (optional<pair<uint64_t, uint64_t>> r = parse_range (*range, size))
+    {
+      if (r->first == r->second)
+      {
+        rs.header ("Content-Range",
+                   ("bytes */" + to_string (size)).c_str (),
+                   true /* error */);
+
+        throw invalid_request (416, "requested range not satisfiable");
+      }
+
+      bytes = *r;
+    }
+    else
+      range = nullopt;
+  }
+
+  if (tail == 0)
+    rs.header ("Accept-Ranges", "bytes");
+
+  if (range)
+    rs.header ("Content-Range",
+               ("bytes " + to_string (bytes.first) + '-' +
+                to_string (bytes.second - 1) + '/' +
+                to_string (size)).c_str ());
+
+  // We have all the data we need to start responding so don't buffer the
+  // response content.
+  //
+  // Note that after we started to write the response content we need to be
+  // accurate not throwing any exceptions, that would mess up the response.
+  // Thus, we log the log fetching and decompression errors and, unless
+  // responding with a range, append the diagnostics to the output.
+  //
+  ostream& os (rs.content (range ? 206 : 200,
+                           "text/plain;charset=utf-8",
+                           false));
+
+  auto fail = [&os, &range, &b, &error] (const build_result_log_chunk& r,
+                                         const string& d)
+  {
+    error << "unable to print " << r.operation << " log for "
+          << b->package_name << '/' << b->package_version << ' '
+          << b->target_config_name << '/' << b->target << ": " << d;
+
+    if (!range)
+      os << endl << "error: " << d << endl;
+  };
+
+  // Fetch the [offset, offset + size) bytes of the operation log in a
+  // separate transaction. Return false if the build has changed since we
+  // have loaded the operation results or the fetching has failed.
+  //
+  // Note that for the compressed log the entire compressed data is fetched
+  // (see build_result_log_chunks() for details).
+  //
+  auto fetch = [&id, ts, &fail, this] (const build_result_log_chunk& r,
+                                       uint64_t offset,
+                                       uint64_t n,
+                                       vector<char>& data) -> bool
+  {
+    for (size_t retry (0);;)
+    {
+      try
+      {
+        transaction t (build_db_->begin ());
+
+        build_result_log_chunk c;
+        bool f (build_db_->query_one<build_result_log_chunk> (
+                  log_chunks_param (id, &r.operation, ts, offset, n),
+                  c));
+
+        t.commit ();
+
+        if (!f || c.size != r.size || c.compressed != r.compressed)
+        {
+          fail (r, "build has changed");
+          return false;
+        }
+
+        if (!c.compressed && c.data.size () != n)
+        {
+          fail (r, "unexpected log chunk size");
+          return false;
+        }
+
+        data = move (c.data);
+        return true;
+      }
+      catch (const odb::recoverable& e)
+      {
+        if (retry == retry_max_)
+        {
+          fail (r, e.what ());
+          return false;
+        }
+
+        sleep_before_retry (retry++);
+      }
+      catch (const odb::exception& e)
+      {
+        fail (r, e.what ());
+        return false;
+      }
+    }
   };
 
-  if (op.empty ())
+  // Print the [begin, end) bytes of the operation log. Return false if the
+  // log printing has failed.
+  //
+  // Note that for the uncompressed log only these bytes are fetched, chunk
+  // by chunk.
+  //
+  auto print_log = [&os, &fail, &fetch] (const build_result_log_chunk& r,
+                                         uint64_t begin,
+                                         uint64_t end) -> bool
   {
-    print_header ();
+    vector<char> d;
 
-    for (const auto& r: b->results)
-      os << r.operation << ": " << r.status << endl;
+    if (r.compressed)
+    {
+      if (!fetch (r, 0, r.size, d))
+        return false;
 
-    os << endl;
+      try
+      {
+        uint64_t pos (0);
+
+        zstd_decompress (d,
+                         [&os, &pos, begin, end] (const char* d, size_t n)
+                         {
+                           uint64_t b (max (pos, begin));
+                           uint64_t e (min (pos + n, end));
+
+                           if (b < e)
+                             os.write (d + (b - pos), e - b);
+
+                           pos += n;
+                         });
+      }
+      catch (const runtime_error& e)
+      {
+        fail (r, e.what ());
+        return false;
+      }
+    }
+    else
+    {
+      for (uint64_t p (begin); p != end; )
+      {
+        uint64_t n (min (end - p, log_chunk_size));
 
-    for (const auto& r: b->results)
-      os << r.log;
+        if (!fetch (r, p, n, d))
+          return false;
+
+        os.write (d.data (), d.size ());
+        p += n;
+      }
+    }
+
+    return true;
+  };
+
+  // Print the last n lines of the operation log. Return false if the log
+  // printing has failed.
+  //
+  auto print_tail = [&os, &fail, &fetch, &print_log] (
+    const build_result_log_chunk& r, size_t n) -> bool
+  {
+    if (r.size == 0)
+      return true;
+
+    vector<char> d;
+
+    if (r.compressed)
+    {
+      if (!fetch (r, 0, r.size, d))
+        return false;
+
+      // Decompress the log, keeping the last n lines only.
+      //
+      deque<string> ls;
+      string l;
+
+      auto add = [&ls, &l, n] ()
+      {
+        ls.push_back (move (l));
+        l.clear ();
+
+        if (ls.size () > n)
+          ls.pop_front ();
+      };
+
+      try
+      {
+        zstd_decompress (d,
+                         [&l, &add] (const char* d, size_t s)
+                         {
+                           for (const char* e (d + s); d != e; )
+                           {
+                             const char* p (
+                               static_cast<const char*> (
+                                 memchr (d, '\n', e - d)));
+
+                             const char* le (p != nullptr ? p + 1 : e);
+
+                             l.append (d, le);
+                             d = le;
+
+                             if (p != nullptr)
+                               add ();
+                           }
+                         });
+      }
+      catch (const runtime_error& e)
+      {
+        fail (r, e.what ());
+        return false;
+      }
+
+      if (!l.empty ())
+        add ();
+
+      for (const string& s: ls)
+        os << s;
+
+      return true;
+    }
+
+    // Search backwards for the beginning of the n-th line from the end,
+    // fetching the log chunk by chunk starting from its end. If found in the
+    // last chunk (the common case), then print it right away and fetch the
+    // tail again otherwise.
+    //
+    // Note that the newline that terminates the log doesn't count.
+    //
+    uint64_t start (0);
+    size_t nl (0);
+
+    for (uint64_t e (r.size); e != 0; )
+    {
+      uint64_t b (e > log_chunk_size ? e - log_chunk_size : 0);
+
+      if (!fetch (r, b, e - b, d))
+        return false;
+
+      bool found (false);
+
+      for (uint64_t i (e); i != b; --i)
+      {
+        if (d[i - 1 - b] == '\n' && i != r.size && ++nl == n)
+        {
+          start = i;
+          found = true;
+          break;
+        }
+      }
+
+      if (found || b == 0)
+      {
+        if (e == r.size)
+        {
+          os.write (d.data () + (start - b), r.size - start);
+          return true;
+        }
+
+        break;
+      }
+
+      e = b;
+    }
+
+    return print_log (r, start, r.size);
+  };
+
+  // Print the response content as the prefix followed by the operation logs
+  // (or their tails), one operation at a time.
+  //
+  if (tail != 0)
+  {
+    os << prefix;
+
+    for (const build_result_log_chunk& r: results)
+    {
+      if (!print_tail (r, tail))
+        break;
+    }
   }
   else
   {
-    const operation_results& r (b->results);
+    uint64_t b (bytes.first);
+    uint64_t e (bytes.second);
 
-    auto i (
-      find_if (r.begin (), r.end (),
-               [&op] (const operation_result& v) {return v.operation == op;}));
+    if (b < prefix.size ())
+      os.write (prefix.data () + b, min<uint64_t> (e, prefix.size ()) - b);
 
-    if (i == r.end ())
-      config_expired ("no operation");
+    uint64_t p (prefix.size ());
+
+    for (const build_result_log_chunk& r: results)
+    {
+      uint64_t lb (p);
+      uint64_t le (p + r.size);
 
-    print_header ();
+      if (lb >= e)
+        break;
 
-    os << op << ": " << i->status << endl << endl
-       << i->log;
+      if (b < le && !print_log (r, max (b, lb) - lb, min (e, le) - lb))
+        break;
+
+      p = le;
+    }
   }
 
   return true;
@@ -21,6 +21,7 @@
 #include <libbrep/build-package-odb.hxx>
 
 #include <mod/build.hxx>          // send_notification_email()
+#include <mod/compression.hxx>
 #include <mod/module-options.hxx>
 #include <mod/tenant-service.hxx>
 
@@ -95,7 +96,8 @@ handle (request& rq, response&)
     // details).
     //
     size_t limit (options_->build_result_request_max_size ());
-    manifest_parser p (rq.content (limit, limit), "result_request_manifest");
+    manifest_parser p (rq.content (limit, limit, request_memory_),
+                       "result_request_manifest");
     rqm = result_request_manifest (p);
   }
   catch (const manifest_parsing& e)
@@ -489,11 +491,34 @@ handle (request& rq, response&)
           b->status = rs;
           b->hard_timestamp = b->soft_timestamp;
 
-          // Mark the section as loaded, so results are updated.
+          // Mark the sections as loaded, so results and logs are updated.
           //
           b->results_section.load ();
           b->results = move (rqm.result.results);
 
+          b->result_logs_section.load ();
+          b->result_logs.clear ();
+
+          // If requested, compress the operation result logs and move them
+          // out of the results.
+          //
+          if (uint16_t level = options_->build_result_log_compression ())
+          {
+            for (operation_result& r: b->results)
+            {
+              if (!r.log.empty ())
+              {
+                build_result_log l {r.operation,
+                                    r.log.size (),
+                                    zstd_compress (r.log, level)};
+
+                b->result_logs.push_back (move (l));
+
+                r.log = string ();
+              }
+            }
+          }
+
           // Save the checksums.
           //
           b->agent_checksum      = move (rqm.agent_checksum);
@@ -144,7 +144,7 @@ init (scanner& s)
       fail << "database 'build' schema differs from the current one (module "
            << BREP_VERSION_ID << ")";
 
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
   }
 
   if (options_->root ().empty ())
@@ -297,7 +297,8 @@ handle (request& rq, response& rs)
     // details).
     //
     size_t limit (options_->build_task_request_max_size ());
-    manifest_parser p (rq.content (limit, limit), "task_request_manifest");
+    manifest_parser p (rq.content (limit, limit, request_memory_),
+                       "task_request_manifest");
     tqm = task_request_manifest (p);
   }
   catch (const manifest_parsing& e)
@@ -345,6 +346,12 @@ handle (request& rq, response& rs)
     //    extension of the web::response interface.
     //
 
+    // Compress the potentially large manifest if the agent supports it.
+    //
+    rs.compress ();
+
+    request_phase rp ("serialization");
+
     manifest_serializer s (rs.content (200, "text/manifest;charset=utf-8"),
                            "task_response_manifest");
     task_response.serialize (s);
@@ -530,7 +537,7 @@ handle (request& rq, response& rs)
   //
   if (!conf_machines.empty ())
   {
-    vector<shared_ptr<build>> rebuilds;
+    pmr::vector<shared_ptr<build>> rebuilds (arena ());
 
     // Create the task response manifest. Must be called inside the build db
     // transaction.
@@ -849,7 +856,7 @@ handle (request& rq, response& rs)
     // positions of packages which we have tried to build. Initially all
     // entries are false.
     //
-    vector<bool> tried_positions;
+    pmr::vector<bool> tried_positions (arena ());
 
     // Number of false entries in the above vector. Used merely as an
     // optimization to bail out.
@@ -1167,7 +1174,7 @@ handle (request& rq, response& rs)
       {
         // Query the existing build ids and stash them into the set.
         //
-        set<build_id> existing_builds;
+        pmr::set<build_id> existing_builds (arena ());
         {
           using query = query<package_build_id>;
 
@@ -1514,6 +1521,8 @@ handle (request& rq, response& rs)
           l2 ([&]{trace << process_args {args, n};});
         };
 
+        request_phase rp ("openssl");
+
         openssl os (print_args,
                     nullfd, path ("-"), 2,
                     process_env (options_->openssl (),
@@ -2649,7 +2658,7 @@ handle (request& rq, response& rs)
             b->soft_timestamp = b->timestamp;
             b->hard_timestamp = b->soft_timestamp;
 
-            // Mark the section as loaded, so results are updated.
+            // Mark the sections as loaded, so results and logs are updated.
             //
             b->results_section.load ();
 
@@ -2659,6 +2668,9 @@ handle (request& rq, response& rs)
                   result_status::abort,
                   "error: not more than 9 auxiliary machines are allowed"}});
 
+            b->result_logs_section.load ();
+            b->result_logs.clear ();
+
             b->agent_checksum      = nullopt;
             b->worker_checksum     = nullopt;
             b->dependency_checksum = nullopt;
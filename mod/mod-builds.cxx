@@ -11,7 +11,6 @@
 #include <odb/transaction.hxx>
 
 #include <libbutl/utility.hxx>      // compare_c_string
-#include <libbutl/timestamp.hxx>    // to_string()
 #include <libbutl/path-pattern.hxx>
 
 #include <libbbot/manifest.hxx> // to_result_status(), to_string(result_status)
@@ -57,7 +56,7 @@ init (scanner& s)
   if (options_->build_config_specified ())
   {
     database_module::init (*options_, options_->build_db_retry ());
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
 
     if (options_->root ().empty ())
       options_->root (dir_path ("/"));
@@ -328,26 +327,6 @@ handle (request& rq, response& rs)
 
   const char* title ("Builds");
 
-  xml::serializer s (rs.content (), title);
-
-  s << HTML
-    <<   HEAD
-    <<     TITLE << title << ~TITLE
-    <<     CSS_LINKS (path ("builds.css"), root)
-    //
-    // This hack is required to avoid the "flash of unstyled content", which
-    // happens due to the presence of the autofocus attribute in the input
-    // element of the filter form. The problem appears in Firefox and has a
-    // (4-year old, at the time of this writing) bug report:
-    //
-    // https://bugzilla.mozilla.org/show_bug.cgi?id=712130.
-    //
-    <<     SCRIPT << " " << ~SCRIPT
-    <<   ~HEAD
-    <<   BODY
-    <<     DIV_HEADER (options_->logo (), options_->menu (), root, tenant)
-    <<     DIV(ID="content");
-
   // If the tenant is empty then we are in the global view and will display
   // builds from all the public tenants.
   //
@@ -386,98 +365,6 @@ handle (request& rq, response& rs)
     return r;
   };
 
-  auto print_form = [&s, &params, this] (const toolchains& toolchains,
-                                         optional<size_t> build_count)
-  {
-    // Print the package builds filter form on the first page only.
-    //
-    if (params.page () == 0)
-    {
-      // Populate the toolchains list with the distinct list of toolchain
-      // name/version pairs from all the existing package builds. Make sure
-      // the selected toolchain is still present in the database. Otherwise
-      // fallback to the * wildcard selection.
-      //
-      string cth ("*");
-      vector<pair<string, string>> toolchain_opts ({{"*", "*"}});
-      {
-        for (const auto& t: toolchains)
-        {
-          string th (t.first + '-' + t.second.string ());
-          toolchain_opts.emplace_back (th, th);
-
-          if (th == params.toolchain ())
-            cth = move (th);
-        }
-      }
-
-      // The 'action' attribute is optional in HTML5. While the standard
-      // doesn't specify browser behavior explicitly for the case the
-      // attribute is omitted, the only reasonable behavior is to default it
-      // to the current document URL.
-      //
-      s << FORM
-        <<   TABLE(ID="filter", CLASS="proplist")
-        <<     TBODY
-        <<       TR_INPUT  ("name", "builds", params.name (), "*", true)
-        <<       TR_INPUT  ("version", "pv", params.version (), "*")
-        <<       TR_SELECT ("toolchain", "th", cth, toolchain_opts)
-        <<       TR_INPUT  ("target", "tg", params.target (), "*")
-
-        <<       TR(CLASS="tgt-config")
-        <<         TH << "tgt config" << ~TH
-        <<         TD
-        <<           *INPUT(TYPE="text",
-                            NAME="tc",
-                            VALUE=params.target_config (),
-                            PLACEHOLDER="*",
-                            LIST="target-configs")
-        <<          DATALIST(ID="target-configs")
-        <<            *OPTION(VALUE="*");
-
-      // Print unique config names from the target config map.
-      //
-      set<const char*, butl::compare_c_string> conf_names;
-      for (const auto& c: *target_conf_map_)
-      {
-        if (conf_names.insert (c.first.config.get ().c_str ()).second)
-          s << *OPTION(VALUE=c.first.config.get ());
-      }
-
-      s <<          ~DATALIST
-        <<         ~TD
-        <<       ~TR
-
-        <<       TR(CLASS="pkg-config")
-        <<         TH << "pkg config" << ~TH
-        <<         TD
-        <<           *INPUT(TYPE="text",
-                            NAME="pc",
-                            VALUE=params.package_config (),
-                            PLACEHOLDER="*")
-        <<         ~TD
-        <<       ~TR
-        <<       TR_SELECT ("result", "rs", params.result (), build_results)
-        <<     ~TBODY
-        <<   ~TABLE
-        <<   TABLE(CLASS="form-table")
-        <<     TBODY
-        <<       TR
-        <<         TD(ID="build-count")
-        <<           DIV_COUNTER (build_count, "Build", "Builds")
-        <<         ~TD
-        <<         TD(ID="filter-btn")
-        <<           *INPUT(TYPE="submit", VALUE="Filter")
-        <<         ~TD
-        <<       ~TR
-        <<     ~TBODY
-        <<   ~TABLE
-        << ~FORM;
-    }
-    else
-      s << DIV_COUNTER (build_count, "Build", "Builds");
-  };
-
   const string& tgt     (params.target ());
   const string& tgt_cfg (params.target_config ());
   const string& pkg_cfg (params.package_config ());
@@ -501,7 +388,16 @@ handle (request& rq, response& rs)
   optional<size_t> count;
   size_t page (params.page ());
 
-  if (params.result () != "unbuilt") // Print package build configurations.
+  // Note that for the package build configurations all the database work is
+  // performed upfront and the page is then streamed to the client (see
+  // below).
+  //
+  bool built (params.result () != "unbuilt");
+
+  toolchains build_toolchains;
+  pmr::vector<package_build> builds (arena ());
+
+  if (built) // Query package build configurations.
   {
     // It seems impossible to filter out the package-excluded configuration
     // builds via the database query. Thus, we will traverse through builds
@@ -513,7 +409,6 @@ handle (request& rq, response& rs)
     // printing the builds.
     //
     count = 0;
-    vector<package_build> builds;
     builds.reserve (page_configs);
 
     // Prepare the package build query.
@@ -633,12 +528,142 @@ handle (request& rq, response& rs)
       }
     }
 
-    // Print the filter form after the build count is calculated. Note:
-    // query_toolchains() must be called inside the build db transaction.
+    // Query the toolchains for the filter form after the build count is
+    // calculated. Note: query_toolchains() must be called inside the build db
+    // transaction.
     //
-    print_form (query_toolchains (), count);
+    build_toolchains = query_toolchains ();
 
     t.commit ();
+  }
+
+  rs.compress ();
+
+  // Stream the package build configurations page, since all the fallible
+  // work is already done. Note that we buffer the unbuilt package
+  // configurations page as it is printed while the database is queried.
+  //
+  xml::serializer s (
+    rs.content (200, "application/xhtml+xml;charset=utf-8", !built),
+    title);
+
+  s << HTML
+    <<   HEAD
+    <<     TITLE << title << ~TITLE
+    <<     CSS_LINKS (path ("builds.css"), root)
+    //
+    // This hack is required to avoid the "flash of unstyled content", which
+    // happens due to the presence of the autofocus attribute in the input
+    // element of the filter form. The problem appears in Firefox and has a
+    // (4-year old, at the time of this writing) bug report:
+    //
+    // https://bugzilla.mozilla.org/show_bug.cgi?id=712130.
+    //
+    <<     SCRIPT << " " << ~SCRIPT
+    <<   ~HEAD
+    <<   BODY
+    <<     DIV_HEADER (options_->logo (), options_->menu (), root, tenant)
+    <<     DIV(ID="content");
+
+  auto print_form = [&s, &params, this] (const toolchains& toolchains,
+                                         optional<size_t> build_count)
+  {
+    // Print the package builds filter form on the first page only.
+    //
+    if (params.page () == 0)
+    {
+      // Populate the toolchains list with the distinct list of toolchain
+      // name/version pairs from all the existing package builds. Make sure
+      // the selected toolchain is still present in the database. Otherwise
+      // fallback to the * wildcard selection.
+      //
+      string cth ("*");
+      vector<pair<string, string>> toolchain_opts ({{"*", "*"}});
+      {
+        for (const auto& t: toolchains)
+        {
+          string th (t.first + '-' + t.second.string ());
+          toolchain_opts.emplace_back (th, th);
+
+          if (th == params.toolchain ())
+            cth = move (th);
+        }
+      }
+
+      // The 'action' attribute is optional in HTML5. While the standard
+      // doesn't specify browser behavior explicitly for the case the
+      // attribute is omitted, the only reasonable behavior is to default it
+      // to the current document URL.
+      //
+      s << FORM
+        <<   TABLE(ID="filter", CLASS="proplist")
+        <<     TBODY
+        <<       TR_INPUT  ("name", "builds", params.name (), "*", true)
+        <<       TR_INPUT  ("version", "pv", params.version (), "*")
+        <<       TR_SELECT ("toolchain", "th", cth, toolchain_opts)
+        <<       TR_INPUT  ("target", "tg", params.target (), "*")
+
+        <<       TR(CLASS="tgt-config")
+        <<         TH << "tgt config" << ~TH
+        <<         TD
+        <<           *INPUT(TYPE="text",
+                            NAME="tc",
+                            VALUE=params.target_config (),
+                            PLACEHOLDER="*",
+                            LIST="target-configs")
+        <<          DATALIST(ID="target-configs")
+        <<            *OPTION(VALUE="*");
+
+      // Print unique config names from the target config map.
+      //
+      pmr::set<const char*, butl::compare_c_string> conf_names (arena ());
+      for (const auto& c: *target_conf_map_)
+      {
+        if (conf_names.insert (c.first.config.get ().c_str ()).second)
+          s << *OPTION(VALUE=c.first.config.get ());
+      }
+
+      s <<          ~DATALIST
+        <<         ~TD
+        <<       ~TR
+
+        <<       TR(CLASS="pkg-config")
+        <<         TH << "pkg config" << ~TH
+        <<         TD
+        <<           *INPUT(TYPE="text",
+                            NAME="pc",
+                            VALUE=params.package_config (),
+                            PLACEHOLDER="*")
+        <<         ~TD
+        <<       ~TR
+        <<       TR_SELECT ("result", "rs", params.result (), build_results)
+        <<     ~TBODY
+        <<   ~TABLE
+        <<   TABLE(CLASS="form-table")
+        <<     TBODY
+        <<       TR
+        <<         TD(ID="build-count")
+        <<           DIV_COUNTER (build_count, "Build", "Builds")
+        <<         ~TD
+        <<         TD(ID="filter-btn")
+        <<           *INPUT(TYPE="submit", VALUE="Filter")
+        <<         ~TD
+        <<       ~TR
+        <<     ~TBODY
+        <<   ~TABLE
+        << ~FORM;
+    }
+    else
+      s << DIV_COUNTER (build_count, "Build", "Builds");
+  };
+
+  if (built) // Print package build configurations.
+  {
+    request_phase rp ("serialization");
+
+    // Print the filter form.
+    //
+    print_form (build_toolchains, count);
 
     // Finally, print the cached package build configurations.
     //
@@ -651,17 +676,6 @@ handle (request& rq, response& rs)
     {
       const build& b (*pb.build);
 
-      string ts (butl::to_string (b.timestamp,
-                                  "%Y-%m-%d %H:%M:%S %Z",
-                                  true /* special */,
-                                  true /* local */) +
-                 " (" + butl::to_string (now - b.timestamp, false) + " ago");
-
-      if (pb.archived)
-        ts += ", archived";
-
-      ts += ')';
-
       s << TABLE(CLASS="proplist build")
         <<   TBODY
         <<     TR_NAME (b.package_name, root, b.tenant)
@@ -672,7 +686,7 @@ handle (request& rq, response& rs)
         <<     TR_VALUE ("target", b.target.string ())
         <<     TR_VALUE ("tgt config", b.target_config_name)
         <<     TR_VALUE ("pkg config", b.package_config_name)
-        <<     TR_VALUE ("timestamp", ts);
+        <<     TR_BUILD_TIMESTAMP (b, now, pb.archived);
 
       if (b.interactive) // Note: can only be present for the building state.
         s <<   TR_VALUE ("login", *b.interactive);
@@ -737,7 +751,7 @@ handle (request& rq, response& rs)
     //
     conn->execute ("SET LOCAL enable_nestloop=off");
 
-    vector<target_config_toolchain> config_toolchains;
+    pmr::vector<target_config_toolchain> config_toolchains (arena ());
     {
       toolchains = query_toolchains ();
 
@@ -769,7 +783,7 @@ handle (request& rq, response& rs)
         throw invalid_request (400, "invalid toolchain");
       }
 
-      vector<const build_target_config*> target_configs;
+      pmr::vector<const build_target_config*> target_configs (arena ());
 
       for (const auto& c: *target_conf_)
       {
@@ -1002,7 +1016,7 @@ handle (request& rq, response& rs)
         // Copy configuration/toolchain combinations for this package,
         // skipping excluded configurations.
         //
-        set<config_toolchain> unbuilt_configs;
+        pmr::set<config_toolchain> unbuilt_configs (arena ());
 
         // Load the constrains section lazily.
         //
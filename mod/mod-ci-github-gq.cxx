@@ -32,6 +32,18 @@ namespace brep
   static string        gq_bool (bool);
 #endif
 
+  function<void (const string&)> gq_unauthorized_handler;
+
+  // Call the unauthorized handler, if set, if the request authenticated with
+  // the installation access token failed with the 401 status code.
+  //
+  static void
+  gq_check_unauthorized (uint16_t sc, const string& iat)
+  {
+    if (sc == 401 && gq_unauthorized_handler)
+      gq_unauthorized_handler (iat);
+  }
+
   [[noreturn]] static void
   throw_json (json::parser& p, const string& m)
   {
@@ -559,6 +571,8 @@ namespace brep
                                 move (rq),
                                 &rhs));
 
+      gq_check_unauthorized (sc, iat);
+
       if (lim != nullptr)
         *lim = parse_rate_limit_headers (sc, rhs);
 
@@ -607,6 +621,8 @@ namespace brep
                              move (rq),
                              &rhs);
 
+          gq_check_unauthorized (*sc1, iat);
+
           if (lim != nullptr)
             *lim = parse_rate_limit_headers (*sc1, rhs);
 
@@ -643,16 +659,19 @@ namespace brep
             }
           }
         }
-        else
+        else if (crs_n == 1)
         {
-          // Since we only update one check run at a time, let's assume that
-          // 502 means the request received and acted upon by GitHub but we
-          // never received a reply. Empirically, this appears to be the case.
+          // When updating a single check run, let's assume that 502 means
+          // the request received and acted upon by GitHub but we never
+          // received a reply. Empirically, this appears to be the case.
           //
-          assert (crs_n == 1);
-
-          check_run& cr (*crs_b);
-          cr.state_synced = true;
+          // Note that we cannot assume the same for a batch of check runs
+          // (see gq_update_check_runs()) since some of them may not have
+          // been updated. So in this case we fail, leaving them all
+          // unsynchronized for the caller to retry.
+          //
+          for (auto i (crs_b); i != crs_e; ++i)
+            i->state_synced = true;
 
           return string ();
         }
@@ -1420,6 +1439,8 @@ namespace brep
                                 move (rq),
                                 &rhs));
 
+      gq_check_unauthorized (sc, iat);
+
       if (lim != nullptr)
         *lim = parse_rate_limit_headers (sc, rhs);
 
@@ -1591,6 +1612,8 @@ namespace brep
                                 move (rq),
                                 &rhs));
 
+      gq_check_unauthorized (sc, iat);
+
       if (lim != nullptr)
         *lim = parse_rate_limit_headers (sc, rhs);
 
@@ -43,6 +43,15 @@ namespace brep
     timestamp reset = butl::timestamp_unknown;
   };
 
+  // If not empty, called by the GraphQL functions with the installation
+  // access token they were passed if GitHub responded with the 401
+  // (Unauthorized) status code to a request authenticated with it (for
+  // example, because the token has been revoked). Should only be set during
+  // the web server initialization.
+  //
+  extern function<void (const string& installation_access_token)>
+  gq_unauthorized_handler;
+
   // GraphQL functions (all start with gq_).
   //
 
@@ -148,7 +157,9 @@ namespace brep
   //
   // Return false and issue diagnostics if the request failed. In this case
   // the rate limits may or may not be available (check the reset value for
-  // timestamp_unknown).
+  // timestamp_unknown). Note that if GitHub does not reply (502) to the
+  // update of multiple check runs, then the request is considered failed
+  // and the check runs are left unsynchronized.
   //
   // Throw invalid_argument if the passed data is invalid, missing, or
   // inconsistent.
@@ -157,7 +168,8 @@ namespace brep
   // cannot be empty.
   //
   // Note that unlike gq_create_check_runs() this function does not support
-  // batching because it is only ever called on small numbers of check runs.
+  // batching and so the caller should limit the number of check runs (see
+  // build-queued-batch).
   //
   bool
   gq_update_check_runs (const basic_mark& error,
@@ -0,0 +1,16 @@
+// file      : mod/mod-ci-github-post.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/mod-ci-github-post.hxx>
+
+namespace brep
+{
+  string github_api_url ("https://api.github.com/");
+
+  http_client&
+  github_http_client ()
+  {
+    static http_client c;
+    return c;
+  }
+}
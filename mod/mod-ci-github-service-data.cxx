@@ -19,6 +19,54 @@ namespace brep
       m);
   }
 
+  // In the version 2 schema, instead of the check run name, we store the
+  // build queued hints it was produced with from the build id (see
+  // gh_check_run_name() for details), since the name is normally the build id
+  // with some components omitted. The hints are encoded as the following
+  // flags.
+  //
+  static const uint64_t check_run_name_single_package_version (0x1);
+  static const uint64_t check_run_name_single_package_config  (0x2);
+
+  // Return the check run name produced from the build id with the specified
+  // hints or nullopt if the build id doesn't have the expected form:
+  //
+  // <package>/<version>/<target-config>/<target>/<package-config>/<toolchain>
+  //
+  static optional<string>
+  check_run_name (const string& bid, uint64_t hints)
+  {
+    // Positions of the component separators.
+    //
+    size_t ps[5];
+    size_t n (0);
+
+    for (size_t i (0); (i = bid.find ('/', i)) != string::npos; ++i)
+    {
+      if (n == 5)
+        return nullopt;
+
+      ps[n++] = i;
+    }
+
+    if (n != 5)
+      return nullopt;
+
+    string r;
+
+    if ((hints & check_run_name_single_package_version) == 0)
+      r.append (bid, 0, ps[1] + 1);
+
+    r.append (bid, ps[1] + 1, ps[3] - ps[1]);
+
+    if ((hints & check_run_name_single_package_config) == 0)
+      r.append (bid, ps[3] + 1, ps[4] - ps[3]);
+
+    r.append (bid, ps[4] + 1, string::npos);
+
+    return r;
+  }
+
   service_data::
   service_data (const string& json)
   {
@@ -29,7 +77,7 @@ namespace brep
     // Throw if the schema version is not supported.
     //
     version = p.next_expect_member_number<uint64_t> ("version");
-    if (version != 1)
+    if (version != 1 && version != 2)
     {
       throw invalid_argument ("unsupported service_data schema version: " +
                               to_string (version));
@@ -83,31 +131,79 @@ namespace brep
     if (string* s = p.next_expect_member_string_null ("check_suite_node_id"))
       check_suite_node_id = *s;
 
+    // Note that in the version 1 schema each check run is represented as an
+    // object and in the version 2 schema -- as an array of the member values
+    // in the fixed order, with the name being represented as null if it is
+    // the same as the build id or as the hints if it is produced from the
+    // build id (see json() for details).
+    //
     p.next_expect_member_array ("check_runs");
-    while (p.next_expect (event::begin_object, event::end_array))
+    while (version == 1
+           ? p.next_expect (event::begin_object, event::end_array)
+           : p.next_expect (event::begin_array, event::end_array))
     {
-      string bid (p.next_expect_member_string ("build_id"));
-      string nm (p.next_expect_member_string ("name"));
+      string bid;
+      string nm;
+
+      if (version == 1)
+      {
+        bid = p.next_expect_member_string ("build_id");
+        nm = p.next_expect_member_string ("name");
+      }
+      else
+      {
+        bid = p.next_expect_string ();
+
+        optional<event> e (p.peek ());
+
+        if (e && *e == event::number)
+        {
+          uint64_t hs (p.next_expect_number<uint64_t> ());
+
+          optional<string> n (
+            hs <= (check_run_name_single_package_version |
+                   check_run_name_single_package_config)
+            ? check_run_name (bid, hs)
+            : nullopt);
+
+          if (!n)
+            throw_json (p, "invalid check run name hints " + to_string (hs));
+
+          nm = move (*n);
+        }
+        else if (string* v = p.next_expect_string_null ())
+          nm = *v;
+        else
+          nm = bid;
+      }
 
       optional<string> nid;
-      if (string* v = p.next_expect_member_string_null ("node_id"))
+      if (string* v = (version == 1
+                       ? p.next_expect_member_string_null ("node_id")
+                       : p.next_expect_string_null ()))
         nid = *v;
 
       build_state s;
       try
       {
-        s = to_build_state (p.next_expect_member_string ("state"));
+        s = to_build_state (version == 1
+                            ? p.next_expect_member_string ("state")
+                            : p.next_expect_string ());
       }
       catch (const invalid_argument& e)
       {
         throw_json (p, e.what ());
       }
 
-      bool ss (p.next_expect_member_boolean<bool> ("state_synced"));
+      bool ss (version == 1
+               ? p.next_expect_member_boolean<bool> ("state_synced")
+               : p.next_expect_boolean<bool> ());
 
       optional<result_status> rs;
       {
-        if (string* v = p.next_expect_member_string_null ("status"))
+        if (string* v = (version == 1
+                         ? p.next_expect_member_string_null ("status")
+                         : p.next_expect_string_null ()))
         {
           try
           {
@@ -131,7 +227,7 @@ namespace brep
                    nullopt, /* details_url */
                    nullopt /* description */});
 
-      p.next_expect (event::end_object);
+      p.next_expect (version == 1 ? event::end_object : event::end_array);
     }
 
     completed = p.next_expect_member_boolean<bool> ("completed");
@@ -140,6 +236,10 @@ namespace brep
       conclusion_node_id = *s;
 
     p.next_expect (event::end_object);
+
+    // Upgrade to the current schema version on serialization.
+    //
+    version = 2;
   }
 
   // check_suite constructor.
@@ -214,7 +314,9 @@ namespace brep
 
     s.begin_object ();
 
-    s.member ("version", 1);
+    assert (version == 1 || version == 2);
+
+    s.member ("version", version);
 
     s.member_name ("kind");
     switch (kind)
@@ -293,20 +395,61 @@ namespace brep
     s.member_begin_array ("check_runs");
     for (const check_run& cr: check_runs)
     {
-      s.begin_object ();
-      s.member ("build_id", cr.build_id);
-      s.member ("name", cr.name);
+      if (version == 1)
+      {
+        s.begin_object ();
+        s.member ("build_id", cr.build_id);
+        s.member ("name", cr.name);
+        s.member_name ("node_id");
+      }
+      else
+      {
+        // Omit the name if it is the same as the build id and store the
+        // hints instead of the name if it is produced from the build id,
+        // which is normally the case. Try the hints starting from the most
+        // common case of a single package version with the default
+        // configuration.
+        //
+        s.begin_array ();
+        s.value (cr.build_id);
+
+        if (cr.name != cr.build_id)
+        {
+          uint64_t hs (check_run_name_single_package_version |
+                       check_run_name_single_package_config);
+
+          for (; hs != 0; --hs)
+          {
+            if (check_run_name (cr.build_id, hs) == cr.name)
+              break;
+          }
+
+          if (hs != 0)
+            s.value (hs);
+          else
+            s.value (cr.name);
+        }
+        else
+          s.value (nullptr);
+      }
 
-      s.member_name ("node_id");
       if (cr.node_id)
         s.value (*cr.node_id);
       else
         s.value (nullptr);
 
-      s.member ("state", to_string (cr.state));
-      s.member ("state_synced", cr.state_synced);
+      if (version == 1)
+      {
+        s.member ("state", to_string (cr.state));
+        s.member ("state_synced", cr.state_synced);
+        s.member_name ("status");
+      }
+      else
+      {
+        s.value (to_string (cr.state));
+        s.value (cr.state_synced);
+      }
 
-      s.member_name ("status");
       if (cr.status)
       {
         assert (cr.state == build_state::built);
@@ -315,7 +458,10 @@ namespace brep
       else
         s.value (nullptr);
 
-      s.end_object ();
+      if (version == 1)
+        s.end_object ();
+      else
+        s.end_array ();
     }
     s.end_array ();
 
@@ -15,6 +15,13 @@ namespace brep
   //
   // It is always a top-level JSON object and the first member is always the
   // schema version.
+  //
+  // In the version 2 schema the check runs are stored in the compact form
+  // (arrays of values rather than objects, with the names represented by
+  // the build queued hints they are produced from the build ids with; see
+  // json() for details) since their number can be in the hundreds and the
+  // service data is parsed and serialized on every build state change
+  // notification. The version 1 schema is still supported for reading.
 
   // Unsynchronized state means we were unable to (conclusively) notify
   // GitHub about the last state transition (e.g., due to a transient
@@ -91,7 +98,11 @@ namespace brep
   {
     // The data schema version. Note: must be first member in the object.
     //
-    uint64_t version = 1;
+    // Note that the data is always serialized in the schema version
+    // specified by this member and the data read in the older version is
+    // upgraded to the current one.
+    //
+    uint64_t version = 2;
 
     // Kind and phase.
     //
@@ -3,23 +3,38 @@
 
 #include <mod/mod-ci-github.hxx>
 
+#include <odb/database.hxx>
+#include <odb/transaction.hxx>
+
 #include <libbutl/json/parser.hxx>
 
+#include <libbrep/build.hxx>
+#include <libbrep/build-odb.hxx>
+#include <libbrep/build-package.hxx>
+#include <libbrep/build-package-odb.hxx>
+
 #include <web/xhtml/serialization.hxx>
 #include <web/server/mime-url-encoding.hxx> // mime_url_encode()
 
 #include <mod/jwt.hxx>
 #include <mod/hmac.hxx>
-#include <mod/build.hxx> // build_log_url()
+#include <mod/build.hxx>   // build_log_url()
+#include <mod/utility.hxx> // sleep_before_retry()
 #include <mod/module-options.hxx>
 
 #include <mod/mod-ci-github-gq.hxx>
 #include <mod/mod-ci-github-post.hxx>
 #include <mod/mod-ci-github-service-data.hxx>
 
+#include <map>
+#include <mutex>
+#include <tuple>     // forward_as_tuple()
 #include <cerrno>
+#include <thread>
+#include <sstream>
 #include <cstdlib>   // strtoull()
 #include <stdexcept>
+#include <condition_variable>
 
 // Resources:
 //
@@ -42,9 +57,91 @@ using namespace std;
 using namespace butl;
 using namespace web;
 using namespace brep::cli;
+using namespace odb::core;
 
 namespace brep
 {
+  // Outbound queue.
+  //
+  struct ci_github::outbound_queue
+  {
+    thread sender;
+
+    mutex m;
+    condition_variable c;
+    bool stop = false;
+
+    // Time to check the queue at since a job is enqueued by this process.
+    //
+    optional<chrono::steady_clock::time_point> wakeup;
+
+    // Time point not before which the next mutative request can be sent. We
+    // pace the requests following the GitHub recommendation:
+    //
+    // "To avoid exceeding a rate limit, you should pause at least 1 second
+    // between mutative requests and avoid concurrent requests."
+    //
+    chrono::steady_clock::time_point next_request;
+
+    ~outbound_queue ()
+    {
+      if (sender.joinable ())
+      {
+        {
+          lock_guard<mutex> l (m);
+          stop = true;
+        }
+
+        c.notify_all ();
+        sender.join ();
+      }
+    }
+
+    bool
+    stopped ()
+    {
+      lock_guard<mutex> l (m);
+      return stop;
+    }
+
+    // Wait until the specified time point. Return false if stopped.
+    //
+    bool
+    wait_until (chrono::steady_clock::time_point t)
+    {
+      unique_lock<mutex> l (m);
+      return !c.wait_until (l, t, [this] {return stop;});
+    }
+  };
+
+  // Time for which a job is claimed by the sender. Should be sufficient to
+  // create a batch of check runs.
+  //
+  static const chrono::minutes outbound_lease (5);
+
+  // Return true if the check run is yet to be created on GitHub by the
+  // outbound queue sender.
+  //
+  static inline bool
+  outbound_pending (const check_run& cr)
+  {
+    return !cr.node_id                      &&
+           !cr.state_synced                 &&
+           cr.state == build_state::queued;
+  }
+
+  // Return true if the check run is yet to be updated to the building state
+  // on GitHub by the outbound queue sender (see the
+  // ci-github-outbound-update-delay option for details).
+  //
+  static inline bool
+  outbound_update_pending (const check_run& cr)
+  {
+    return cr.node_id                         &&
+           !cr.state_synced                   &&
+           cr.state == build_state::building;
+  }
+
   ci_github::
   ci_github (tenant_service_map& tsm)
       : tenant_service_map_ (tsm)
@@ -56,7 +153,12 @@ namespace brep
       : database_module (r),
         ci_start (r),
         options_ (r.initialized_ ? r.options_ : nullptr),
-        tenant_service_map_ (tsm)
+        tenant_service_map_ (tsm),
+        private_keys_ (r.initialized_ ? r.private_keys_ : nullptr),
+        rebuild_delay_gauge_ (
+          r.initialized_ ? r.rebuild_delay_gauge_ : nullptr),
+        unloaded_delay_gauge_ (
+          r.initialized_ ? r.unloaded_delay_gauge_ : nullptr)
   {
   }
 
@@ -93,6 +195,30 @@ namespace brep
           fail << "ci-github-app-id-private-key path must be absolute";
       }
 
+      // Load the private keys, unless the openssl program is used.
+      //
+      if (!options_->ci_github_openssl_program ())
+      {
+        auto pks (make_shared<map<uint64_t, jwt_private_key>> ());
+
+        for (const auto& pr: options_->ci_github_app_id_private_key ())
+        {
+          try
+          {
+            pks->emplace (piecewise_construct,
+                          forward_as_tuple (pr.first),
+                          forward_as_tuple (pr.second));
+          }
+          catch (const system_error& e)
+          {
+            fail << "unable to load private key for app id " << pr.first
+                 << ": " << e;
+          }
+        }
+
+        private_keys_ = move (pks);
+      }
+
       // Read the webhook secret from the configured path.
       //
       {
@@ -118,6 +244,15 @@ namespace brep
         }
       }
 
+      {
+        const string& u (options_->ci_github_api_url ());
+
+        if (u.empty () || u.back () != '/')
+          fail << "ci-github-api-url must end with a slash";
+
+        github_api_url = u;
+      }
+
       if (!options_->ci_github_app_id_name_specified ())
         fail << "no app id/app name mappings configured";
 
@@ -132,7 +267,42 @@ namespace brep
 
       ci_start::init (make_shared<options::ci_start> (*options_));
 
+      // Note that the handler metrics are registered under the handler type
+      // name (see handler::init() for details).
+      //
+      {
+        handler_metrics& m (handler_metrics::instance ("ci_github"));
+
+        rebuild_delay_gauge_ = &m.add_gauge (
+          "ci_github_rebuild_delay_seconds",
+          "Delay chosen for the latest check suite rebuild.");
+
+        unloaded_delay_gauge_ = &m.add_gauge (
+          "ci_github_unloaded_delay_seconds",
+          "Delay chosen for the latest unloaded tenant notification.");
+      }
+
       database_module::init (*options_, options_->build_db_retry ());
+
+      // Invalidate the installation access tokens GitHub doesn't accept
+      // anymore, so that the new ones are obtained.
+      //
+      gq_unauthorized_handler = [this] (const string& t)
+      {
+        basic_mark error (severity::error, log_writer_, __PRETTY_FUNCTION__);
+        invalidate_installation_access_token (t, error);
+      };
+
+      // Start the outbound queue sender thread, if enabled.
+      //
+      if (options_->ci_github_outbound_queue ())
+      {
+        if (options_->ci_github_outbound_poll_interval () == 0)
+          fail << "ci-github-outbound-poll-interval must not be 0";
+
+        outbound_queue_ = make_shared<outbound_queue> ();
+        outbound_queue_->sender = thread ([this] {send_outbound_jobs ();});
+      }
     }
   }
 
@@ -177,8 +347,9 @@ namespace brep
 
     // Process headers.
     //
-    string event; // Webhook event.
-    string hmac;  // Received HMAC.
+    string event;    // Webhook event.
+    string hmac;     // Received HMAC.
+    string delivery; // Delivery GUID.
     try
     {
       bool content_type (false);
@@ -209,8 +380,11 @@ namespace brep
         //
         else if (icasecmp (h.name, "x-github-delivery") == 0)
         {
-          // @@ TODO Check that delivery UUID has not been received before
-          //         (replay attack).
+          // Note that the delivery GUID is the same for all the redeliveries
+          // of the event.
+          //
+          if (h.value)
+            delivery = *h.value;
         }
         else if (icasecmp (h.name, "content-type") == 0)
         {
@@ -252,56 +426,6 @@ namespace brep
       throw;
     }
 
-    // Read the entire request body into a buffer because we need to compute
-    // an HMAC over it and then parse it as JSON. The alternative of reading
-    // from the stream twice works out to be more complicated (see also a TODO
-    // item in web/server/module.hxx).
-    //
-    string body;
-    {
-      // Note that even though we may not need caching right now, we may later
-      // (e.g., to support cancel) so let's just enable it right away.
-      //
-      size_t limit (128 * 1024);
-
-      istream& is (rq.content (limit, limit));
-
-      try
-      {
-        getline (is, body, '\0');
-      }
-      catch (const io_error& e)
-      {
-        fail << "unable to read request body: " << e;
-      }
-    }
-
-    // Verify the received HMAC.
-    //
-    // Compute the HMAC value over the request body using the configured
-    // webhook secret as key and compare it to the received HMAC.
-    //
-    try
-    {
-      string h (compute_hmac (*options_,
-                              body.data (),
-                              body.size (),
-                              webhook_secret_.c_str ()));
-
-      if (icasecmp (h, hmac) != 0)
-      {
-        string m ("computed HMAC does not match received HMAC");
-
-        error << m;
-
-        throw invalid_request (400, move (m));
-      }
-    }
-    catch (const system_error& e)
-    {
-      fail << "unable to compute request HMAC: " << e;
-    }
-
     // Process the `app-id` and `warning` webhook request query parameters.
     //
     uint64_t app_id;
@@ -355,166 +479,433 @@ namespace brep
       if (!wa) badreq ("missing 'warning' webhook query parameter");
     }
 
-    // There is a webhook event (specified in the x-github-event header) and
-    // each event contains a bunch of actions (specified in the JSON request
-    // body).
+    // Read the request body, verify the received HMAC, and handle the event.
     //
-    // Note: "GitHub continues to add new event types and new actions to
-    // existing event types." As a result we ignore known actions that we are
-    // not interested in and log and ignore unknown actions. The thinking here
-    // is that we want to be "notified" of new actions at which point we can
-    // decide whether to ignore them or to handle.
+    // In the in-process mode the request body is streamed through the
+    // incremental HMAC computation directly into the JSON parser (see
+    // handle_event() for details). This way the body is neither buffered nor
+    // read twice and the parser skips the payload members we are not
+    // interested in without materializing them. The event is only acted upon
+    // after the HMAC is verified, which happens as soon as the payload is
+    // parsed (see the authenticate callback below).
     //
-    if (event == "check_suite")
-    {
-      gh_check_suite_event cs;
-      try
-      {
-        json::parser p (body.data (), body.size (), "check_suite event");
+    // If the openssl program is used, then read the entire request body into
+    // a buffer because we need to pass it to the program.
+    //
+    // Note that the request content is not cached and so the request handling
+    // cannot be retried due to a recoverable database error once the body is
+    // read (see database_module::handle() for details). Instead, the
+    // database operations performed after that are retried with the already
+    // parsed event (see retry_recoverable() for details).
+    //
+    size_t limit (128 * 1024);
 
-        cs = gh_check_suite_event (p);
-      }
-      catch (const json::invalid_json_input& e)
+    istream& is (rq.content (limit));
+
+    // Verify the received HMAC.
+    //
+    // Compare the HMAC value computed over the request body using the
+    // configured webhook secret as key to the received HMAC.
+    //
+    auto verify_hmac = [&hmac, &error] (const string& h)
+    {
+      if (icasecmp (h, hmac) != 0)
       {
-        string m ("malformed JSON in " + e.name + " request body");
+        string m ("computed HMAC does not match received HMAC");
 
-        error << m << ", line: " << e.line << ", column: " << e.column
-              << ", byte offset: " << e.position << ", error: " << e;
+        error << m;
 
         throw invalid_request (400, move (m));
       }
+    };
 
-      if (cs.check_suite.app_id != app_id)
-      {
-        fail << "webhook check_suite app.id " << cs.check_suite.app_id
-             << " does not match app-id query parameter " << app_id;
-      }
+    optional<hmac_istreambuf> hbuf;
+    unique_ptr<istream> body;
 
-      if (cs.action == "requested")
-      {
-        // Branch pushes are handled in handle_branch_push() so ignore this
-        // event.
-        //
-        return true;
-      }
-      else if (cs.action == "rerequested")
+    if (!options_->ci_github_openssl_program ())
+    {
+      try
       {
-        // Someone manually requested to re-run all the check runs in this
-        // check suite. Treat as a new request.
-        //
-        return handle_check_suite_rerequest (move (cs), warning_success);
+        hbuf.emplace (is, webhook_secret_);
       }
-      else if (cs.action == "completed")
+      catch (const system_error& e)
       {
-        // GitHub thinks that "all the check runs in this check suite have
-        // completed and a conclusion is available". Check with our own
-        // bookkeeping and log an error if there is a mismatch.
-        //
-        return handle_check_suite_completed (move (cs), warning_success);
+        fail << "unable to compute request HMAC: " << e;
       }
-      else
-      {
-        // Ignore unknown actions by sending a 200 response with empty body
-        // but also log as an error since we want to notice new actions.
-        //
-        error << "unknown action '" << cs.action << "' in check_suite event";
 
-        return true;
-      }
+      body.reset (new istream (&*hbuf));
+      body->exceptions (istream::badbit);
     }
-    else if (event == "check_run")
+    else
     {
-      gh_check_run_event cr;
+      string b;
+
       try
       {
-        json::parser p (body.data (), body.size (), "check_run event");
+        getline (is, b, '\0');
+      }
+      catch (const io_error& e)
+      {
+        fail << "unable to read request body: " << e;
+      }
 
-        cr = gh_check_run_event (p);
+      try
+      {
+        verify_hmac (compute_hmac (*options_,
+                                   b.data (),
+                                   b.size (),
+                                   webhook_secret_.c_str ()));
       }
-      catch (const json::invalid_json_input& e)
+      catch (const system_error& e)
       {
-        string m ("malformed JSON in " + e.name + " request body");
+        fail << "unable to compute request HMAC: " << e;
+      }
 
-        error << m << ", line: " << e.line << ", column: " << e.column
-              << ", byte offset: " << e.position << ", error: " << e;
+      body.reset (new istringstream (b));
+      body->exceptions (istream::badbit);
+    }
 
-        throw invalid_request (400, move (m));
-      }
+    // Ignore the event if it has already been delivered (redelivered by
+    // GitHub, delivered twice, etc).
+    //
+    // Note that we record the delivery before handling the event, so that
+    // concurrent duplicate deliveries are detected, and forget it if the
+    // handling fails (including retries on recoverable database errors), so
+    // that the event can be redelivered.
+    //
+    // Also note that the (authenticated) delivery is recorded only after
+    // the HMAC is verified, so that it cannot be used to make us ignore
+    // legitimate events.
+    //
+    bool authenticated (false);
+    bool recorded (false);
 
-      if (cr.check_run.app_id != app_id)
+    auto authenticate = [this,
+                         &hbuf, &verify_hmac,
+                         &authenticated, &recorded,
+                         &delivery, &event,
+                         &fail, &trace, &error] () -> bool
+    {
+      if (hbuf)
       {
-        fail << "webhook check_run app.id " << cr.check_run.app_id
-             << " does not match app-id query parameter " << app_id;
+        try
+        {
+          verify_hmac (hbuf->finish ());
+        }
+        catch (const io_error& e)
+        {
+          fail << "unable to read request body: " << e;
+        }
+        catch (const system_error& e)
+        {
+          fail << "unable to compute request HMAC: " << e;
+        }
       }
 
-      if (cr.action == "rerequested")
+      authenticated = true;
+
+      if (!delivery.empty ())
       {
-        // Someone manually requested to re-run a specific check run.
-        //
-        return handle_check_run_rerequest (move (cr), warning_success);
+        if (!retry_recoverable ([this, &delivery] ()
+                                {
+                                  return record_delivery (delivery);
+                                }))
+        {
+          l2 ([&]{trace << "ignoring duplicate delivery " << delivery
+                        << " of event " << event;});
+
+          return false;
+        }
+
+        recorded = true;
       }
-#if 0
-      // It looks like we shouldn't be receiving these since we are not
-      // subscribed to them.
-      //
-      else if (cr.action == "created"   ||
-               cr.action == "completed" ||
-               cr.action == "requested_action")
+
+      return true;
+    };
+
+    bool r;
+    try
+    {
+      try
       {
+        r = handle_event (event, *body, app_id, warning_success, authenticate);
       }
-#endif
-      else
+      catch (const io_error& e)
       {
-        // Ignore unknown actions by sending a 200 response with empty body
-        // but also log as an error since we want to notice new actions.
+        // Reading the (not yet authenticated) request body while parsing it
+        // has failed.
         //
-        error << "unknown action '" << cr.action << "' in check_run event";
+        if (authenticated)
+          throw;
 
-        return true;
+        fail << "unable to read request body: " << e;
       }
     }
-    else if (event == "pull_request")
+    catch (...)
     {
-      gh_pull_request_event pr;
-      try
-      {
-        json::parser p (body.data (), body.size (), "pull_request event");
+      if (recorded)
+        forget_delivery (delivery, error);
 
-        pr = gh_pull_request_event (p);
-      }
-      catch (const json::invalid_json_input& e)
-      {
-        string m ("malformed JSON in " + e.name + " request body");
+      throw;
+    }
 
-        error << m << ", line: " << e.line << ", column: " << e.column
-              << ", byte offset: " << e.position << ", error: " << e;
+    return r;
+  }
 
-        throw invalid_request (400, move (m));
-      }
+  bool ci_github::
+  record_delivery (const string& id)
+  {
+    try
+    {
+      transaction t (build_db_->begin ());
 
-      // Store the app-id webhook query parameter in the gh_pull_request_event
-      // object (see gh_pull_request for an explanation).
-      //
-      // When we receive the other webhooks we do check that the app ids in
-      // the payload and query match but here we have to assume it is valid.
-      //
-      pr.pull_request.app_id = app_id;
+      bool r (build_db_->find<service_delivery> (
+                service_delivery_id ("ci-github", id)) == nullptr);
 
-      if (pr.action == "opened" ||
-          pr.action == "synchronize")
+      if (r)
       {
-        // opened
-        //   A pull request was opened.
-        //
-        // synchronize
-        //   A pull request's head branch was updated from the base branch or
-        //   new commits were pushed to the head branch. (Note that there is
-        //   no equivalent event for the base branch.)
-        //
-        // Note that both cases are handled similarly: we start a new CI
-        // request which will be reported on the new commit id.
+        service_delivery d ("ci-github", id);
+        build_db_->persist (d);
+      }
+
+      t.commit ();
+      return r;
+    }
+    catch (const odb::object_already_persistent&)
+    {
+      return false; // Recorded concurrently.
+    }
+  }
+
+  void ci_github::
+  forget_delivery (const string& id, const basic_mark& error) noexcept
+  {
+    try
+    {
+      transaction t (build_db_->begin ());
+
+      build_db_->erase_query<service_delivery> (
+        query<service_delivery>::id.service_type == "ci-github" &&
+        query<service_delivery>::id.delivery_id == id);
+
+      t.commit ();
+    }
+    catch (const std::exception& e)
+    {
+      // The event redelivery will be ignored, which is not fatal.
+      //
+      error << "unable to forget delivery " << id << ": " << e;
+    }
+  }
+
+  bool ci_github::
+  retry_recoverable (const function<bool ()>& f)
+  {
+    HANDLER_DIAG;
+
+    for (size_t retry (0);;)
+    {
+      try
+      {
+        return f ();
+      }
+      catch (const odb::recoverable& e)
+      {
+        // Note that re-throwing the exception would end up with the request
+        // handling retry, which would fail to rewind the request content.
+        //
+        if (retry == retry_max_)
+          fail << e << "; no retries left";
+
+        l1 ([&]{trace << e << "; " << retry_max_ - retry << " retries left";});
+
+        sleep_before_retry (retry++);
+      }
+    }
+  }
+
+  // Parse the webhook event payload of the specified type from the request
+  // body stream and authenticate the request (see handle_event() for
+  // details). Return false if the event should be ignored.
+  //
+  template <typename E>
+  static bool
+  parse_event (istream& body,
+               const char* what,
+               E& r,
+               const function<bool ()>& authenticate,
+               const basic_mark& error)
+  {
+    try
+    {
+      json::parser p (body, what);
+
+      r = E (p);
+    }
+    catch (const json::invalid_json_input& e)
+    {
+      // Don't respond to unauthenticated requests with the parsing errors.
+      //
+      if (!authenticate ())
+        return false;
+
+      string m ("malformed JSON in " + e.name + " request body");
+
+      error << m << ", line: " << e.line << ", column: " << e.column
+            << ", byte offset: " << e.position << ", error: " << e;
+
+      throw invalid_request (400, move (m));
+    }
+
+    return authenticate ();
+  }
+
+  bool ci_github::
+  handle_event (const string& event,
+                istream& body,
+                uint64_t app_id,
+                bool warning_success,
+                const function<bool ()>& authenticate)
+  {
+    HANDLER_DIAG;
+
+    // There is a webhook event (specified in the x-github-event header) and
+    // each event contains a bunch of actions (specified in the JSON request
+    // body).
+    //
+    // Note: "GitHub continues to add new event types and new actions to
+    // existing event types." As a result we ignore known actions that we are
+    // not interested in and log and ignore unknown actions. The thinking here
+    // is that we want to be "notified" of new actions at which point we can
+    // decide whether to ignore them or to handle.
+    //
+    if (event == "check_suite")
+    {
+      gh_check_suite_event cs;
+      if (!parse_event (body, "check_suite event", cs, authenticate, error))
+        return true;
+
+      if (cs.check_suite.app_id != app_id)
+      {
+        fail << "webhook check_suite app.id " << cs.check_suite.app_id
+             << " does not match app-id query parameter " << app_id;
+      }
+
+      if (cs.action == "requested")
+      {
+        // Branch pushes are handled in handle_branch_push() so ignore this
+        // event.
+        //
+        return true;
+      }
+      else if (cs.action == "rerequested")
+      {
+        // Someone manually requested to re-run all the check runs in this
+        // check suite. Treat as a new request.
+        //
+        return retry_recoverable (
+          [this, &cs, warning_success] ()
+          {
+            return handle_check_suite_rerequest (cs, warning_success);
+          });
+      }
+      else if (cs.action == "completed")
+      {
+        // GitHub thinks that "all the check runs in this check suite have
+        // completed and a conclusion is available". Check with our own
+        // bookkeeping and log an error if there is a mismatch.
+        //
+        return retry_recoverable (
+          [this, &cs, warning_success] ()
+          {
+            return handle_check_suite_completed (cs, warning_success);
+          });
+      }
+      else
+      {
+        // Ignore unknown actions by sending a 200 response with empty body
+        // but also log as an error since we want to notice new actions.
+        //
+        error << "unknown action '" << cs.action << "' in check_suite event";
+
+        return true;
+      }
+    }
+    else if (event == "check_run")
+    {
+      gh_check_run_event cr;
+      if (!parse_event (body, "check_run event", cr, authenticate, error))
+        return true;
+
+      if (cr.check_run.app_id != app_id)
+      {
+        fail << "webhook check_run app.id " << cr.check_run.app_id
+             << " does not match app-id query parameter " << app_id;
+      }
+
+      if (cr.action == "rerequested")
+      {
+        // Someone manually requested to re-run a specific check run.
+        //
+        return retry_recoverable (
+          [this, &cr, warning_success] ()
+          {
+            return handle_check_run_rerequest (cr, warning_success);
+          });
+      }
+#if 0
+      // It looks like we shouldn't be receiving these since we are not
+      // subscribed to them.
+      //
+      else if (cr.action == "created"   ||
+               cr.action == "completed" ||
+               cr.action == "requested_action")
+      {
+      }
+#endif
+      else
+      {
+        // Ignore unknown actions by sending a 200 response with empty body
+        // but also log as an error since we want to notice new actions.
+        //
+        error << "unknown action '" << cr.action << "' in check_run event";
+
+        return true;
+      }
+    }
+    else if (event == "pull_request")
+    {
+      gh_pull_request_event pr;
+      if (!parse_event (body, "pull_request event", pr, authenticate, error))
+        return true;
+
+      // Store the app-id webhook query parameter in the gh_pull_request_event
+      // object (see gh_pull_request for an explanation).
+      //
+      // When we receive the other webhooks we do check that the app ids in
+      // the payload and query match but here we have to assume it is valid.
+      //
+      pr.pull_request.app_id = app_id;
+
+      if (pr.action == "opened" ||
+          pr.action == "synchronize")
+      {
+        // opened
+        //   A pull request was opened.
+        //
+        // synchronize
+        //   A pull request's head branch was updated from the base branch or
+        //   new commits were pushed to the head branch. (Note that there is
+        //   no equivalent event for the base branch.)
         //
-        return handle_pull_request (move (pr), warning_success);
+        // Note that both cases are handled similarly: we start a new CI
+        // request which will be reported on the new commit id.
+        //
+        return retry_recoverable (
+          [this, &pr, warning_success] ()
+          {
+            return handle_pull_request (pr, warning_success);
+          });
       }
       else if (pr.action == "edited")
       {
@@ -588,21 +979,8 @@ namespace brep
       // branch deletion. As well as tag creation/deletion.
       //
       gh_push_event ps;
-      try
-      {
-        json::parser p (body.data (), body.size (), "push event");
-
-        ps = gh_push_event (p);
-      }
-      catch (const json::invalid_json_input& e)
-      {
-        string m ("malformed JSON in " + e.name + " request body");
-
-        error << m << ", line: " << e.line << ", column: " << e.column
-              << ", byte offset: " << e.position << ", error: " << e;
-
-        throw invalid_request (400, move (m));
-      }
+      if (!parse_event (body, "push event", ps, authenticate, error))
+        return true;
 
       // We are only interested in branches so ignore everything else.
       //
@@ -619,7 +997,11 @@ namespace brep
 
       // Note that the push request event has no action.
       //
-      return handle_branch_push (move (ps), warning_success);
+      return retry_recoverable (
+        [this, &ps, warning_success] ()
+        {
+          return handle_branch_push (ps, warning_success);
+        });
     }
     // Ignore marketplace_purchase events (sent by the GitHub Marketplace) by
     // sending a 200 response with empty body. We offer a free plan only and
@@ -627,6 +1009,7 @@ namespace brep
     //
     else if (event == "marketplace_purchase")
     {
+      authenticate ();
       return true;
     }
     // Ignore GitHub App installation events by sending a 200 response with
@@ -635,6 +1018,7 @@ namespace brep
     //
     else if (event == "installation" || event == "installation_repositories")
     {
+      authenticate ();
       return true;
     }
     // Ignore ping events by sending a 200 response with empty body. This
@@ -644,10 +1028,14 @@ namespace brep
     //
     else if (event == "ping")
     {
+      authenticate ();
       return true;
     }
     else
     {
+      if (!authenticate ())
+        return true;
+
       // Log to investigate.
       //
       error << "unexpected event '" << event << "'";
@@ -762,14 +1150,11 @@ namespace brep
     // let's obtain it to flush out any permission issues early. Also, it is
     // valid for an hour so we will most likely make use of it.
     //
-    optional<string> jwt (generate_jwt (ps.app_id, trace, error));
-    if (!jwt)
-      throw server_error ();
-
     optional<gh_installation_access_token> iat (
-        obtain_installation_access_token (ps.installation.id,
-                                          move (*jwt),
-                                          error));
+      installation_access_token (ps.app_id,
+                                 ps.installation.id,
+                                 trace,
+                                 error));
     if (!iat)
       throw server_error ();
 
@@ -860,14 +1245,11 @@ namespace brep
     // let's obtain it to flush out any permission issues early. Also, it is
     // valid for an hour so we will most likely make use of it.
     //
-    optional<string> jwt (generate_jwt (pr.pull_request.app_id, trace, error));
-    if (!jwt)
-      throw server_error ();
-
     optional<gh_installation_access_token> iat (
-      obtain_installation_access_token (pr.installation.id,
-                                        move (*jwt),
-                                        error));
+      installation_access_token (pr.pull_request.app_id,
+                                 pr.installation.id,
+                                 trace,
+                                 error));
     if (!iat)
       throw server_error ();
 
@@ -1000,14 +1382,11 @@ namespace brep
     // let's obtain it to flush out any permission issues early. Also, it is
     // valid for an hour so we will most likely make use of it.
     //
-    optional<string> jwt (generate_jwt (cs.check_suite.app_id, trace, error));
-    if (!jwt)
-      throw server_error ();
-
     optional<gh_installation_access_token> iat (
-        obtain_installation_access_token (cs.installation.id,
-                                          move (*jwt),
-                                          error));
+      installation_access_token (cs.check_suite.app_id,
+                                 cs.installation.id,
+                                 trace,
+                                 error));
     if (!iat)
       throw server_error ();
 
@@ -1102,8 +1481,24 @@ namespace brep
     // Impose a delay to avoid GitHub state update races (see build_cancel()
     // for background). @@ Should also help prevent abuse, though the delay
     // should probably be longer (and depend on when was the last time it was
-    // re-requested, similar to what the build_force module does). @@ TODO:
-    // also update diagnostics handle_forced_check_suite_rebuild().
+    // re-requested, similar to what the build_force module does).
+    //
+    // Increase the delay if the installation is short of the rate limit
+    // budget, so that we don't fail the GitHub API requests when the tenant
+    // is loaded (see deferral_delay() for details). Note that
+    // handle_forced_check_suite_rebuild() reports the delay calculated the
+    // same way.
+    //
+    chrono::seconds delay (
+      deferral_delay (sd.installation_id,
+                      chrono::seconds (60),
+                      error));
+
+    if (rebuild_delay_gauge_ != nullptr)
+      rebuild_delay_gauge_->set (delay.count ());
+
+    l2 ([&]{trace << "check suite " << cs.check_suite.node_id
+                  << " rebuild delay: " << delay.count () << " seconds";});
     //
     // Note that we use the create() API instead of start() since duplicate
     // management is not available in start().
@@ -1118,7 +1513,7 @@ namespace brep
                      *build_db_, retry_max_,
                      tenant_service (sid, "ci-github", sd.json ()),
                      chrono::seconds (15) /* interval */,
-                     chrono::seconds (60) /* delay */,
+                     delay,
                      duplicate_tenant_mode::replace));
 
     if (!pr)
@@ -1353,14 +1748,11 @@ namespace brep
     auto get_iat = [this, &trace, &error, &cr] ()
       -> optional<gh_installation_access_token>
     {
-      optional<string> jwt (generate_jwt (cr.check_run.app_id, trace, error));
-      if (!jwt)
-        return nullopt;
-
       optional<gh_installation_access_token> iat (
-        obtain_installation_access_token (cr.installation.id,
-                                          move (*jwt),
-                                          error));
+        installation_access_token (cr.check_run.app_id,
+                                   cr.installation.id,
+                                   trace,
+                                   error));
 
       if (iat)
         l3 ([&]{trace << "installation_access_token { " << *iat << " }";});
@@ -1498,7 +1890,7 @@ namespace brep
 
       // Get a new IAT if the one from the service data has expired.
       //
-      if (system_clock::now () > sd.installation_access.expires_at)
+      if (installation_access_expired (sd.installation_access))
       {
         if ((new_iat = get_iat ()))
           iat = &*new_iat;
@@ -1945,15 +2337,12 @@ namespace brep
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (installation_access_expired (sd.installation_access))
     {
-      optional<string> jwt (generate_jwt (sd.app_id, trace, error));
-      if (!jwt)
-        throw server_error ();
-
-      new_iat = obtain_installation_access_token (sd.installation_id,
-                                                  move (*jwt),
-                                                  error);
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
       if (!new_iat)
         throw server_error ();
 
@@ -1970,7 +2359,7 @@ namespace brep
     // request is the most sensible option (the tenant is presumably being
     // created/loaded).
     //
-    const char* r (nullptr);
+    string r;
     if (sd.check_suite_node_id)
     {
       const string& nid (*sd.check_suite_node_id);
@@ -1981,7 +2370,17 @@ namespace brep
                                     nid))
       {
         l3 ([&]{trace << "re-requested check suite " << nid;});
-        r = "Rebuilding in 60 seconds."; // @@ TODO: dynamic delay.
+
+        // Note that the actual delay is calculated when the check suite
+        // re-request webhook is received (see
+        // handle_check_suite_rerequest() for details), so this is only an
+        // estimate.
+        //
+        chrono::seconds d (deferral_delay (sd.installation_id,
+                                           chrono::seconds (60),
+                                           error));
+
+        r = "Rebuilding in " + to_string (d.count ()) + " seconds.";
       }
       else
         fail << "failed to re-request check suite " << nid;
@@ -2030,6 +2429,28 @@ namespace brep
       return nullptr;
     }
 
+    // Postpone the notification if the installation is short of the rate
+    // limit budget rather than fail the GitHub API requests (see
+    // deferral_delay() for details).
+    //
+    {
+      chrono::seconds d (deferral_delay (sd.installation_id,
+                                         chrono::seconds (0),
+                                         error));
+
+      if (unloaded_delay_gauge_ != nullptr)
+        unloaded_delay_gauge_->set (d.count ());
+
+      if (d != chrono::seconds (0) && postpone_unloaded (ti, d, error))
+      {
+        l2 ([&]{trace << "tenant_service id " << ts.id << ": postponed "
+                      << "unloaded tenant " << ti << " for " << d.count ()
+                      << " seconds";});
+
+        return nullptr;
+      }
+    }
+
     return sd.pre_check
       ? build_unloaded_pre_check (move (ts), move (sd), log_writer)
       : build_unloaded_load (ti, move (ts), move (sd), log_writer);
@@ -2288,16 +2709,14 @@ namespace brep
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (installation_access_expired (sd.installation_access))
     {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
+      if (new_iat)
+        iat = &*new_iat;
     }
     else
       iat = &sd.installation_access;
@@ -2404,9 +2823,23 @@ namespace brep
         l3 ([&]{trace << "created check_run { " << *cr << " }";});
 
         conclusion_node_id = move (*cr->node_id);
+      }
+
+      save_rate_limits (sd.installation_id, limits, error);
+
+      // Calculate the budget from the shared ledger, so that the points
+      // allocated to the other CI jobs of this installation but not yet used
+      // are taken into account. Fall back to the limits returned by
+      // create_ccr() if the ledger is unavailable.
+      //
+      if (!conclusion_node_id.empty () && limits.reset != timestamp_unknown)
+      {
+        optional<gq_rate_limits> l (
+          find_rate_limits (sd.installation_id,
+                            true /* exclude_allocated */,
+                            error));
 
-        if (limits.reset != timestamp_unknown)
-          rb = report_budget (limits, error);
+        rb = report_budget (l ? *l : limits, error);
       }
 
       // Log the limits returned by create_ccr() and budget, if present.
@@ -2781,39 +3214,344 @@ namespace brep
     return remaining / jobs;
   }
 
-  // Build state change notifications (see tenant-services.hxx for
-  // background). Mapping our state transitions to GitHub pose multiple
-  // problems:
-  //
-  // 1. In our model we have the building->queued (interrupted) and
-  //    built->queued (rebuild) transitions. We are going to ignore both of
-  //    them when notifying GitHub. The first is not important (we expect the
-  //    state to go back to building shortly). The second should normally not
-  //    happen and would mean that a completed check suite may go back on its
-  //    conclusion (which would be pretty confusing for the user). Note that
-  //    the ->queued state transition of a check run rebuild triggered by
-  //    us is handled directly in handle_check_run_rerequest().
-  //
-  //    So, for GitHub notifications, we only have the following linear
-  //    transition sequence:
-  //
-  //    -> queued -> building -> built
-  //
-  //    Note, however, that because we ignore certain transitions, we can now
-  //    observe "degenerate" state changes that we need to ignore:
+  // Return the remaining points of the rate limit budget reduced by the
+  // points which are allocated but not yet used, assuming that the used
+  // points have been spent on the allocated ones.
   //
-  //    building -> [queued] -> building
-  //    built -> [queued] -> ...
-  //
-  // 2. As mentioned in tenant-services.hxx, we may observe the notifications
-  //    as arriving in the wrong order. Unfortunately, GitHub provides no
-  //    mechanisms to help with that. In fact, GitHub does not even prevent
-  //    the creation of multiple check runs with the same name (it will always
-  //    use the last created instance, regardless of the status, timestamps,
-  //    etc). As a result, we cannot, for example, rely on the failure to
-  //    create a new check run in response to the queued notification as an
-  //    indication of a subsequent notification (e.g., building) having
-  //    already occurred.
+  static uint64_t
+  unallocated_points (const service_rate_limit& r)
+  {
+    uint64_t used (r.limit > r.remaining ? r.limit - r.remaining : 0);
+
+    if (r.allocated <= used)
+      return r.remaining;
+
+    uint64_t a (r.allocated - used);
+    return r.remaining > a ? r.remaining - a : 0;
+  }
+
+  void ci_github::
+  save_rate_limits (const string& iid,
+                    const gq_rate_limits& l,
+                    const basic_mark& error) const noexcept
+  {
+    if (l.reset == timestamp_unknown)
+      return;
+
+    assert (!transaction::has_current ());
+
+    try
+    {
+      transaction t (build_db_->begin ());
+
+      shared_ptr<service_rate_limit> r (
+        build_db_->find<service_rate_limit> (
+          service_rate_limit_id ("ci-github", iid)));
+
+      if (r == nullptr)
+      {
+        service_rate_limit o ("ci-github", iid, l.limit, l.remaining, l.reset);
+        build_db_->persist (o);
+      }
+      else if (l.reset > r->reset_timestamp)
+      {
+        // New rate limit window. Note that the points allocated in the
+        // previous window are not carried over, which is fine since the
+        // budget is recalculated for each window anyway.
+        //
+        r->limit = l.limit;
+        r->remaining = l.remaining;
+        r->reset_timestamp = l.reset;
+        r->allocated = 0;
+        build_db_->update (r);
+      }
+      else if (l.reset == r->reset_timestamp && l.remaining < r->remaining)
+      {
+        // Note that the responses can be received by the different processes
+        // out of order and so we only keep the least remaining points.
+        //
+        r->limit = l.limit;
+        r->remaining = l.remaining;
+        build_db_->update (r);
+      }
+
+      t.commit ();
+    }
+    catch (const odb::recoverable&)
+    {
+      // Saved concurrently by some other web server process, which is fine
+      // since we will get another chance on the next request.
+    }
+    catch (const odb::object_already_persistent&)
+    {
+      // As above.
+    }
+    catch (const odb::exception& e)
+    {
+      error << "unable to save rate limits for installation " << iid << ": "
+            << e;
+    }
+  }
+
+  optional<gq_rate_limits> ci_github::
+  find_rate_limits (const string& iid,
+                    bool exclude_allocated,
+                    const basic_mark& error) const noexcept
+  {
+    assert (!transaction::has_current ());
+
+    try
+    {
+      transaction t (build_db_->begin ());
+
+      shared_ptr<service_rate_limit> r (
+        build_db_->find<service_rate_limit> (
+          service_rate_limit_id ("ci-github", iid)));
+
+      t.commit ();
+
+      if (r == nullptr)
+        return nullopt;
+
+      gq_rate_limits l;
+      l.limit = r->limit;
+      l.remaining = exclude_allocated ? unallocated_points (*r) : r->remaining;
+      l.used = r->limit > r->remaining ? r->limit - r->remaining : 0;
+      l.reset = r->reset_timestamp;
+
+      return l;
+    }
+    catch (const odb::exception& e)
+    {
+      error << "unable to load rate limits for installation " << iid << ": "
+            << e;
+
+      return nullopt;
+    }
+  }
+
+  bool ci_github::
+  allocate_rate_limits (const string& iid,
+                        uint64_t n,
+                        bool force,
+                        const basic_mark& error) const noexcept
+  {
+    assert (!transaction::has_current ());
+
+    // Note that in case of a concurrent allocation the transaction is retried
+    // so that the allocations don't get lost.
+    //
+    for (size_t retry (0);; ++retry)
+    {
+      try
+      {
+        transaction t (build_db_->begin ());
+
+        shared_ptr<service_rate_limit> r (
+          build_db_->find<service_rate_limit> (
+            service_rate_limit_id ("ci-github", iid)));
+
+        // Allocate if the budget is unknown or the rate limit window has
+        // been reset since (see report_budget() for details).
+        //
+        if (r == nullptr || r->reset_timestamp <= system_clock::now ())
+          return true;
+
+        if (!force)
+        {
+          uint64_t remaining (unallocated_points (*r));
+
+          // Leave the reserve intact (see report_budget() for details).
+          //
+          uint64_t reserve (r->limit / 10);
+
+          if (remaining <= reserve || remaining - reserve < n)
+            return false;
+        }
+
+        r->allocated += n;
+        build_db_->update (r);
+
+        t.commit ();
+
+        return true;
+      }
+      catch (const odb::recoverable& e)
+      {
+        if (retry == retry_max_)
+        {
+          error << "unable to allocate rate limit points for installation "
+                << iid << ": " << e;
+
+          return true;
+        }
+      }
+      catch (const odb::exception& e)
+      {
+        error << "unable to allocate rate limit points for installation "
+              << iid << ": " << e;
+
+        return true;
+      }
+    }
+  }
+
+  chrono::seconds ci_github::
+  deferral_delay (const string& iid,
+                  chrono::seconds base,
+                  const basic_mark& error) const
+  {
+    using chrono::seconds;
+
+    optional<gq_rate_limits> limits (
+      find_rate_limits (iid, true /* exclude_allocated */, error));
+
+    if (!limits)
+      return base;
+
+    timestamp now (system_clock::now ());
+
+    // Assume the total budget is available again if the rate limit window
+    // has been reset since (see report_budget() for details).
+    //
+    if (limits->reset <= now)
+      return base;
+
+    seconds left (chrono::duration_cast<seconds> (limits->reset - now));
+
+    // Bail out if the window looks too big (see report_budget() for
+    // details).
+    //
+    if (left > seconds (3600))
+      return base;
+
+    // Note that we don't touch the same 10% of the total budget that is
+    // reserved by report_budget() for the excessive CI jobs.
+    //
+    uint64_t reserve (limits->limit / 10);
+
+    // Only count the queued work now that we know we may need to defer it.
+    //
+    size_t depth (unloaded_tenant_count (iid, error));
+
+    if (limits->remaining <= reserve || limits->remaining - reserve <= depth)
+      return max (base, left);
+
+    // Assume that each unit of work costs at least one point and spread the
+    // queued work over the time left until the reset time point.
+    //
+    seconds d (left.count () * depth / (limits->remaining - reserve));
+
+    return max (base, d);
+  }
+
+  size_t ci_github::
+  unloaded_tenant_count (const string& iid,
+                         const basic_mark& error) const noexcept
+  {
+    try
+    {
+      using query = query<build_tenant_count>;
+
+      // The installation id is only stored in the service data (see
+      // service_data::json() for details), so match its JSON member. Note
+      // that the installation id is numeric and thus needs no escaping.
+      //
+      string re ("\"installation_id\": *\"" + iid + '"');
+
+      transaction t (build_db_->begin ());
+
+      size_t r (
+        build_db_->query_value<build_tenant_count> (
+          query::build_tenant::service.type == "ci-github"       &&
+          query::build_tenant::unloaded_timestamp.is_not_null () &&
+          !query::build_tenant::archived                         &&
+          (query::build_tenant::service.data + "~" + query::_val (re))));
+
+      t.commit ();
+
+      return r;
+    }
+    catch (const std::exception& e)
+    {
+      error << "unable to count unloaded tenants for installation " << iid
+            << ": " << e;
+      return 0;
+    }
+  }
+
+  bool ci_github::
+  postpone_unloaded (const string& tid,
+                     chrono::seconds d,
+                     const basic_mark& error) const noexcept
+  {
+    try
+    {
+      transaction t (build_db_->begin ());
+
+      shared_ptr<build_tenant> bt (build_db_->find<build_tenant> (tid));
+
+      // Note that the tenant may have been loaded or canceled in the
+      // meantime, in which case there is nothing to postpone.
+      //
+      if (bt == nullptr || !bt->unloaded_timestamp)
+        return false;
+
+      // The next notification is due in the notification interval after the
+      // unloaded timestamp (see ci_start::create() for details).
+      //
+      timestamp ts (system_clock::now () + d);
+
+      if (bt->unloaded_notify_interval)
+        ts -= *bt->unloaded_notify_interval;
+
+      bt->unloaded_timestamp = ts;
+      build_db_->update (bt);
+
+      t.commit ();
+
+      return true;
+    }
+    catch (const std::exception& e)
+    {
+      error << "unable to postpone unloaded tenant " << tid << ": " << e;
+      return false;
+    }
+  }
+
+  // Build state change notifications (see tenant-services.hxx for
+  // background). Mapping our state transitions to GitHub pose multiple
+  // problems:
+  //
+  // 1. In our model we have the building->queued (interrupted) and
+  //    built->queued (rebuild) transitions. We are going to ignore both of
+  //    them when notifying GitHub. The first is not important (we expect the
+  //    state to go back to building shortly). The second should normally not
+  //    happen and would mean that a completed check suite may go back on its
+  //    conclusion (which would be pretty confusing for the user). Note that
+  //    the ->queued state transition of a check run rebuild triggered by
+  //    us is handled directly in handle_check_run_rerequest().
+  //
+  //    So, for GitHub notifications, we only have the following linear
+  //    transition sequence:
+  //
+  //    -> queued -> building -> built
+  //
+  //    Note, however, that because we ignore certain transitions, we can now
+  //    observe "degenerate" state changes that we need to ignore:
+  //
+  //    building -> [queued] -> building
+  //    built -> [queued] -> ...
+  //
+  // 2. As mentioned in tenant-services.hxx, we may observe the notifications
+  //    as arriving in the wrong order. Unfortunately, GitHub provides no
+  //    mechanisms to help with that. In fact, GitHub does not even prevent
+  //    the creation of multiple check runs with the same name (it will always
+  //    use the last created instance, regardless of the status, timestamps,
+  //    etc). As a result, we cannot, for example, rely on the failure to
+  //    create a new check run in response to the queued notification as an
+  //    indication of a subsequent notification (e.g., building) having
+  //    already occurred.
   //
   //    The only aid in this area that GitHub provides is that it prevents
   //    updating a check run in the built state to a former state (queued or
@@ -2961,25 +3699,6 @@ namespace brep
     if (bs.empty ()) // Nothing to do.
       return nullptr;
 
-    // Get a new installation access token if the current one has expired.
-    //
-    const gh_installation_access_token* iat (nullptr);
-    optional<gh_installation_access_token> new_iat;
-
-    if (system_clock::now () > sd.installation_access.expires_at)
-    {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
-    }
-    else
-      iat = &sd.installation_access;
-
     // Determine the reporting mode: detailed or aggregate.
     //
     // In the aggregate reporting mode we don't actually update the check runs
@@ -3034,6 +3753,56 @@ namespace brep
       }
     }
 
+    // Allocate the points for the detailed reporting from the shared budget
+    // (see save_rate_limits() for details). If they are not available
+    // anymore (for example, allocated to the other CI jobs since this job's
+    // budget was calculated), then switch to the aggregate reporting mode
+    // before we hit the rate limit, unless we are already in the detailed
+    // mode.
+    //
+    if (rm == report_mode::detailed)
+    {
+      bool force (sd.report_mode == report_mode::detailed);
+
+      if (!allocate_rate_limits (sd.installation_id,
+                                 crs.size () * 2,
+                                 force,
+                                 error))
+      {
+        info << "installation id " << sd.installation_id << " is short of "
+             << "budget, switching to aggregate reporting mode, builds: "
+             << crs.size ();
+
+        rm = report_mode::aggregate;
+      }
+    }
+
+    // In the detailed reporting mode, if the outbound queue is enabled, then
+    // save the check runs as unsynchronized and enqueue the job to create
+    // them on GitHub (see the returned function below).
+    //
+    bool enqueue (rm == report_mode::detailed && outbound_queue_ != nullptr);
+
+    // Get a new installation access token if the current one has expired.
+    //
+    const gh_installation_access_token* iat (nullptr);
+    optional<gh_installation_access_token> new_iat;
+
+    if (!enqueue)
+    {
+      if (installation_access_expired (sd.installation_access))
+      {
+        new_iat = installation_access_token (sd.app_id,
+                                             sd.installation_id,
+                                             trace,
+                                             error);
+        if (new_iat)
+          iat = &*new_iat;
+      }
+      else
+        iat = &sd.installation_access;
+    }
+
     // Note: we treat the failure to obtain the installation access token the
     // same as the failure to notify GitHub (state is updated by not marked
     // synced).
@@ -3070,6 +3839,8 @@ namespace brep
           info << "installation id " << sd.installation_id << " limits: "
                << limits;
 
+          save_rate_limits (sd.installation_id, limits, error);
+
           break;
         }
       case report_mode::aggregate:
@@ -3134,11 +3905,13 @@ namespace brep
       }
     }
 
-    return [tenant_id,
+    return [this,
+            tenant_id,
             bs = move (bs),
             iat = move (new_iat),
             crs = move (crs),
             rm,
+            enqueue,
             error = move (error),
             warn = move (warn)] (const string& ti,
                                  const tenant_service& ts) -> optional<string>
@@ -3163,6 +3936,7 @@ namespace brep
       if (iat)
         sd.installation_access = *iat;
 
+      bool added (false);
       for (size_t i (0); i != bs.size (); ++i)
       {
         const check_run& cr (crs[i]);
@@ -3182,9 +3956,19 @@ namespace brep
                << scr->state_string ();
         }
         else
+        {
           sd.check_runs.push_back (cr);
+          added = true;
+        }
       }
 
+      // Note that the job is enqueued in the same transaction as the service
+      // data is updated, so that the sender never observes one without the
+      // other.
+      //
+      if (enqueue && added)
+        enqueue_outbound_job (ti, ts);
+
       sd.report_mode = rm;
 
       return sd.json ();
@@ -3274,7 +4058,8 @@ namespace brep
             }
             else
             {
-              // Network error during queued notification (state
+              // Network error during queued notification or the check run
+              // creation is still pending in the outbound queue (state
               // unsynchronized), ignore.
               //
               l3 ([&]{trace << "unsynchronized check run " << bid;});
@@ -3322,21 +4107,34 @@ namespace brep
     //
     assert (sd.report_mode != report_mode::undetermined);
 
+    // If enabled, in the detailed reporting mode leave the check run updates
+    // to the outbound queue sender which collects them for some time and
+    // sends them in a single request, together with the conclusion check run
+    // update (see send_outbound_job() for details). In this case we just
+    // save the check run as unsynchronized and enqueue the outbound job.
+    //
+    bool defer (sd.report_mode == report_mode::detailed &&
+                outbound_queue_ != nullptr              &&
+                options_->ci_github_outbound_update_delay () != 0);
+
     // Get a new installation access token if the current one has expired.
     //
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (defer)
     {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
+      assert (bcr.state == build_state::building); // Set above.
+      bcr.state_synced = false;
+    }
+    else if (installation_access_expired (sd.installation_access))
+    {
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
+      if (new_iat)
+        iat = &*new_iat;
     }
     else
       iat = &sd.installation_access;
@@ -3410,9 +4208,11 @@ namespace brep
       }
     }
 
-    return [tenant_id,
+    return [this,
+            tenant_id,
             iat = move (new_iat),
             cr = move (bcr),
+            defer,
             error = move (error),
             warn = move (warn)] (const string& ti,
                                  const tenant_service& ts) -> optional<string>
@@ -3442,7 +4242,15 @@ namespace brep
       if (check_run* scr = sd.find_check_run (cr.build_id))
       {
         if (scr->state == build_state::queued)
+        {
           *scr = cr;
+
+          if (defer)
+            enqueue_outbound_job (
+              ti,
+              ts,
+              chrono::seconds (options_->ci_github_outbound_update_delay ()));
+        }
         else
         {
           warn << "check run " << cr.build_id << ": out of order building "
@@ -3600,16 +4408,14 @@ namespace brep
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (installation_access_expired (sd.installation_access))
     {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
+      if (new_iat)
+        iat = &*new_iat;
     }
     else
       iat = &sd.installation_access;
@@ -3984,16 +4790,14 @@ namespace brep
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (installation_access_expired (sd.installation_access))
     {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
+      if (new_iat)
+        iat = &*new_iat;
     }
     else
       iat = &sd.installation_access;
@@ -4063,6 +4867,8 @@ namespace brep
 
       info << "installation id " << sd.installation_id << " limits: "
            << limits;
+
+      save_rate_limits (sd.installation_id, limits, error);
     }
   }
   catch (const std::exception& e)
@@ -4127,16 +4933,14 @@ namespace brep
     const gh_installation_access_token* iat (nullptr);
     optional<gh_installation_access_token> new_iat;
 
-    if (system_clock::now () > sd.installation_access.expires_at)
+    if (installation_access_expired (sd.installation_access))
     {
-      if (optional<string> jwt = generate_jwt (sd.app_id, trace, error))
-      {
-        new_iat = obtain_installation_access_token (sd.installation_id,
-                                                    move (*jwt),
-                                                    error);
-        if (new_iat)
-          iat = &*new_iat;
-      }
+      new_iat = installation_access_token (sd.app_id,
+                                           sd.installation_id,
+                                           trace,
+                                           error);
+      if (new_iat)
+        iat = &*new_iat;
     }
     else
       iat = &sd.installation_access;
@@ -4200,19 +5004,55 @@ namespace brep
       "?builds";
   }
 
-  string ci_github::
-  force_rebuild_md_link (const service_data& sd) const
+  optional<string> ci_github::
+  details_url (const string& t, const string& bid) const
   {
-    return
-      "[Force rebuild](" +
-      options_->host () +
-      options_->root ().string () +
-      "?ci-github=rerequest" +
-      "&repo-id=" + sd.repository_node_id +
-      "&head-sha=" + sd.report_sha +
-      "&reason=)";
-  }
-
+    // The full build id has the following form (see gh_check_run_name() for
+    // details):
+    //
+    // <package>/<version>/<target-config>/<target>/<package-config>/<toolchain>
+    //
+    // Note that none of the components may contain '/'.
+    //
+    strings cs;
+    for (size_t b (0);; )
+    {
+      size_t e (bid.find ('/', b));
+      cs.push_back (string (bid, b, e != string::npos ? e - b : e));
+
+      if (e == string::npos)
+        break;
+
+      b = e + 1;
+    }
+
+    if (cs.size () != 6)
+      return nullopt;
+
+    return
+      options_->host ()                                   +
+      tenant_dir (options_->root (), t).string ()         +
+      "?builds=" + mime_url_encode (cs[0])                +
+      "&pv=" + mime_url_encode (cs[1])                    +
+      "&tg=" + mime_url_encode (cs[3])                    +
+      "&tc=" + mime_url_encode (cs[2])                    +
+      "&pc=" + mime_url_encode (cs[4])                    +
+      "&th=" + mime_url_encode (cs[5]);
+  }
+
+  string ci_github::
+  force_rebuild_md_link (const service_data& sd) const
+  {
+    return
+      "[Force rebuild](" +
+      options_->host () +
+      options_->root ().string () +
+      "?ci-github=rerequest" +
+      "&repo-id=" + sd.repository_node_id +
+      "&head-sha=" + sd.report_sha +
+      "&reason=)";
+  }
+
   string ci_github::
   aggregate_reporting_md_note (const string& tid,
                                uint64_t app_id,
@@ -4382,11 +5222,17 @@ namespace brep
       // Set token's "issued at" time 60 seconds in the past to combat clock
       // drift (as recommended by GitHub).
       //
-      jwt = brep::generate_jwt (
-          *options_,
-          pk->second, to_string (app_id),
-          chrono::seconds (options_->ci_github_jwt_validity_period ()),
-          chrono::seconds (60));
+      chrono::seconds vp (options_->ci_github_jwt_validity_period ());
+
+      jwt = !options_->ci_github_openssl_program ()
+            ? brep::generate_jwt (private_keys_->at (app_id),
+                                  to_string (app_id),
+                                  vp,
+                                  chrono::seconds (60))
+            : brep::generate_jwt (*options_,
+                                  pk->second, to_string (app_id),
+                                  vp,
+                                  chrono::seconds (60));
 
       l3 ([&]{trace << "JWT: " << jwt;});
     }
@@ -4500,4 +5346,753 @@ namespace brep
 
     return iat;
   }
+
+  // Process-wide installation access token cache.
+  //
+  // Note that the entry mutex is held while a new token is obtained, so that
+  // the concurrent requests for the same installation wait for it rather
+  // than obtaining their own.
+  //
+  struct iat_cache_entry
+  {
+    mutex m;
+    optional<gh_installation_access_token> iat;
+  };
+
+  static mutex iat_cache_mutex;
+  static map<string, shared_ptr<iat_cache_entry>> iat_cache; // Install id.
+
+  // Process-wide set of the invalidated installation access tokens (see
+  // invalidate_installation_access_token() for details) mapped to the time
+  // when they would expire anyway.
+  //
+  static mutex iat_invalid_mutex;
+  static map<string, timestamp> iat_invalid;
+
+  bool ci_github::
+  installation_access_expired (const gh_installation_access_token& iat)
+  {
+    if (system_clock::now () > iat.expires_at)
+      return true;
+
+    lock_guard<mutex> l (iat_invalid_mutex);
+    return iat_invalid.find (iat.token) != iat_invalid.end ();
+  }
+
+  optional<gh_installation_access_token> ci_github::
+  installation_access_token (uint64_t app_id,
+                             const string& iid,
+                             const basic_mark& trace,
+                             const basic_mark& error) const
+  {
+    shared_ptr<iat_cache_entry> e;
+    {
+      lock_guard<mutex> l (iat_cache_mutex);
+
+      shared_ptr<iat_cache_entry>& r (iat_cache[iid]);
+
+      if (r == nullptr)
+        r = make_shared<iat_cache_entry> ();
+
+      e = r;
+    }
+
+    lock_guard<mutex> l (e->m);
+
+    // Note that the cached token expiration time already includes the clock
+    // drift safety window (see obtain_installation_access_token() for
+    // details).
+    //
+    if (e->iat && !installation_access_expired (*e->iat))
+    {
+      l3 ([&]{trace << "cached installation_access_token { " << *e->iat
+                    << " }";});
+
+      return e->iat;
+    }
+
+    // Check if the token is cached in the database by some other web server
+    // process.
+    //
+    // Note that we cannot start a new transaction if there is one already
+    // active in this thread (not the case for the current callers but let's
+    // be defensive).
+    //
+    bool db (build_db_ != nullptr && !transaction::has_current ());
+
+    if (db)
+    {
+      try
+      {
+        transaction t (build_db_->begin ());
+
+        shared_ptr<service_access_token> tk (
+          build_db_->find<service_access_token> (
+            service_access_token_id ("ci-github", iid)));
+
+        t.commit ();
+
+        if (tk != nullptr)
+        {
+          gh_installation_access_token iat (move (tk->token),
+                                            tk->expiration_timestamp);
+
+          if (!installation_access_expired (iat))
+          {
+            e->iat = move (iat);
+
+            l3 ([&]{trace << "shared installation_access_token { "
+                          << *e->iat << " }";});
+
+            return e->iat;
+          }
+        }
+      }
+      catch (const odb::exception& x)
+      {
+        // Not fatal: fall back to obtaining a new token.
+        //
+        error << "unable to load installation access token for installation "
+              << iid << ": " << x;
+      }
+    }
+
+    optional<string> jwt (generate_jwt (app_id, trace, error));
+    if (!jwt)
+      return nullopt;
+
+    optional<gh_installation_access_token> r (
+      obtain_installation_access_token (iid, move (*jwt), error));
+
+    if (!r)
+      return nullopt;
+
+    e->iat = r;
+
+    if (db)
+    {
+      try
+      {
+        transaction t (build_db_->begin ());
+
+        shared_ptr<service_access_token> tk (
+          build_db_->find<service_access_token> (
+            service_access_token_id ("ci-github", iid)));
+
+        if (tk == nullptr)
+        {
+          service_access_token o ("ci-github", iid, r->token, r->expires_at);
+          build_db_->persist (o);
+        }
+        else
+        {
+          tk->token = r->token;
+          tk->expiration_timestamp = r->expires_at;
+          build_db_->update (tk);
+        }
+
+        t.commit ();
+      }
+      catch (const odb::recoverable&)
+      {
+        // Stored concurrently by some other web server process, which is
+        // fine since any valid token will do.
+      }
+      catch (const odb::exception& x)
+      {
+        error << "unable to store installation access token for "
+              << "installation " << iid << ": " << x;
+      }
+    }
+
+    return r;
+  }
+
+  void ci_github::
+  invalidate_installation_access_token (const string& token,
+                                        const basic_mark& error) const
+  {
+    // Note that the installation access tokens expire after one hour.
+    //
+    {
+      timestamp now (system_clock::now ());
+
+      lock_guard<mutex> l (iat_invalid_mutex);
+
+      for (auto i (iat_invalid.begin ()); i != iat_invalid.end (); )
+      {
+        if (i->second < now)
+          i = iat_invalid.erase (i);
+        else
+          ++i;
+      }
+
+      if (!iat_invalid.emplace (token, now + chrono::hours (1)).second)
+        return; // Already invalidated.
+    }
+
+    // Drop the token from the process cache.
+    //
+    vector<shared_ptr<iat_cache_entry>> es;
+    {
+      lock_guard<mutex> l (iat_cache_mutex);
+
+      for (const auto& p: iat_cache)
+        es.push_back (p.second);
+    }
+
+    for (const shared_ptr<iat_cache_entry>& e: es)
+    {
+      lock_guard<mutex> l (e->m);
+
+      if (e->iat && e->iat->token == token)
+        e->iat = nullopt;
+    }
+
+    // Drop the token from the database, so that it is not picked up by the
+    // other web server processes (see installation_access_token() for
+    // details).
+    //
+    if (build_db_ != nullptr && !transaction::has_current ())
+    {
+      try
+      {
+        using query = query<service_access_token>;
+
+        transaction t (build_db_->begin ());
+
+        build_db_->erase_query<service_access_token> (
+          query::id.service_type == "ci-github" && query::token == token);
+
+        t.commit ();
+      }
+      catch (const odb::exception& e)
+      {
+        error << "unable to remove invalid installation access token: " << e;
+      }
+    }
+  }
+
+  void ci_github::
+  enqueue_outbound_job (const string& tenant_id,
+                        const tenant_service& ts,
+                        chrono::seconds delay) const
+  {
+    assert (outbound_queue_ != nullptr);
+
+    database& db (transaction::current ().database ());
+
+    shared_ptr<tenant_service_job> j (
+      db.find<tenant_service_job> (tenant_service_job_id (ts.type, ts.id)));
+
+    // Note that we don't bring forward the job which is already scheduled
+    // (for example, after a failed attempt or until the rate limit window
+    // reset) but only notify the sender that the service state has changed.
+    //
+    if (j == nullptr)
+    {
+      j = make_shared<tenant_service_job> (ts.type, ts.id, tenant_id);
+      j->scheduled_timestamp += delay;
+      db.persist (j);
+    }
+    else
+    {
+      j->tenant = tenant_id;
+      ++j->generation;
+      db.update (j);
+    }
+
+    // Note that the transaction is not yet committed at this point and so
+    // the sender checks the queue a bit later.
+    //
+    {
+      chrono::steady_clock::time_point t (
+        chrono::steady_clock::now () + delay + chrono::seconds (1));
+
+      lock_guard<mutex> l (outbound_queue_->m);
+
+      optional<chrono::steady_clock::time_point>& w (outbound_queue_->wakeup);
+
+      if (!w || t < *w)
+        w = t;
+    }
+
+    outbound_queue_->c.notify_one ();
+  }
+
+  void ci_github::
+  send_outbound_jobs ()
+  {
+    HANDLER_DIAG;
+
+    using chrono::steady_clock;
+
+    outbound_queue& q (*outbound_queue_);
+
+    chrono::seconds pi (options_->ci_github_outbound_poll_interval ());
+
+    steady_clock::time_point poll (steady_clock::now ());
+
+    for (;;)
+    {
+      // Wait until the next queue check is due, bringing it forward if a
+      // job is enqueued by this process (see enqueue_outbound_job() for
+      // details).
+      //
+      {
+        unique_lock<mutex> l (q.m);
+
+        for (;;)
+        {
+          if (q.stop)
+            return;
+
+          steady_clock::time_point now (steady_clock::now ());
+
+          if (q.wakeup)
+          {
+            poll = min (poll, *q.wakeup);
+            q.wakeup = nullopt;
+          }
+
+          if (now >= poll)
+            break;
+
+          q.c.wait_until (l, poll);
+        }
+      }
+
+      try
+      {
+        while (send_outbound_job () && !q.stopped ()) ;
+      }
+      catch (const server_error&)
+      {
+        // Diagnostics has already been issued.
+      }
+      catch (const std::exception& e)
+      {
+        error << "unable to perform outbound job: " << e;
+      }
+
+      poll = steady_clock::now () + pi;
+    }
+  }
+
+  bool ci_github::
+  send_outbound_job ()
+  {
+    HANDLER_DIAG;
+
+    using chrono::steady_clock;
+
+    outbound_queue& q (*outbound_queue_);
+
+    // Claim the earliest due job, collecting the check runs to create or, if
+    // there are none, to update.
+    //
+    // Note that we only perform a single job at a time across all the
+    // senders, following the GitHub recommendation to avoid concurrent
+    // mutative requests (see outbound_queue for details). Due to the
+    // serializable transaction isolation, concurrent claims result in the
+    // recoverable failure of all but one of them.
+    //
+    shared_ptr<tenant_service_job> j;
+    string tenant_id;
+    service_data sd;
+    brep::check_runs crs;
+    bool updating (false); // Updating rather than creating check runs.
+
+    connection_ptr conn (build_db_->connection ());
+
+    try
+    {
+      transaction tr (conn->begin ());
+
+      timestamp now (system_clock::now ());
+
+      using job_query = query<tenant_service_job>;
+      using tenant_query = query<build_tenant>;
+
+      const auto& type (job_query::id.service_type);
+
+      if (!build_db_->query<tenant_service_job> (
+            (type == "ci-github" && job_query::lease_timestamp > now) +
+            "LIMIT 1").empty ())
+        return false;
+
+      j = build_db_->query_one<tenant_service_job> (
+        (type == "ci-github" && job_query::scheduled_timestamp <= now) +
+        "ORDER BY" + job_query::scheduled_timestamp                     +
+        "LIMIT 1");
+
+      if (j == nullptr)
+        return false;
+
+      shared_ptr<build_tenant> t (
+        build_db_->query_one<build_tenant> (
+          tenant_query::service.id == j->service_id &&
+          tenant_query::service.type == j->service_type));
+
+      if (t != nullptr && !t->archived && t->service->data)
+      {
+        try
+        {
+          sd = service_data (*t->service->data);
+
+          if (!sd.completed && sd.report_mode == report_mode::detailed)
+          {
+            tenant_id = t->id;
+
+            for (bool u: {false, true})
+            {
+              for (const check_run& cr: sd.check_runs)
+              {
+                if (u ? outbound_update_pending (cr) : outbound_pending (cr))
+                {
+                  crs.push_back (cr);
+
+                  if (crs.size () == options_->build_queued_batch ())
+                    break;
+                }
+              }
+
+              if (!crs.empty ())
+              {
+                updating = u;
+                break;
+              }
+            }
+          }
+        }
+        catch (const invalid_argument& e)
+        {
+          error << "failed to parse service data for tenant " << t->id
+                << ": " << e;
+        }
+      }
+
+      if (!crs.empty ())
+      {
+        j->lease_timestamp = now + outbound_lease;
+        build_db_->update (j);
+      }
+      else
+        build_db_->erase (j); // Nothing (left) to do.
+
+      tr.commit ();
+    }
+    catch (const odb::recoverable& e)
+    {
+      // Most likely, some other sender has claimed a job concurrently.
+      //
+      l2 ([&]{trace << e << "; unable to claim outbound job";});
+      return false;
+    }
+
+    if (crs.empty ())
+      return true;
+
+    l2 ([&]{trace << "claimed outbound job for tenant " << tenant_id << ", "
+                  << crs.size () << " check runs to "
+                  << (updating ? "update" : "create");});
+
+    // If the installation is known to be out of the rate limit points, then
+    // postpone the job until the rate limit window reset.
+    //
+    optional<timestamp> postpone;
+    {
+      optional<gq_rate_limits> l (
+        find_rate_limits (sd.installation_id,
+                          false /* exclude_allocated */,
+                          error));
+
+      if (l                                 &&
+          l->remaining < crs.size ()        &&
+          l->reset > system_clock::now ())
+        postpone = l->reset;
+    }
+
+    // Get a new installation access token if the current one has expired.
+    //
+    const gh_installation_access_token* iat (nullptr);
+    optional<gh_installation_access_token> new_iat;
+
+    if (!postpone)
+    {
+      if (installation_access_expired (sd.installation_access))
+      {
+        new_iat = installation_access_token (sd.app_id,
+                                             sd.installation_id,
+                                             trace,
+                                             error);
+        if (new_iat)
+          iat = &*new_iat;
+      }
+      else
+        iat = &sd.installation_access;
+    }
+
+    // Create or update the check runs.
+    //
+    bool r (false);
+
+    if (iat != nullptr)
+    {
+      // Note that the lease expires if we are stopped while waiting.
+      //
+      if (!q.wait_until (q.next_request))
+        return false;
+
+      gq_rate_limits limits;
+
+      if (!updating)
+      {
+        for (check_run& cr: crs)
+        {
+          cr.details_url = details_url (tenant_id, cr.build_id);
+          cr.description = check_run::description_type {
+            check_run_queued_title, check_run_queued_summary};
+        }
+
+        // Let unlikely invalid_argument propagate.
+        //
+        r = gq_create_check_runs (error,
+                                  crs,
+                                  iat->token,
+                                  sd.app_id,
+                                  sd.repository_node_id,
+                                  sd.report_sha,
+                                  crs.size () /* batch */,
+                                  &limits);
+      }
+      else
+      {
+        for (check_run& cr: crs)
+          cr.description = check_run::description_type {
+            check_run_building_title, check_run_building_summary};
+
+        // Also update the conclusion check run with the build stats, as
+        // build_building() does. Note that this way the stats updates for
+        // all the collected building notifications are coalesced into one.
+        //
+        if (sd.conclusion_node_id)
+        {
+          build_stats bs (
+            calculate_build_stats (sd.check_runs, sd.warning_success));
+
+          string rp (make_build_stats_report (bs, sd.warning_success));
+
+          check_run ccr;
+          ccr.name = conclusion_check_run_name (sd.app_id);
+          ccr.node_id = sd.conclusion_node_id;
+          ccr.state = build_state::building;
+          ccr.state_synced = false;
+          ccr.description = check_run::description_type {
+            conclusion_building_title,
+            rp + ". " + force_rebuild_md_link (sd) + '.'};
+
+          crs.push_back (move (ccr));
+        }
+
+        // Let unlikely invalid_argument propagate.
+        //
+        r = gq_update_check_runs (error,
+                                  crs,
+                                  iat->token,
+                                  sd.repository_node_id,
+                                  &limits);
+      }
+
+      q.next_request = steady_clock::now () + chrono::seconds (1);
+
+      if (limits.reset != timestamp_unknown)
+      {
+        info << "installation id " << sd.installation_id << " limits: "
+             << limits;
+
+        save_rate_limits (sd.installation_id, limits, error);
+      }
+
+      if (r)
+      {
+        for (const check_run& cr: crs)
+          l3 ([&]{trace << (updating ? "updated" : "created")
+                        << " check_run { " << cr << " }";});
+      }
+    }
+
+    // Save the created or updated check runs in the service data and
+    // reschedule or remove the job.
+    //
+    auto update = [this, &j, &tenant_id, &crs, updating, &new_iat, &postpone,
+                   r, &error, &warn] (const shared_ptr<build_tenant>& t)
+    {
+      // NOTE: this lambda may be called repeatedly (e.g., due to transaction
+      // being aborted) and so should not move out of its captures.
+
+      bool changed (false);
+      bool pending (false);
+
+      if (t != nullptr && t->id == tenant_id && t->service->data)
+      {
+        service_data sd;
+        try
+        {
+          sd = service_data (*t->service->data);
+        }
+        catch (const invalid_argument& e)
+        {
+          error << "failed to parse service data: " << e;
+          return false;
+        }
+
+        if (new_iat)
+        {
+          sd.installation_access = *new_iat;
+          changed = true;
+        }
+
+        for (const check_run& cr: crs)
+        {
+          if (updating)
+          {
+            // Skip the conclusion check run as well as the check runs whose
+            // state has changed while we were updating them (built, etc).
+            //
+            check_run* scr (!cr.build_id.empty ()
+                            ? sd.find_check_run (cr.build_id)
+                            : nullptr);
+
+            if (scr == nullptr                  ||
+                !outbound_update_pending (*scr) ||
+                scr->node_id != cr.node_id)
+              continue;
+
+            if (cr.state == build_state::built)
+            {
+              // Already in the built state on GitHub (see
+              // gq_update_check_run() for details). Since the built
+              // notification is presumably on its way, consider the check
+              // run synchronized not to retry the update.
+              //
+              warn << "check run " << cr.build_id
+                   << ": already in built state on GitHub";
+
+              scr->state_synced = true;
+              changed = true;
+            }
+            else if (cr.state_synced)
+            {
+              scr->state_synced = true;
+              changed = true;
+            }
+
+            continue;
+          }
+
+          if (!cr.node_id)
+            continue; // Not created.
+
+          if (check_run* scr = sd.find_check_run (cr.build_id))
+          {
+            if (scr->node_id)
+            {
+              // The check run has been created by some notification while we
+              // were creating it (see build_built() for details). Keep the
+              // existing check run since it reflects the stored state (which
+              // we have no means to bring ours to, for example, lacking the
+              // built state summary) and will be updated by the subsequent
+              // notifications. Switching to ours would leave it queued on
+              // GitHub and unsynchronized forever.
+              //
+              warn << "check run " << cr.build_id << ": created concurrently, "
+                   << "keeping existing in state " << scr->state_string ();
+
+              continue;
+            }
+
+            scr->state_synced = (scr->state == cr.state);
+            scr->node_id = cr.node_id;
+            changed = true;
+          }
+        }
+
+        if (!sd.completed && sd.report_mode == report_mode::detailed)
+          pending = find_if (sd.check_runs.begin (), sd.check_runs.end (),
+                             [] (const check_run& cr)
+                             {
+                               return outbound_pending (cr) ||
+                                      outbound_update_pending (cr);
+                             }) != sd.check_runs.end ();
+
+        if (changed)
+          t->service->data = sd.json ();
+      }
+
+      // Note: reload the job since it could have been enqueued again while
+      // we were performing it.
+      //
+      shared_ptr<tenant_service_job> cj (
+        build_db_->find<tenant_service_job> (j->id));
+
+      if (cj != nullptr)
+      {
+        timestamp now (system_clock::now ());
+
+        cj->lease_timestamp = timestamp_nonexistent;
+
+        if (postpone)
+        {
+          cj->scheduled_timestamp = *postpone;
+          build_db_->update (cj);
+        }
+        else if (!r && pending)
+        {
+          uint16_t rm (options_->ci_github_outbound_retry_max ());
+
+          if (++cj->attempts > rm)
+          {
+            error << "tenant " << tenant_id << ": no outbound job attempts "
+                  << "left, dropping job";
+
+            build_db_->erase (cj);
+          }
+          else
+          {
+            // Delay the attempts exponentially, starting from 10 seconds
+            // and up to 1 hour.
+            //
+            uint64_t n (min (cj->attempts - 1, 9));
+            chrono::seconds d (min (uint64_t (10) << n, uint64_t (3600)));
+
+            cj->scheduled_timestamp = now + d;
+            build_db_->update (cj);
+          }
+        }
+        else if (pending || cj->generation != j->generation)
+        {
+          cj->attempts = 0;
+          cj->scheduled_timestamp = now;
+          build_db_->update (cj);
+        }
+        else
+          build_db_->erase (cj);
+      }
+
+      return changed;
+    };
+
+    update_tenant_service_state (conn,
+                                 tenant_service_map_,
+                                 j->service_type,
+                                 j->service_id,
+                                 update);
+
+    if (postpone)
+      l2 ([&]{trace << "tenant " << tenant_id << ": postponed outbound job "
+                    << "until rate limit window reset";});
+
+    return true;
+  }
 }
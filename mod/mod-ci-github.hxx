@@ -12,7 +12,9 @@
 
 #include <mod/ci-common.hxx>
 #include <mod/tenant-service.hxx>
+#include <mod/handler-metrics.hxx>
 
+#include <mod/jwt.hxx>
 #include <mod/mod-ci-github-gh.hxx>
 
 namespace brep
@@ -94,6 +96,46 @@ namespace brep
     virtual void
     init (cli::scanner&) override;
 
+    // Handle the webhook event reading the payload from the request body
+    // stream.
+    //
+    // Call the authenticate callback after the payload is parsed (or fails
+    // to parse) but before acting upon it. The callback verifies the request
+    // HMAC (throwing invalid_request if it doesn't match) and returns false
+    // if the event delivery is a duplicate and should be ignored.
+    //
+    bool
+    handle_event (const string& event,
+                  istream& body,
+                  uint64_t app_id,
+                  bool warning_success,
+                  const function<bool ()>& authenticate);
+
+    // Call the function, retrying it on the recoverable database errors and
+    // failing if no retries are left.
+    //
+    // Note that the webhook request content is not cached and so the request
+    // handling cannot be retried (see database_module::handle()) once the
+    // request body is read. Thus, the functions that access the database
+    // after that (record the delivery, act upon the parsed event, etc) are
+    // retried instead.
+    //
+    bool
+    retry_recoverable (const function<bool ()>&);
+
+    // Record the webhook delivery in the build database. Return false if it
+    // has already been recorded.
+    //
+    bool
+    record_delivery (const string& delivery_id);
+
+    // Remove the webhook delivery record from the build database. Issue
+    // diagnostics if unable to.
+    //
+    void
+    forget_delivery (const string& delivery_id,
+                     const basic_mark& error) noexcept;
+
     // Handle push events (branch push).
     //
     // If warning_success is true, then map result_status::warning to SUCCESS
@@ -171,6 +213,13 @@ namespace brep
     string
     details_url (const string& tenant_id) const;
 
+    // Build a check run details_url for a build from the tenant id and the
+    // full build id (see gh_check_run_name() for details). Return nullopt if
+    // the build id cannot be parsed.
+    //
+    optional<string>
+    details_url (const string& tenant_id, const string& build_id) const;
+
     // Generate a force rebuild link in Markdown. For example:
     //
     //   [Force rebuild](https://...)
@@ -205,6 +254,38 @@ namespace brep
                                       string jwt,
                                       const basic_mark& error) const;
 
+    // Return the installation access token (IAT) for the app installation,
+    // obtaining a new one (see above) only if there is no valid token in the
+    // cache. Issue diagnostics and return nullopt if something goes wrong.
+    //
+    // The tokens are cached in the web server process memory and in the
+    // build database, so that they are shared between the web server
+    // processes. Only a single thread per process obtains a new token for an
+    // installation at a time, with the others waiting for the result.
+    //
+    optional<gh_installation_access_token>
+    installation_access_token (uint64_t app_id,
+                               const string& install_id,
+                               const basic_mark& trace,
+                               const basic_mark& error) const;
+
+    // Drop the installation access token from the process and database
+    // caches and consider it expired from now on (see below). Called if
+    // GitHub responds with 401 (Unauthorized) to a request authenticated with
+    // this token (see gq_unauthorized_handler for details), so that a new
+    // token is obtained (once) by the subsequent installation_access_token()
+    // call.
+    //
+    void
+    invalidate_installation_access_token (const string& token,
+                                          const basic_mark& error) const;
+
+    // Return true if the installation access token (normally, saved in the
+    // service data) has expired or has been invalidated.
+    //
+    static bool
+    installation_access_expired (const gh_installation_access_token&);
+
     // Return the number of notification points currently available for a CI
     // job. Return 0 if no points are left until the next rate limits reset
     // time point or if something goes wrong (limits information looks
@@ -215,12 +296,130 @@ namespace brep
     report_budget (const gq_rate_limits&,
                    const basic_mark& error) const;
 
+    // Shared per-installation GraphQL API rate limit budget ledger.
+    //
+    // The latest rate limits status returned to any web server process (see
+    // gq_rate_limits) is saved in the build database together with the
+    // number of points allocated to the CI jobs reporting in the detailed
+    // mode in the current rate limit window. This way all the processes
+    // base their decisions on the same budget, which also accounts for the
+    // points that are allocated but not yet used.
+    //
+    // Save the rate limits status, if present, unless it is outdated. Issue
+    // diagnostics if unable to. Must be called out of the database
+    // transaction.
+    //
+    void
+    save_rate_limits (const string& install_id,
+                      const gq_rate_limits&,
+                      const basic_mark& error) const noexcept;
+
+    // Return the latest saved rate limits status or nullopt if unknown. If
+    // requested, reduce the remaining points by the points which are
+    // allocated but not yet used. Issue diagnostics and return nullopt if
+    // something goes wrong. Must be called out of the database transaction.
+    //
+    optional<gq_rate_limits>
+    find_rate_limits (const string& install_id,
+                      bool exclude_allocated,
+                      const basic_mark& error) const noexcept;
+
+    // Allocate the specified number of points from the installation's budget
+    // unless the remaining points (see above), excluding the reserve (see
+    // report_budget() for details), are insufficient, in which case return
+    // false. Allocate unconditionally if force is true. Return true if the
+    // budget is unknown or something goes wrong (issuing diagnostics in the
+    // latter case). Must be called out of the database transaction.
+    //
+    bool
+    allocate_rate_limits (const string& install_id,
+                          uint64_t points,
+                          bool force,
+                          const basic_mark& error) const noexcept;
+
+    // Return the delay of the deferred work for the app installation (check
+    // suite rebuild, unloaded tenant notification, etc) which is normally
+    // performed after the specified base delay. The delay is increased if the
+    // latest GraphQL API rate limit budget observed for the installation is
+    // insufficient to perform the queued units of work (the installation's
+    // unloaded tenants) before the rate limit window reset time point,
+    // spreading them over the time left, and up to deferring the work until
+    // the reset if the budget is exhausted. Must be called out of the
+    // database transaction.
+    //
+    // Note that the unloaded tenants are only counted if the rate limits
+    // are known and the rate limit window is not reset yet.
+    //
+    std::chrono::seconds
+    deferral_delay (const string& install_id,
+                    std::chrono::seconds base,
+                    const basic_mark& error) const;
+
+    // Return the number of the unloaded tenants of this service for the app
+    // installation. Issue diagnostics and return 0 if something goes wrong.
+    // Must be called out of the database transaction.
+    //
+    size_t
+    unloaded_tenant_count (const string& install_id,
+                           const basic_mark& error) const noexcept;
+
+    // Postpone the next build_unloaded() notification for the tenant by the
+    // specified delay. Issue diagnostics and return false if unable to. Must
+    // be called out of the database transaction.
+    //
+    bool
+    postpone_unloaded (const string& tenant_id,
+                       std::chrono::seconds delay,
+                       const basic_mark& error) const noexcept;
+
+    // Outbound GitHub API request queue (see the ci-github-outbound-queue
+    // option for details).
+    //
+    // Enqueue the outbound job for the tenant service, unless already
+    // enqueued, scheduling it to be performed after the specified delay.
+    // Must be called within the build database transaction.
+    //
+    void
+    enqueue_outbound_job (const string& tenant_id,
+                          const tenant_service&,
+                          std::chrono::seconds delay =
+                            std::chrono::seconds (0)) const;
+
+    // Perform the due outbound jobs until stopped. Called in the sender
+    // thread of the handler exemplar.
+    //
+    void
+    send_outbound_jobs ();
+
+    // Claim and perform a single due outbound job, if any. Return false if
+    // there are no jobs to perform at the moment.
+    //
+    bool
+    send_outbound_job ();
+
   private:
     shared_ptr<options::ci_github> options_;
 
     tenant_service_map& tenant_service_map_;
 
     string webhook_secret_;
+
+    // App id to private key map. NULL if the openssl program is used (see
+    // the ci-github-openssl-program option for details).
+    //
+    shared_ptr<const std::map<uint64_t, jwt_private_key>> private_keys_;
+
+    // The currently chosen deferred work delays (see deferral_delay() for
+    // details).
+    //
+    handler_metrics::gauge* rebuild_delay_gauge_ = nullptr;
+    handler_metrics::gauge* unloaded_delay_gauge_ = nullptr;
+
+    // Note: must be declared last so that the sender thread is stopped
+    // before any other member is destroyed.
+    //
+    struct outbound_queue;
+    shared_ptr<outbound_queue> outbound_queue_; // NULL if not enabled.
   };
 }
 
@@ -137,7 +137,8 @@ handle (request& rq, response& rs)
     return u;
   };
 
-  xml::serializer s (rs.content (), name.string ());
+  ostream& os (rs.content ());
+  xml::serializer s (os, name.string ());
 
   s << HTML
     <<   HEAD
@@ -193,6 +194,8 @@ handle (request& rq, response& rs)
                         true /* strip_title */,
                         id,
                         what,
+                        options_->package_text_cache (),
+                        os,
                         error)
             : DIV_TEXT (*d,
                         true /* strip_title */,
@@ -200,6 +203,8 @@ handle (request& rq, response& rs)
                         url (!full, squery, page, id),
                         id,
                         what,
+                        options_->package_text_cache (),
+                        os,
                         error));
     }
 
@@ -63,7 +63,7 @@ init (scanner& s)
     database_module::init (static_cast<const options::build_db&> (*options_),
                            options_->build_db_retry ());
 
-    build_config_module::init (*options_);
+    build_config_module::init (*options_, log_writer_);
   }
 
   if (options_->root ().empty ())
@@ -161,7 +161,8 @@ handle (request& rq, response& rs)
   const string& name (pkg->name.string ());
 
   const string title (name + ' ' + sver);
-  xml::serializer s (rs.content (), title);
+  ostream& os (rs.content ());
+  xml::serializer s (os, title);
 
   s << HTML
     <<   HEAD
@@ -201,6 +202,8 @@ handle (request& rq, response& rs)
                       true /* strip_title */,
                       id,
                       what,
+                      options_->package_text_cache (),
+                      os,
                       error)
           : DIV_TEXT (*d,
                       true /* strip_title */,
@@ -208,6 +211,8 @@ handle (request& rq, response& rs)
                       url (!full, id),
                       id,
                       what,
+                      options_->package_text_cache (),
+                      os,
                       error));
   }
 
@@ -758,7 +763,7 @@ handle (request& rq, response& rs)
     // Query toolchains seen for the package tenant to produce a list of the
     // unbuilt configuration/toolchain combinations.
     //
-    vector<pair<string, version>> toolchains;
+    pmr::vector<pair<string, version>> toolchains (arena ());
     {
       using query = query<toolchain>;
 
@@ -781,7 +786,7 @@ handle (request& rq, response& rs)
     using query = query<build>;
 
     query sq (false);
-    set<config_toolchain> unbuilt_configs;
+    pmr::set<config_toolchain> unbuilt_configs (arena ());
 
     for (const package_build_config& pc: pkg->build_configs)
     {
@@ -823,17 +828,6 @@ handle (request& rq, response& rs)
             sq) +
            "ORDER BY" + query::timestamp + "DESC"))
     {
-      string ts (butl::to_string (b.timestamp,
-                                  "%Y-%m-%d %H:%M:%S %Z",
-                                  true /* special */,
-                                  true /* local */) +
-                 " (" + butl::to_string (now - b.timestamp, false) + " ago");
-
-      if (tn->archived)
-        ts += ", archived";
-
-      ts += ')';
-
       // @@ Note that here we also load result logs which we don't need.
       //    Probably we should invent some table view to only load operation
       //    names and statuses.
@@ -852,7 +846,7 @@ handle (request& rq, response& rs)
       if (ppc)
         s <<   TR_VALUE ("pkg config", b.package_config_name);
 
-      s  <<    TR_VALUE ("timestamp", ts);
+      s  <<    TR_BUILD_TIMESTAMP (b, now, tn->archived);
 
       if (b.interactive) // Note: can only be present for the building state.
         s <<   TR_VALUE ("login", *b.interactive);
@@ -946,6 +940,8 @@ handle (request& rq, response& rs)
                       false /* strip_title */,
                       id,
                       what,
+                      options_->package_text_cache (),
+                      os,
                       error)
           : DIV_TEXT (*c,
                       false /* strip_title */,
@@ -953,6 +949,8 @@ handle (request& rq, response& rs)
                       url (!full, id),
                       id,
                       what,
+                      options_->package_text_cache (),
+                      os,
                       error));
   }
 
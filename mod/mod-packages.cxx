@@ -107,6 +107,8 @@ handle (request& rq, response& rs)
   const string& squery (params.q ());
   string equery (web::mime_url_encode (squery));
 
+  rs.compress ();
+
   xml::serializer s (rs.content (), title);
 
   s << HTML
@@ -13,6 +13,7 @@
 
 #include <mod/module.hxx>
 #include <mod/module-options.hxx>
+#include <mod/handler-metrics.hxx>
 
 #include <mod/mod-ci.hxx>
 #include <mod/mod-ci-github.hxx>
@@ -94,9 +95,9 @@ namespace brep
     cookies () {return request_.cookies ();}
 
     virtual istream&
-    content (size_t limit, size_t buffer)
+    content (size_t limit, size_t buffer, size_t memory)
     {
-      return request_.content (limit, buffer);
+      return request_.content (limit, buffer, memory);
     }
 
   private:
@@ -147,64 +148,65 @@ namespace brep
       : handler (r),
         tenant_service_map_ (
           r.initialized_
-          ? r.tenant_service_map_
+          ? nullptr
           : make_shared<tenant_service_map> ()),
         //
-        // Deep/shallow-copy sub-handlers depending on whether this is an
-        // exemplar/handler.
+        // Deep-copy sub-handlers if this is an exemplar. The handling
+        // instance refers to the exemplar's sub-handlers instead (see
+        // exemplar_ for details).
         //
         packages_ (
           r.initialized_
-          ? r.packages_
+          ? nullptr
           : make_shared<packages> (*r.packages_)),
         advanced_search_ (
           r.initialized_
-          ? r.advanced_search_
+          ? nullptr
           : make_shared<advanced_search> (*r.advanced_search_)),
         package_details_ (
           r.initialized_
-          ? r.package_details_
+          ? nullptr
           : make_shared<package_details> (*r.package_details_)),
         package_version_details_ (
           r.initialized_
-          ? r.package_version_details_
+          ? nullptr
           : make_shared<package_version_details> (
               *r.package_version_details_)),
         repository_details_ (
           r.initialized_
-          ? r.repository_details_
+          ? nullptr
           : make_shared<repository_details> (*r.repository_details_)),
         build_task_ (
           r.initialized_
-          ? r.build_task_
+          ? nullptr
           : make_shared<build_task> (*r.build_task_, *tenant_service_map_)),
         build_result_ (
           r.initialized_
-          ? r.build_result_
+          ? nullptr
           : make_shared<build_result> (*r.build_result_, *tenant_service_map_)),
         build_force_ (
           r.initialized_
-          ? r.build_force_
+          ? nullptr
           : make_shared<build_force> (*r.build_force_, *tenant_service_map_)),
         build_log_ (
           r.initialized_
-          ? r.build_log_
+          ? nullptr
           : make_shared<build_log> (*r.build_log_)),
         builds_ (
           r.initialized_
-          ? r.builds_
+          ? nullptr
           : make_shared<builds> (*r.builds_)),
         build_configs_ (
           r.initialized_
-          ? r.build_configs_
+          ? nullptr
           : make_shared<build_configs> (*r.build_configs_)),
         submit_ (
           r.initialized_
-          ? r.submit_
+          ? nullptr
           : make_shared<submit> (*r.submit_)),
         ci_ (
           r.initialized_
-          ? r.ci_
+          ? nullptr
 #ifdef BREP_CI_TENANT_SERVICE
           : make_shared<ci> (*r.ci_, *tenant_service_map_)),
 #else
@@ -212,19 +214,20 @@ namespace brep
 #endif
         ci_cancel_ (
           r.initialized_
-          ? r.ci_cancel_
+          ? nullptr
           : make_shared<ci_cancel> (*r.ci_cancel_)),
         ci_github_ (
           r.initialized_
-          ? r.ci_github_
+          ? nullptr
           : make_shared<ci_github> (*r.ci_github_, *tenant_service_map_)),
         upload_ (
           r.initialized_
-          ? r.upload_
+          ? nullptr
           : make_shared<upload> (*r.upload_)),
-        options_ (
+        options_ (nullptr),
+        exemplar_ (
           r.initialized_
-          ? r.options_
+          ? (r.exemplar_ != nullptr ? r.exemplar_ : &r)
           : nullptr)
   {
   }
@@ -355,7 +358,12 @@ namespace brep
   {
     HANDLER_DIAG;
 
-    const dir_path& root (options_->root ());
+    // The exemplar which owns the sub-handler exemplars and options.
+    //
+    const repository_root& e (exemplar_ != nullptr ? *exemplar_ : *this);
+    const options::repository_root& ops (*e.options_);
+
+    const dir_path& root (ops.root ());
 
     const path& rpath (rq.path ());
     if (!rpath.sub (root))
@@ -434,103 +442,114 @@ namespace brep
       const name_values& params (rq.parameters (0 /* limit */,
                                                 true /* url_only */));
 
-      auto dispatch = [&handle, this] (const string& func,
-                                       bool param) -> optional<bool>
+      auto dispatch = [&handle, &rs, &e, &ops, this] (const string& func,
+                                                  bool param) -> optional<bool>
       {
         // When adding a new handler don't forget to check if need to add it
         // to the default view list in the init() function.
         //
         if (func == "build-task")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new build_task (*build_task_));
+          if (!handler_)
+            handler_.emplace<build_task> (*e.build_task_);
 
           return handle ("build_task", param);
         }
         else if (func == "build-result")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new build_result (*build_result_));
+          if (!handler_)
+            handler_.emplace<build_result> (*e.build_result_);
 
           return handle ("build_result", param);
         }
         else if (func == "build-force")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new build_force (*build_force_));
+          if (!handler_)
+            handler_.emplace<build_force> (*e.build_force_);
 
           return handle ("build_force", param);
         }
         else if (func == "builds")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new builds (*builds_));
+          if (!handler_)
+            handler_.emplace<builds> (*e.builds_);
 
           return handle ("builds", param);
         }
         else if (func == "build-configs")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new build_configs (*build_configs_));
+          if (!handler_)
+            handler_.emplace<build_configs> (*e.build_configs_);
 
           return handle ("build_configs", param);
         }
         else if (func == "packages")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new packages (*packages_));
+          if (!handler_)
+            handler_.emplace<packages> (*e.packages_);
 
           return handle ("packages", param);
         }
         else if (func == "advanced-search")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new advanced_search (*advanced_search_));
+          if (!handler_)
+            handler_.emplace<advanced_search> (*e.advanced_search_);
 
           return handle ("advanced_search", param);
         }
         else if (func == "about")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new repository_details (*repository_details_));
+          if (!handler_)
+            handler_.emplace<repository_details> (*e.repository_details_);
 
           return handle ("repository_details", param);
         }
         else if (func == "submit")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new submit (*submit_));
+          if (!handler_)
+            handler_.emplace<submit> (*e.submit_);
 
           return handle ("submit", param);
         }
         else if (func == "ci")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new ci (*ci_));
+          if (!handler_)
+            handler_.emplace<ci> (*e.ci_);
 
           return handle ("ci", param);
         }
         else if (func == "ci-cancel")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new ci_cancel (*ci_cancel_));
+          if (!handler_)
+            handler_.emplace<ci_cancel> (*e.ci_cancel_);
 
           return handle ("ci-cancel", param);
         }
         else if (func == "ci-github")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new ci_github (*ci_github_));
+          if (!handler_)
+            handler_.emplace<ci_github> (*e.ci_github_);
 
           return handle ("ci_github", param);
         }
         else if (func == "upload")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new upload (*upload_));
+          if (!handler_)
+            handler_.emplace<upload> (*e.upload_);
 
           return handle ("upload", param);
         }
+        else if (func == "stats" && ops.root_stats ())
+        {
+          // Print the handler metrics in the Prometheus text format. Note
+          // that this is not a sub-handler and so the function parameter
+          // value, if present, is ignored.
+          //
+          handler_metrics::print (
+            rs.content (200, "text/plain;version=0.0.4;charset=utf-8"));
+
+          return true;
+        }
         else
           return nullopt;
       };
@@ -542,8 +561,8 @@ namespace brep
         return *r;
 
       const string& view (!tenant.empty ()
-                          ? options_->root_tenant_view ()
-                          : options_->root_global_view ());
+                          ? ops.root_tenant_view ()
+                          : ops.root_global_view ());
 
       r = dispatch (view, false /* param */);
 
@@ -581,23 +600,23 @@ namespace brep
       {
         if (i == lpath.end ())
         {
-          if (handler_ == nullptr)
-            handler_.reset (new package_details (*package_details_));
+          if (!handler_)
+            handler_.emplace<package_details> (*e.package_details_);
 
           return handle ("package_details");
         }
         else if (++i == lpath.end ())
         {
-          if (handler_ == nullptr)
-            handler_.reset (
-              new package_version_details (*package_version_details_));
+          if (!handler_)
+            handler_.emplace<package_version_details> (
+              *e.package_version_details_);
 
           return handle ("package_version_details");
         }
         else if (*i == "log")
         {
-          if (handler_ == nullptr)
-            handler_.reset (new build_log (*build_log_));
+          if (!handler_)
+            handler_.emplace<build_log> (*e.build_log_);
 
           return handle ("build_log");
         }
@@ -606,7 +625,7 @@ namespace brep
 
     // We shouldn't be selecting a handler if decline to handle the request.
     //
-    assert (handler_ == nullptr);
+    assert (!handler_);
     return false;
   }
 
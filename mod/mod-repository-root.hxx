@@ -10,6 +10,7 @@
 #include <mod/module.hxx>
 #include <mod/module-options.hxx>
 #include <mod/tenant-service.hxx>
+#include <mod/inplace-handler.hxx>
 
 namespace brep
 {
@@ -40,9 +41,18 @@ namespace brep
     // Create a shallow copy (handling instance) if initialized and a deep
     // copy (context exemplar) otherwise.
     //
+    // Note that the handling instance doesn't copy the sub-handler exemplars
+    // and options but refers to them via the context exemplar, which
+    // outlives all its handling instances. This way, since the handling
+    // instance is created for each request, we keep the per-request
+    // dispatch overhead to the minimum.
+    //
     explicit
     repository_root (const repository_root&);
 
+    repository_root&
+    operator= (const repository_root&) = delete;
+
   private:
     virtual bool
     handle (request&, response&);
@@ -84,12 +94,20 @@ namespace brep
 
     shared_ptr<options::repository_root> options_;
 
+    // Context exemplar for the handling instance and NULL for the exemplar
+    // itself.
+    //
+    const repository_root* exemplar_ = nullptr;
+
     // Sub-handler the request is dispatched to. Initially is NULL. It is set
-    // by the first call to handle() to a deep copy of the selected exemplar.
-    // The subsequent calls of handle() (that may take place after the retry
+    // by the first call to handle() to a copy of the selected exemplar. The
+    // subsequent calls of handle() (that may take place after the retry
     // exception is thrown) will use the existing handler instance.
     //
-    unique_ptr<handler> handler_;
+    // Note that the sub-handler is constructed in place to avoid the heap
+    // allocation per request (see inplace_handler for details).
+    //
+    inplace_handler<handler, 4096> handler_;
   };
 }
 
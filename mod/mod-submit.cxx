@@ -342,27 +342,18 @@ handle (request& rq, response& rs)
 
   try
   {
-    istream& is (rq.open_upload ("archive"));
-
-    // Note that istream::read() sets failbit if unable to read the requested
-    // number of bytes.
-    //
-    is.exceptions (istream::badbit);
-
     sha256 sha;
-    char buf[8192];
     ofdstream os (af, fdopen_mode::binary);
 
-    while (!eof (is))
-    {
-      is.read (buf, sizeof (buf));
-
-      if (size_t n = is.gcount ())
-      {
-        sha.append (buf, n);
-        os.write (buf, n);
-      }
-    }
+    // Hash and save the archive data directly from the request memory,
+    // bypassing the upload stream.
+    //
+    rq.read_upload ("archive",
+                    [&sha, &os] (const char* d, size_t n)
+                    {
+                      sha.append (d, n);
+                      os.write (d, n);
+                    });
 
     os.close ();
 
@@ -372,7 +363,7 @@ handle (request& rq, response& rs)
     if (sha.string () != sha256sum)
       return respond_manifest (422, "package archive checksum mismatch");
   }
-  // Note that invalid_argument (thrown by open_upload() function call) can
+  // Note that invalid_argument (thrown by read_upload() function call) can
   // mean both no archive upload or multiple archive uploads.
   //
   catch (const invalid_argument&)
@@ -678,6 +669,8 @@ handle (request& rq, response& rs)
   if (options_->submit_email_specified () && simulate.empty ())
   try
   {
+    request_phase rp ("sendmail");
+
     // Redirect the diagnostics to the web server error log.
     //
     sendmail sm (print_args,
@@ -7,9 +7,13 @@
 #include <http_log.h>
 
 #include <sstream>
+#include <cstdlib>    // free()
 #include <cstring>    // strchr()
+#include <typeinfo>
 #include <functional> // bind()
 
+#include <cxxabi.h>   // __cxa_demangle()
+
 #include <web/server/module.hxx>
 #include <web/server/apache/log.hxx>
 
@@ -25,15 +29,87 @@ namespace brep
   bool handler::
   handle (request& rq, response& rs, log& l)
   {
+    HANDLER_DIAG;
+
+    using namespace std::chrono;
+
+    using outcome = handler_metrics::outcome;
+
     log_ = &l;
 
+    steady_clock::time_point start (steady_clock::now ());
+    nanoseconds db (handler_metrics::db_time ());
+
+    // Profile the request for the slow request log, unless it is already
+    // being profiled by the enclosing handler (repository_root, etc), in
+    // which case just attribute the request to this handler.
+    //
+    request_profile* profile (slow_threshold_ != 0
+                              ? request_profile::start (start)
+                              : nullptr);
+
+    if (metrics_ != nullptr)
+    {
+      if (request_profile* p = request_profile::current ())
+        p->handler = &metrics_->name ();
+    }
+
+    // Handle the request using the per-request arena and trace its usage
+    // statistics afterwards, if any memory was allocated from it.
+    //
+    request_arena a;
+    arena_ = &a;
+
+    // Record the request metrics, log the request if it is slow, and
+    // release the arena.
+    //
+    auto finish = [&rq, &rs, &start, &db, profile, &a, &error, &trace, this]
+                  (outcome o)
+    {
+      nanoseconds d (steady_clock::now () - start);
+
+      if (metrics_ != nullptr)
+        metrics_->record (o,
+                          d,
+                          handler_metrics::db_time () - db,
+                          rs.content_size ());
+
+      if (profile != nullptr)
+      {
+        profile->stop ();
+
+        if (d >= milliseconds (slow_threshold_))
+        try
+        {
+          profile->write (*slow_log_, rq.path ().string (), d);
+        }
+        catch (const io_error& e)
+        {
+          error << "unable to write slow request log " << *slow_log_ << ": "
+                << e;
+        }
+      }
+
+      arena_ = nullptr;
+
+      l2 ([&a, &trace]
+          {
+            if (a.allocations () != 0)
+              trace << "arena: " << a.allocations () << " allocations ("
+                    << a.allocated () << " bytes), " << a.blocks ()
+                    << " heap blocks (" << a.reserved () << " bytes)";
+          });
+    };
+
     try
     {
       // Web server should terminate if initialization failed.
       //
       assert (initialized_);
 
-      return handle (rq, rs);
+      bool r (handle (rq, rs));
+      finish (r ? outcome::handled : outcome::declined);
+      return r;
     }
     catch (const server_error& e)
     {
@@ -69,7 +145,23 @@ namespace brep
         // it.
       }
     }
+    catch (const retry&)
+    {
+      finish (outcome::retried);
+      throw;
+    }
+    catch (const invalid_request&)
+    {
+      finish (outcome::invalid);
+      throw;
+    }
+    catch (...)
+    {
+      finish (outcome::failed);
+      throw;
+    }
 
+    finish (outcome::failed);
     return true;
   }
 
@@ -206,6 +298,37 @@ namespace brep
       options::handler o (s, cli::unknown_mode::fail, cli::unknown_mode::fail);
 
       verb_ = o.verbosity ();
+      request_memory_ = o.request_memory_max_size ();
+
+      if ((slow_threshold_ = o.slow_request_threshold ()) != 0)
+      {
+        if (o.slow_request_log ().empty ())
+          throw runtime_error (
+            "slow-request-log must be specified if slow-request-threshold "
+            "is not 0");
+
+        slow_log_ = make_shared<const path> (o.slow_request_log ());
+      }
+
+      // Register the handler metrics under the handler type name, stripping
+      // the namespace qualification (packages, build_task, etc).
+      //
+      string n (typeid (*this).name ());
+      {
+        int s;
+        if (char* d = abi::__cxa_demangle (n.c_str (), nullptr, nullptr, &s))
+        {
+          n = d;
+          free (d);
+        }
+
+        size_t p (n.rfind ("::"));
+        if (p != string::npos)
+          n.erase (0, p + 2);
+      }
+
+      metrics_ = &handler_metrics::instance (n);
+
       initialized_ = true;
     }
     catch (const server_error& e)
@@ -239,6 +362,10 @@ namespace brep
   {
     verb_ = m.verb_;
     initialized_ = m.initialized_;
+    request_memory_ = m.request_memory_;
+    metrics_ = m.metrics_;
+    slow_threshold_ = m.slow_threshold_;
+    slow_log_ = m.slow_log_;
   }
 
   // Here are examples of __PRETTY_FUNCTION__ for some function declarations:
@@ -11,6 +11,9 @@
 
 #include <mod/utility.hxx>
 #include <mod/diagnostics.hxx>
+#include <mod/request-arena.hxx>
+#include <mod/handler-metrics.hxx>
+#include <mod/request-profile.hxx>
 #include <mod/module-options.hxx>
 
 namespace brep
@@ -101,6 +104,23 @@ namespace brep
     //
     bool initialized_ = false;
 
+    // Maximum size of the cached request content kept in memory (see the
+    // request-memory-max-size option for details). Should be passed to
+    // request::content() by the handler implementations which cache the
+    // request content.
+    //
+    size_t request_memory_ = 0;
+
+    // Memory resource for the per-request temporary data, which can be used
+    // with the pmr containers on the hot paths. Is only valid while the
+    // request is being handled (see request_arena for details).
+    //
+    pmr::memory_resource*
+    arena () const noexcept
+    {
+      return arena_ != nullptr ? arena_ : pmr::get_default_resource ();
+    }
+
     // Implementation details.
     //
   protected:
@@ -196,6 +216,15 @@ namespace brep
   protected:
     log* log_ {nullptr}; // Diagnostics backend provided by the web server.
 
+  private:
+    request_arena* arena_ {nullptr};
+    handler_metrics* metrics_ {nullptr};
+
+    // Slow request logging (see the slow-request-* options for details).
+    //
+    size_t slow_threshold_ = 0; // Milliseconds.
+    shared_ptr<const path> slow_log_;
+
   private:
     // Extract the full-qualified function name from a __PRETTY_FUNCTION__.
     // Throw invalid_argument if fail to parse.
@@ -6,11 +6,17 @@
 #include <cmark-gfm.h>
 #include <cmark-gfm-extension_api.h>
 
-#include <set>
-#include <ios>      // hex, uppercase, right
+#include <ios>        // hex, uppercase, right
+#include <list>
+#include <mutex>
+#include <memory>     // shared_ptr
 #include <sstream>
-#include <iomanip>  // setw(), setfill()
-#include <iterator> // back_inserter()
+#include <iomanip>    // setw(), setfill()
+#include <iterator>   // back_inserter()
+#include <functional> // hash
+#include <unordered_map>
+
+#include <libbutl/timestamp.hxx> // to_stream()
 
 #include <libstudxml/serializer.hxx>
 
@@ -457,26 +463,24 @@ namespace brep
       // Suppress dependency alternative duplicates, like in
       // `{foo bar} < 1.1 | {foo bar} > 1.5`.
       //
-      // Return the dependency package name space-separated list.
+      // Return true if the dependency alternatives contain the same
+      // packages, in the same order.
       //
-      auto deps_list = [] (const dependency_alternative& da)
+      auto same = [] (const dependency_alternative& x,
+                      const dependency_alternative& y)
       {
-        string r;
-        for (const dependency& d: da)
-        {
-          if (!r.empty ())
-            r += ' ';
+        if (x.size () != y.size ())
+          return false;
 
-          r += d.name.string ();
+        for (size_t i (0); i != x.size (); ++i)
+        {
+          if (x[i].name != y[i].name)
+            return false;
         }
 
-        return r;
+        return true;
       };
 
-      set<string> alternatives;
-      for (const dependency_alternative& da: das)
-        alternatives.insert (deps_list (da));
-
       // Note that we may end up with a single package name in parenthesis, if
       // its duplicates were suppresses. This, however, may be helpful,
       // indicating that there some alternatives for the package.
@@ -488,15 +492,17 @@ namespace brep
         s << '(';
 
       bool first (true);
-      for (const dependency_alternative& da: das)
+      for (auto i (das.begin ()); i != das.end (); ++i)
       {
-        auto i (alternatives.find (deps_list (da)));
+        const dependency_alternative& da (*i);
 
-        if (i == alternatives.end ())
+        if (find_if (das.begin (), i,
+                     [&da, &same] (const dependency_alternative& x)
+                     {
+                       return same (x, da);
+                     }) != i)
           continue;
 
-        alternatives.erase (i);
-
         if (!first)
           s << " | ";
         else
@@ -522,12 +528,21 @@ namespace brep
               ? p->internal_repository.load ()
               : p->other_repositories[0].load ());
 
-            auto en (mime_url_encode (n.string (), false));
-
             if (r->interface_url)
-              s << A(HREF=*r->interface_url + en) << n << ~A;
+            {
+              // Compose the URL in a single buffer.
+              //
+              const string& pn (n.string ());
+              string u (*r->interface_url);
+              mime_url_encode (pn.c_str (), pn.size (), u, false /* query */);
+
+              s << A(HREF=u) << n << ~A;
+            }
             else if (p->internal ())
-              s << A(HREF=tenant_dir (root_, tenant_) / path (en)) << n << ~A;
+              s << A(HREF=tenant_dir (root_, tenant_) /
+                          path (mime_url_encode (n.string (), false)))
+                <<   n
+                << ~A;
             else
               // Display the dependency as plain text if no repository URL
               // available.
@@ -872,27 +887,34 @@ namespace brep
 
       if (!build_.results.empty ())
       {
+        // Compose the combined log URL once and derive the operation log
+        // URLs from it by appending the operation name, rather than
+        // composing each URL from scratch.
+        //
+        string url (build_log_url (host_, root_, build_));
+        size_t n (url.size ());
+
         for (const auto& r: build_.results)
         {
           if (r.status != result_status::success)
           {
             separate ();
 
+            url += '/';
+            url += r.operation;
+
             s << SPAN_BUILD_RESULT_STATUS (r.status) << " ("
-              << A
-              <<   HREF
-              <<     build_log_url (host_, root_, build_, &r.operation)
-              <<   ~HREF
-              <<   r.operation
-              << ~A
+              << A << HREF << url << ~HREF << r.operation << ~A
               << ")";
+
+            url.resize (n);
           }
         }
 
         separate ();
 
         s << A
-          <<   HREF << build_log_url (host_, root_, build_) << ~HREF
+          <<   HREF << url << ~HREF
           <<   "log"
           << ~A;
       }
@@ -918,6 +940,38 @@ namespace brep
       << ~TR;
   }
 
+  // TR_BUILD_TIMESTAMP
+  //
+  void TR_BUILD_TIMESTAMP::
+  operator() (serializer& s) const
+  {
+    // Compose the value in a single stream rather than concatenating the
+    // strings produced by butl::to_string(), which creates a stream for
+    // each call.
+    //
+    ostringstream os;
+
+    butl::to_stream (os,
+                     build_.timestamp,
+                     "%Y-%m-%d %H:%M:%S %Z",
+                     true /* special */,
+                     true /* local */);
+
+    os << " (";
+    butl::to_stream (os, now_ - build_.timestamp, false /* nanoseconds */);
+    os << " ago";
+
+    if (archived_)
+      os << ", archived";
+
+    os << ')';
+
+    s << TR(CLASS="timestamp")
+      <<   TH << "timestamp" << ~TH
+      <<   TD << SPAN(CLASS="value") << os.str () << ~SPAN << ~TD
+      << ~TR;
+  }
+
   // SPAN_COMMENT
   //
   void SPAN_COMMENT::
@@ -1036,6 +1090,120 @@ namespace brep
 
   // DIV_TEXT
   //
+  // Rendering Markdown into XHTML and validating the result is relatively
+  // expensive, while the same texts (package descriptions, changes, etc) are
+  // normally rendered over and over again. Thus, we cache the rendered and
+  // validated XHTML as raw fragments, keyed by the text and the rendering
+  // parameters, so that they are just spliced into the output stream for the
+  // subsequent requests.
+  //
+  // The cache entries are looked up by the text hash, so that the text is
+  // only copied when the entry is added.
+  //
+  // Not to grow the cache indefinitely we evict the least recently used
+  // entries when the total size of the cached texts and fragments exceeds
+  // the limit (see the package-text-cache option for details). Note that the
+  // cache is shared by all the handlers and the limit is specified by the
+  // handler that adds the entry.
+  //
+  struct fragment_cache_entry
+  {
+    size_t hash;
+    text_type type;
+    bool strip_title;
+    size_t length;
+    string text;
+    shared_ptr<const fragment> value;
+    size_t size;
+  };
+
+  using fragment_cache_list = list<fragment_cache_entry>; // LRU first.
+
+  static mutex fragment_cache_mutex;
+  static fragment_cache_list fragment_cache_lru;
+  static unordered_multimap<size_t, fragment_cache_list::iterator>
+  fragment_cache;
+  static size_t fragment_cache_size (0);
+
+  // Return the cached fragment, marking it as the most recently used, or
+  // NULL if not found. Must be called with the cache mutex locked.
+  //
+  static shared_ptr<const fragment>
+  find_fragment (size_t hash,
+                 text_type type,
+                 bool strip_title,
+                 size_t length,
+                 const string& text)
+  {
+    for (auto r (fragment_cache.equal_range (hash)); r.first != r.second;
+         ++r.first)
+    {
+      fragment_cache_list::iterator i (r.first->second);
+
+      if (i->type == type               &&
+          i->strip_title == strip_title &&
+          i->length == length           &&
+          i->text == text)
+      {
+        fragment_cache_lru.splice (fragment_cache_lru.end (),
+                                   fragment_cache_lru,
+                                   i);
+        return i->value;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // Add the fragment to the cache, evicting the least recently used entries
+  // if the cache size would otherwise exceed the limit. Must be called with
+  // the cache mutex locked.
+  //
+  static void
+  cache_fragment (size_t hash,
+                  text_type type,
+                  bool strip_title,
+                  size_t length,
+                  const string& text,
+                  shared_ptr<const fragment> value,
+                  size_t max_size)
+  {
+    size_t n (text.size () + value->memory_size ());
+
+    // Don't cache the fragment which doesn't fit into the cache at all.
+    //
+    if (n > max_size)
+      return;
+
+    while (fragment_cache_size + n > max_size)
+    {
+      const fragment_cache_entry& e (fragment_cache_lru.front ());
+
+      for (auto r (fragment_cache.equal_range (e.hash)); ; ++r.first)
+      {
+        assert (r.first != r.second);
+
+        if (r.first->second == fragment_cache_lru.begin ())
+        {
+          fragment_cache.erase (r.first);
+          break;
+        }
+      }
+
+      fragment_cache_size -= e.size;
+      fragment_cache_lru.pop_front ();
+    }
+
+    fragment_cache.emplace (
+      hash,
+      fragment_cache_lru.insert (
+        fragment_cache_lru.end (),
+        fragment_cache_entry {
+          hash, type, strip_title, length, text, move (value), n}));
+
+    fragment_cache_size += n;
+  }
+
   void DIV_TEXT::
   operator() (serializer& s) const
   {
@@ -1076,6 +1244,40 @@ namespace brep
           return;
         }
 
+        size_t length (url_ == nullptr ? 0 : length_);
+
+        auto print_fragment = [&s, this] (const fragment& f)
+        {
+          s << DIV(ID=id_, CLASS="markdown");
+
+          // Disable indentation not to introduce unwanted spaces.
+          //
+          s.suspend_indentation ();
+          f (s, os_);
+          s.resume_indentation ();
+
+          if (f.truncated)
+            s << DIV(CLASS="more")
+              <<   "... " << A(HREF=*url_) << "More" << ~A
+              << ~DIV;
+
+          s << ~DIV;
+        };
+
+        size_t h (hash<string> () (t));
+
+        shared_ptr<const fragment> cf;
+        {
+          lock_guard<mutex> l (fragment_cache_mutex);
+          cf = find_fragment (h, text_.type, strip_title_, length, t);
+        }
+
+        if (cf != nullptr)
+        {
+          print_fragment (*cf);
+          return;
+        }
+
         string html;
         {
           char* r;
@@ -1161,24 +1363,15 @@ namespace brep
         // closing tags. But let's not assume this being the case (due to some
         // library bug or similar) and handle the xml::parsing exception.
         //
+        // Note that we parse the fragment only once, to validate and
+        // truncate it, and then serialize it back into the trusted XHTML
+        // which is spliced into the output as is.
+        //
         try
         {
-          fragment f (html, "gfm-html", url_ == nullptr ? 0 : length_);
-
-          s << DIV(ID=id_, CLASS="markdown");
-
-          // Disable indentation not to introduce unwanted spaces.
-          //
-          s.suspend_indentation ();
-          s << f;
-          s.resume_indentation ();
-
-          if (f.truncated)
-            s << DIV(CLASS="more")
-              <<   "... " << A(HREF=*url_) << "More" << ~A
-              << ~DIV;
-
-          s << ~DIV;
+          fragment f (html, "gfm-html", length);
+          cf = make_shared<fragment> (fragment::raw (f.markup (),
+                                                     f.truncated));
         }
         catch (const xml::parsing& e)
         {
@@ -1186,8 +1379,26 @@ namespace brep
                         e.what ());
           diag_ << error;
           print_error (error);
+          return;
+        }
+
+        {
+          lock_guard<mutex> l (fragment_cache_mutex);
+
+          // Note that the same text could have been cached concurrently.
+          //
+          if (find_fragment (h, text_.type, strip_title_, length, t) ==
+              nullptr)
+            cache_fragment (h,
+                            text_.type,
+                            strip_title_,
+                            length,
+                            t,
+                            cf,
+                            cache_size_);
         }
 
+        print_fragment (*cf);
         break;
       }
     }
@@ -536,6 +536,24 @@ namespace brep
     const dir_path& root_;
   };
 
+  // Generate build timestamp element, that has the 'timestamp: <time> (<age>
+  // ago[, archived])' layout.
+  //
+  class TR_BUILD_TIMESTAMP
+  {
+  public:
+    TR_BUILD_TIMESTAMP (const build& b, const timestamp& n, bool a)
+        : build_ (b), now_ (n), archived_ (a) {}
+
+    void
+    operator() (xml::serializer&) const;
+
+  private:
+    const build& build_;
+    const timestamp& now_;
+    bool archived_;
+  };
+
   // Generate comment element.
   //
   class SPAN_COMMENT
@@ -632,6 +650,11 @@ namespace brep
   // this only applies to Markdown where a leading level-one heading is
   // assumed to be the title.
   //
+  // The rendered Markdown texts are cached in memory, as long as the total
+  // size of the cache doesn't exceed the specified limit (0 disables the
+  // caching), and are written directly into the specified output stream,
+  // which must be the stream the serializer writes to.
+  //
   class DIV_TEXT
   {
   public:
@@ -641,6 +664,8 @@ namespace brep
               bool st,
               const string& id,
               const string& what,
+              size_t cache_size,
+              ostream& os,
               const basic_mark& diag)
         : text_ (t),
           strip_title_ (st),
@@ -648,6 +673,8 @@ namespace brep
           url_ (nullptr),
           id_ (id),
           what_ (what),
+          cache_size_ (cache_size),
+          os_ (os),
           diag_ (diag)
     {
     }
@@ -660,6 +687,8 @@ namespace brep
               const string& u,
               const string& id,
               const string& what,
+              size_t cache_size,
+              ostream& os,
               const basic_mark& diag)
         : text_ (t),
           strip_title_ (st),
@@ -667,6 +696,8 @@ namespace brep
           url_ (&u),
           id_ (id),
           what_ (what),
+          cache_size_ (cache_size),
+          os_ (os),
           diag_ (diag)
     {
     }
@@ -681,6 +712,8 @@ namespace brep
     const string* url_; // Full page url.
     string id_;
     const string& what_;
+    size_t cache_size_;
+    ostream& os_;
     const basic_mark& diag_;
   };
 
@@ -0,0 +1,64 @@
+// file      : mod/request-arena.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/request-arena.hxx>
+
+namespace brep
+{
+  // request_arena::counter
+  //
+  void* request_arena::counter::
+  do_allocate (size_t n, size_t a)
+  {
+    void* r (pmr::new_delete_resource ()->allocate (n, a));
+
+    ++blocks;
+    bytes += n;
+
+    return r;
+  }
+
+  void request_arena::counter::
+  do_deallocate (void* p, size_t n, size_t a)
+  {
+    pmr::new_delete_resource ()->deallocate (p, n, a);
+  }
+
+  bool request_arena::counter::
+  do_is_equal (const pmr::memory_resource& r) const noexcept
+  {
+    return this == &r;
+  }
+
+  // request_arena
+  //
+  request_arena::
+  request_arena ()
+      : monotonic_ (buffer_, sizeof (buffer_), &upstream_),
+        pool_ (&monotonic_)
+  {
+  }
+
+  void* request_arena::
+  do_allocate (size_t n, size_t a)
+  {
+    void* r (pool_.allocate (n, a));
+
+    ++allocations_;
+    allocated_ += n;
+
+    return r;
+  }
+
+  void request_arena::
+  do_deallocate (void* p, size_t n, size_t a)
+  {
+    pool_.deallocate (p, n, a);
+  }
+
+  bool request_arena::
+  do_is_equal (const pmr::memory_resource& r) const noexcept
+  {
+    return this == &r;
+  }
+}
@@ -0,0 +1,94 @@
+// file      : mod/request-arena.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_REQUEST_ARENA_HXX
+#define MOD_REQUEST_ARENA_HXX
+
+#include <memory_resource>
+
+#include <libbrep/types.hxx>
+#include <libbrep/utility.hxx>
+
+namespace brep
+{
+  namespace pmr = std::pmr;
+
+  // Memory resource for the temporary data which only lives while a request
+  // is handled (query results, sets of configurations, etc). The memory is
+  // obtained from the heap in progressively growing blocks (the first one
+  // being the arena's own storage) and is only returned at the end of the
+  // request, when the arena is destroyed. Deallocated memory is reused via
+  // the size-segregated free lists, so that the node-based containers with
+  // the frequent insertions and removals don't grow the arena indefinitely.
+  //
+  // The arena also counts the allocations served and the blocks obtained from
+  // the heap, for the diagnostics.
+  //
+  // Note that the arena is not thread-safe (the same as the handler which
+  // owns it).
+  //
+  class request_arena: public pmr::memory_resource
+  {
+  public:
+    request_arena ();
+
+    request_arena (const request_arena&) = delete;
+    request_arena& operator= (const request_arena&) = delete;
+
+    // Statistics.
+    //
+    size_t
+    allocations () const noexcept {return allocations_;}
+
+    size_t
+    allocated () const noexcept {return allocated_;}
+
+    size_t
+    blocks () const noexcept {return upstream_.blocks;}
+
+    size_t
+    reserved () const noexcept {return upstream_.bytes;}
+
+  protected:
+    virtual void*
+    do_allocate (size_t, size_t) override;
+
+    virtual void
+    do_deallocate (void*, size_t, size_t) override;
+
+    virtual bool
+    do_is_equal (const pmr::memory_resource&) const noexcept override;
+
+  private:
+    // Heap resource which counts the allocated blocks.
+    //
+    struct counter: pmr::memory_resource
+    {
+      size_t blocks = 0;
+      size_t bytes = 0;
+
+      virtual void*
+      do_allocate (size_t, size_t) override;
+
+      virtual void
+      do_deallocate (void*, size_t, size_t) override;
+
+      virtual bool
+      do_is_equal (const pmr::memory_resource&) const noexcept override;
+    };
+
+    static const size_t initial_size = 4096;
+
+    size_t allocations_ = 0;
+    size_t allocated_ = 0;
+
+    counter upstream_;
+
+    alignas (std::max_align_t) unsigned char buffer_[initial_size];
+
+    pmr::monotonic_buffer_resource monotonic_;
+    pmr::unsynchronized_pool_resource pool_;
+  };
+}
+
+#endif // MOD_REQUEST_ARENA_HXX
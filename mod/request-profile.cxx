@@ -0,0 +1,133 @@
+// file      : mod/request-profile.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <mod/request-profile.hxx>
+
+#include <map>
+#include <new> // bad_alloc
+
+#include <unistd.h> // getpid()
+
+#include <libbutl/fdstream.hxx>
+#include <libbutl/json/serializer.hxx>
+
+using namespace std;
+using namespace std::chrono;
+using namespace butl;
+
+namespace brep
+{
+  static thread_local request_profile this_profile;
+  static thread_local bool profiling (false);
+
+  request_profile* request_profile::
+  start (clock::time_point t)
+  {
+    if (profiling)
+      return nullptr;
+
+    request_profile& r (this_profile);
+
+    r.start_time = t;
+    r.handler = nullptr;
+    r.phases.clear (); // Note: keeps the capacity.
+
+    profiling = true;
+    return &r;
+  }
+
+  void request_profile::
+  stop () noexcept
+  {
+    assert (this == &this_profile);
+
+    profiling = false;
+  }
+
+  request_profile* request_profile::
+  current () noexcept
+  {
+    return profiling ? &this_profile : nullptr;
+  }
+
+  void request_profile::
+  record (const char* n, clock::time_point s, clock::time_point e) noexcept
+  {
+    try
+    {
+      phases.push_back (phase {n, s - start_time, e - s});
+    }
+    catch (const bad_alloc&)
+    {
+      // Not worth failing the request over.
+    }
+  }
+
+  void request_profile::
+  write (const path& log, const string& rp, nanoseconds latency) const
+  {
+    auto us = [] (nanoseconds d) -> uint64_t
+    {
+      return duration_cast<microseconds> (d).count ();
+    };
+
+    vector<char> b;
+    {
+      json::buffer_serializer s (b, 0 /* indentation */);
+
+      s.begin_object ();
+
+      s.member ("time",
+                butl::to_string (system_clock::now (),
+                                 "%Y-%m-%dT%H:%M:%SZ",
+                                 false /* special */,
+                                 false /* local */));
+
+      s.member ("pid", static_cast<uint64_t> (getpid ()));
+
+      if (handler != nullptr)
+        s.member ("handler", *handler);
+
+      s.member ("path", rp);
+      s.member ("latency_us", us (latency));
+
+      // Total time per phase type.
+      //
+      map<string, nanoseconds> ts;
+      for (const phase& p: phases)
+        ts[p.name] += p.duration;
+
+      s.member_begin_object ("totals_us");
+      for (const auto& t: ts)
+        s.member (t.first, us (t.second));
+      s.end_object ();
+
+      s.member_begin_array ("phases");
+      for (const phase& p: phases)
+      {
+        s.begin_object ();
+        s.member ("phase", p.name);
+        s.member ("start_us", us (p.start));
+        s.member ("duration_us", us (p.duration));
+        s.end_object ();
+      }
+      s.end_array ();
+
+      s.end_object ();
+    }
+
+    b.push_back ('\n');
+
+    // Note that the log is opened in the append mode for every entry, so
+    // that it can be rotated and shared between the web server processes
+    // (which, on POSIX, append atomically with a single write).
+    //
+    ofdstream os (log,
+                  fdopen_mode::out    |
+                  fdopen_mode::create |
+                  fdopen_mode::append);
+
+    os.write (b.data (), b.size ());
+    os.close ();
+  }
+}
@@ -0,0 +1,100 @@
+// file      : mod/request-profile.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef MOD_REQUEST_PROFILE_HXX
+#define MOD_REQUEST_PROFILE_HXX
+
+#include <chrono>
+
+#include <libbrep/types.hxx>
+#include <libbrep/utility.hxx>
+
+namespace brep
+{
+  // Time breakdown of the request handling by phases (acquiring database
+  // connections, database transactions, running external programs, etc),
+  // for the slow request log.
+  //
+  // The phases are only recorded if profiling is started for the request
+  // being handled by the current thread (see handler::handle() for details),
+  // so that the instrumentation is essentially free otherwise.
+  //
+  class request_profile
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct phase
+    {
+      const char* name;               // For example, "transaction", "curl".
+      std::chrono::nanoseconds start; // Since the request handling start.
+      std::chrono::nanoseconds duration;
+    };
+
+    clock::time_point start_time;
+    const string* handler = nullptr;  // Innermost handler name.
+    vector<phase> phases;
+
+    // Start profiling the request being handled by the current thread and
+    // return the profile, unless it is already being profiled, in which
+    // case return NULL. The caller which started the profiling is expected
+    // to stop it.
+    //
+    static request_profile*
+    start (clock::time_point);
+
+    void
+    stop () noexcept;
+
+    // Return the profile of the request being handled by the current thread
+    // or NULL if it is not being profiled.
+    //
+    static request_profile*
+    current () noexcept;
+
+    void
+    record (const char* phase,
+            clock::time_point start,
+            clock::time_point end) noexcept;
+
+    // Append the profile as a single line JSON object to the slow request log
+    // file, creating it if not exists. Throw io_error on the underlying OS
+    // error.
+    //
+    void
+    write (const path& log,
+           const string& request_path,
+           std::chrono::nanoseconds latency) const;
+  };
+
+  // Record the time spent in the scope as the specified request phase, if
+  // the request is being profiled.
+  //
+  class request_phase
+  {
+  public:
+    explicit
+    request_phase (const char* name) noexcept
+        : name_ (name), profile_ (request_profile::current ())
+    {
+      if (profile_ != nullptr)
+        start_ = request_profile::clock::now ();
+    }
+
+    ~request_phase ()
+    {
+      if (profile_ != nullptr)
+        profile_->record (name_, start_, request_profile::clock::now ());
+    }
+
+    request_phase (const request_phase&) = delete;
+    request_phase& operator= (const request_phase&) = delete;
+
+  private:
+    const char* name_;
+    request_profile* profile_;
+    request_profile::clock::time_point start_;
+  };
+}
+
+#endif // MOD_REQUEST_PROFILE_HXX
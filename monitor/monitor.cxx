@@ -529,6 +529,8 @@ namespace brep
       return 1;
     }
 
+    build_class_index class_index (configs);
+
     // Create the database instance.
     //
     odb::pgsql::database db (
@@ -673,7 +675,7 @@ namespace brep
                                    p->builds,
                                    p->constraints,
                                    *ci->second,
-                                   configs.class_inheritance_map);
+                                   class_index);
               }
             }
 
@@ -913,7 +915,7 @@ namespace brep
                              p->builds,
                              p->constraints,
                              tc,
-                             configs.class_inheritance_map))
+                             class_index))
                   continue;
 
                 for (const pair<string, version>& t: toolchains)
@@ -1139,6 +1141,48 @@ namespace brep
       t.commit ();
     }
 
+    // Print the operation result logs compression statistics, if requested.
+    //
+    if (ops.log_stats ())
+    {
+      transaction t (db.begin ());
+
+      build_result_log_stats s (db.query_value<build_result_log_stats> ());
+
+      t.commit ();
+
+      try
+      {
+        cout.exceptions (ostream::badbit | ostream::failbit);
+
+        cout << "compressed logs:      " << s.count << endl
+             << "uncompressed size:    " << s.size << endl
+             << "compressed size:      " << s.compressed_size << endl
+             << "stored size:          " << s.stored_size << endl;
+
+        if (s.compressed_size != 0)
+        {
+          cout << "compression ratio:    "
+               << static_cast<double> (s.size) / s.compressed_size << endl;
+        }
+
+        // Note that this is the reduction relative to the uncompressed logs
+        // size rather than to the size the logs would occupy on disk if
+        // stored as text, which is subject to the TOAST compression.
+        //
+        cout << "uncompressed savings: "
+             << (s.size > s.stored_size ? s.size - s.stored_size : 0)
+             << endl
+             << "results table size:   " << s.results_table_size << endl
+             << "logs table size:      " << s.logs_table_size << endl;
+      }
+      catch (const io_error&)
+      {
+        cerr << "error: unable to write to stdout" << endl;
+        return 1;
+      }
+    }
+
     return 0;
   }
   catch (const database_locked&)
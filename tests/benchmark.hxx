@@ -0,0 +1,72 @@
+// file      : tests/benchmark.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef TESTS_BENCHMARK_HXX
+#define TESTS_BENCHMARK_HXX
+
+#include <chrono>
+#include <string>
+#include <cstddef> // size_t
+#include <cstdlib> // strtoull()
+
+#undef NDEBUG
+#include <cassert>
+
+// Microbenchmark support for the test drivers.
+//
+// The benchmarks are opt-in: a driver only runs them if the number of
+// iterations is specified with the leading --benchmark option, so that
+// `b test` only runs the assertions. For example:
+//
+// $ ./driver --benchmark 1000
+//
+namespace brep
+{
+  // Return the number of iterations specified with the leading --benchmark
+  // option or 0 if it is not specified. Remove the option from the
+  // arguments, if present.
+  //
+  inline std::size_t
+  benchmark_iterations (int& argc, char* argv[])
+  {
+    if (argc < 2 || std::string (argv[1]) != "--benchmark")
+      return 0;
+
+    assert (argc > 2);
+
+    std::size_t r (std::strtoull (argv[2], nullptr, 10));
+    assert (r != 0);
+
+    for (int i (3); i <= argc; ++i) // Including the terminating NULL.
+      argv[i - 2] = argv[i];
+
+    argc -= 2;
+    return r;
+  }
+
+  // Call the function the specified number of times and return the average
+  // per-call time in microseconds. The function is expected to return a
+  // value (for example, the result size) that is non-zero at least once. The
+  // values are accumulated to prevent the calls from being optimized away.
+  //
+  template <typename F>
+  double
+  measure (std::size_t n, F&& f)
+  {
+    using namespace std::chrono;
+
+    std::size_t r (0);
+    steady_clock::time_point s (steady_clock::now ());
+
+    for (std::size_t i (0); i != n; ++i)
+      r += f ();
+
+    steady_clock::time_point e (steady_clock::now ());
+
+    assert (r != 0);
+
+    return duration<double, std::micro> (e - s).count () / n;
+  }
+}
+
+#endif // TESTS_BENCHMARK_HXX
@@ -0,0 +1,141 @@
+// file      : tests/build-class/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <libbutl/target-triplet.hxx>
+
+#include <libbpkg/manifest.hxx>
+
+#include <mod/build-target-config.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace butl;
+using namespace brep;
+
+// Usage: argv[0]
+//
+// Match a number of build target configurations against a number of build
+// class expressions using the compiled class inheritance and verify that
+// the result is the same as for bpkg::build_class_expr::match().
+//
+int
+main ()
+{
+  build_target_configs cs;
+
+  // Note that gcc_14 is derived from gcc and gcc is derived from posix,
+  // while legacy is derived from default.
+  //
+  cs.class_inheritance_map = {{"gcc_14", "gcc"},
+                              {"gcc",    "posix"},
+                              {"clang",  "posix"},
+                              {"legacy", "default"}};
+
+  auto add = [&cs] (const char* n, const char* t, vector<string> cls)
+  {
+    build_target_config c;
+    c.name = n;
+    c.target = target_triplet (t);
+    c.classes = move (cls);
+    cs.push_back (move (c));
+  };
+
+  add ("linux-gcc_14",  "x86_64-linux-gnu",
+       {"default", "gcc_14", "linux"});
+
+  add ("linux-clang",   "x86_64-linux-gnu",
+       {"default", "clang", "linux"});
+
+  add ("linux-gcc-old", "x86_64-linux-gnu",
+       {"legacy", "gcc", "linux"});
+
+  add ("windows-msvc",  "x86_64-windows-msvc",
+       {"default", "msvc", "windows"});
+
+  add ("macos-clang",   "aarch64-apple-darwin",
+       {"clang", "macos", "hidden"});
+
+  add ("bare",          "x86_64-linux-gnu",
+       {});
+
+  build_class_index ci (cs);
+
+  const char* exprs[] = {
+    "all",
+    "none",
+    "default",
+    "+posix",
+    "gcc",
+    "+gcc_14",
+    "-gcc",
+    "+all -windows",
+    "+all -windows -legacy",
+    "+default &posix",
+    "+default &!gcc",
+    "+all &!hidden",
+    "+!posix",
+    "+!all",
+    "-all",
+    "+unknown",
+    "+all -unknown",
+    "+default +legacy -msvc",
+    "+all -( +gcc &linux )",
+    "+( +clang +msvc ) &( +default +hidden )",
+    "+default &( +!( +gcc_14 ) -windows )",
+    "+all &none",
+    "+linux &( +gcc -legacy ) +macos"};
+
+  for (const char* s: exprs)
+  {
+    bpkg::build_class_expr e (s, "" /* comment */);
+
+    for (const build_target_config& c: cs)
+    {
+      // Also test the fallback to walking the inheritance map for the
+      // configuration which is not a part of the indexed list.
+      //
+      build_target_config cc (c);
+
+      for (bool ir: {false, true})
+      {
+        bool r1 (ir);
+        e.match (c.classes, cs.class_inheritance_map, r1);
+
+        bool r2 (ir);
+        ci.match (c, e, r2);
+
+        bool r3 (ir);
+        ci.match (cc, e, r3);
+
+        if (r1 != r2 || r1 != r3)
+        {
+          cerr << "expression '" << s << "' for " << c.name
+               << " (initial " << ir << "): " << r1 << ' ' << r2 << ' '
+               << r3 << endl;
+
+          assert (false);
+        }
+      }
+    }
+  }
+
+  // Class membership.
+  //
+  const build_target_config& gcc_14 (cs[0]);
+
+  assert (ci.belongs (gcc_14, "gcc"));
+  assert (ci.belongs (gcc_14, "posix"));
+  assert (!ci.belongs (gcc_14, "clang"));
+  assert (ci.belongs (cs[2], "default"));
+  assert (!ci.belongs (cs[5], "default"));
+
+  assert (ci.derived ("gcc_14", "posix"));
+  assert (!ci.derived ("posix", "gcc_14"));
+  assert (ci.derived ("unknown", "unknown"));
+}
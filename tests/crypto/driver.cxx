@@ -0,0 +1,136 @@
+// file      : tests/crypto/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <chrono>
+#include <string>
+#include <cstddef>   // size_t
+#include <iostream>
+
+#include <libbutl/utility.hxx> // icasecmp()
+
+#include <mod/jwt.hxx>
+#include <mod/hmac.hxx>
+#include <mod/module-options.hxx>
+
+#include <tests/benchmark.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace butl;
+using namespace brep;
+
+// Usage: argv[0] [--benchmark <iterations>] <private-key>
+//
+int
+main (int argc, char* argv[])
+{
+  size_t n (benchmark_iterations (argc, argv));
+
+  assert (argc == 2);
+  path kf (argv[1]);
+
+  options::openssl_options ops;
+
+  // HMAC-SHA256 (RFC 4231 test case 2).
+  //
+  {
+    string m ("what do ya want for nothing?");
+    string k ("Jefe");
+    string h ("5bdcc146bf60754e6a042426089575c7"
+              "5a003f089d2739839dec58b964ec3843");
+
+    assert (compute_hmac (m.data (), m.size (), k) == h);
+    assert (compute_hmac (ops, m.data (), m.size (), k.c_str ()) == h);
+  }
+
+  // JWT.
+  //
+  jwt_private_key pk (kf);
+  {
+    string t (generate_jwt (pk, "12345", chrono::seconds (600)));
+
+    size_t p (t.find ('.'));
+    assert (p != string::npos);
+
+    p = t.find ('.', p + 1);
+    assert (p != string::npos && t.find ('.', p + 1) == string::npos);
+
+    // Since the RS256 signature is deterministic, both implementations
+    // should produce the same token, unless the time (in seconds) has
+    // changed in between. Thus, retry if the in-process implementation
+    // produces a different token after the openssl program is run.
+    //
+    for (size_t i (0);; ++i)
+    {
+      assert (i != 10);
+
+      string o (generate_jwt (ops, kf, "12345", chrono::seconds (600)));
+      string c (generate_jwt (pk, "12345", chrono::seconds (600)));
+
+      if (c == t)
+      {
+        assert (o == t);
+        break;
+      }
+
+      t = move (c);
+    }
+  }
+
+  if (n == 0)
+    return 0;
+
+  // Benchmark the verification of a typical (~20KB) webhook request body.
+  //
+  string body ("{\"action\":\"requested\",\"check_suite\":{");
+  while (body.size () < 20000)
+    body += "\"key\":\"some value\",\"number\":1234567890,";
+  body += "\"end\":true}}";
+
+  string secret ("0123456789abcdef0123456789abcdef");
+  string hmac (compute_hmac (body.data (), body.size (), secret));
+
+  cout << "hmac openssl:    "
+       << measure (n,
+                   [&] ()
+                   {
+                     return icasecmp (compute_hmac (ops,
+                                                    body.data (),
+                                                    body.size (),
+                                                    secret.c_str ()),
+                                      hmac) == 0;
+                   })
+       << " us/request" << endl
+       << "hmac in-process: "
+       << measure (n,
+                   [&] ()
+                   {
+                     return icasecmp (compute_hmac (body.data (),
+                                                    body.size (),
+                                                    secret),
+                                      hmac) == 0;
+                   })
+       << " us/request" << endl;
+
+  cout << "jwt openssl:     "
+       << measure (n,
+                   [&] ()
+                   {
+                     return generate_jwt (ops,
+                                          kf,
+                                          "12345",
+                                          chrono::seconds (600)).size ();
+                   })
+       << " us/token" << endl
+       << "jwt in-process:  "
+       << measure (n,
+                   [&] ()
+                   {
+                     return generate_jwt (pk,
+                                          "12345",
+                                          chrono::seconds (600)).size ();
+                   })
+       << " us/token" << endl;
+}
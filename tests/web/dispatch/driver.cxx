@@ -0,0 +1,163 @@
+// file      : tests/web/dispatch/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <new>       // bad_alloc
+#include <string>
+#include <cstddef>   // size_t
+#include <cstdlib>   // malloc(), free()
+#include <utility>   // move()
+
+#include <mod/inplace-handler.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace brep;
+
+// Count the heap allocations.
+//
+static size_t allocations (0);
+
+void*
+operator new (size_t n)
+{
+  ++allocations;
+
+  if (void* r = malloc (n != 0 ? n : 1))
+    return r;
+
+  throw bad_alloc ();
+}
+
+void
+operator delete (void* p) noexcept
+{
+  free (p);
+}
+
+void
+operator delete (void* p, size_t) noexcept
+{
+  free (p);
+}
+
+struct handler
+{
+  virtual
+  ~handler () = default;
+
+  virtual int
+  handle () = 0;
+};
+
+static size_t live (0);
+
+struct foo: handler
+{
+  int v;
+
+  explicit
+  foo (int x): v (x) {++live;}
+
+  foo (const foo& f): v (f.v) {++live;}
+
+  ~foo () override {--live;}
+
+  int
+  handle () override {return v;}
+};
+
+struct bar: handler
+{
+  string s;
+  double d;
+
+  bar (string x, double y): s (move (x)), d (y) {++live;}
+
+  ~bar () override {--live;}
+
+  int
+  handle () override {return static_cast<int> (s.size ());}
+};
+
+int
+main ()
+{
+  // Construction in the holder's storage, without heap allocations.
+  //
+  {
+    inplace_handler<handler, 128> h;
+
+    assert (!h && h.get () == nullptr);
+
+    size_t a (allocations);
+    foo& f (h.emplace<foo> (1));
+    assert (allocations == a);
+
+    assert (h && live == 1);
+    assert (h.get () == &f && &*h == &f);
+    assert (h->handle () == 1);
+
+    const unsigned char* b (reinterpret_cast<const unsigned char*> (&h));
+    const unsigned char* p (reinterpret_cast<const unsigned char*> (&f));
+    assert (p >= b && p + sizeof (foo) <= b + sizeof (h));
+
+    // Copy construction from an exemplar.
+    //
+    foo e (2);
+    assert (live == 2);
+
+    h.emplace<foo> (e);
+    assert (live == 2 && h->handle () == 2);
+  }
+  assert (live == 0);
+
+  // Replacing the handler with a handler of a different type destroys the
+  // previous one and forwards the arguments.
+  //
+  {
+    inplace_handler<handler, 128> h;
+
+    h.emplace<foo> (1);
+    assert (live == 1);
+
+    bar& b (h.emplace<bar> ("abc", 1.5));
+    assert (live == 1);
+    assert (b.s == "abc" && b.d == 1.5 && h->handle () == 3);
+
+    h.reset ();
+    assert (!h && live == 0);
+
+    h.reset (); // Noop.
+    assert (!h && live == 0);
+
+    h.emplace<foo> (4);
+    assert (live == 1);
+  }
+  assert (live == 0);
+
+  // The handler constructor throws.
+  //
+  {
+    struct baz: handler
+    {
+      baz () {throw 1;}
+
+      int
+      handle () override {return 0;}
+    };
+
+    inplace_handler<handler, 128> h;
+    h.emplace<foo> (1);
+
+    try
+    {
+      h.emplace<baz> ();
+      assert (false);
+    }
+    catch (int) {}
+
+    assert (!h && live == 0);
+  }
+}
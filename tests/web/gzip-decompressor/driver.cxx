@@ -0,0 +1,132 @@
+// file      : tests/web/gzip-decompressor/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <zlib.h>
+
+#include <string>
+#include <cstddef>   // size_t
+#include <cstring>   // memcpy()
+#include <algorithm> // min()
+
+#include <web/server/module.hxx> // invalid_request
+#include <web/server/gzip-decompressor.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace web;
+
+static string
+compress (const string& s)
+{
+  z_stream z {};
+  int r (deflateInit2 (&z,
+                       Z_DEFAULT_COMPRESSION,
+                       Z_DEFLATED,
+                       16 + MAX_WBITS,
+                       8,
+                       Z_DEFAULT_STRATEGY));
+  assert (r == Z_OK);
+
+  string c (deflateBound (&z, s.size ()), '\0');
+
+  z.next_in = reinterpret_cast<Bytef*> (const_cast<char*> (s.data ()));
+  z.avail_in = static_cast<uInt> (s.size ());
+  z.next_out = reinterpret_cast<Bytef*> (&c[0]);
+  z.avail_out = static_cast<uInt> (c.size ());
+
+  r = deflate (&z, Z_FINISH);
+  assert (r == Z_STREAM_END);
+
+  c.resize (c.size () - z.avail_out);
+  deflateEnd (&z);
+  return c;
+}
+
+// Decompress the content, feeding it to the decompressor in chunks of the
+// specified size and reading it into the output buffer of the specified
+// size.
+//
+static string
+decompress (const string& c, size_t chunk, size_t bufsize)
+{
+  gzip_decompressor d;
+
+  size_t i (0);
+  auto read_block = [&c, chunk, &i] (char* p, size_t n)
+  {
+    n = min (min (n, chunk), c.size () - i);
+    memcpy (p, c.data () + i, n);
+    i += n;
+    return n;
+  };
+
+  string r;
+  string b (bufsize, '\0');
+
+  for (size_t n; (n = d.read (&b[0], b.size (), read_block)) != 0; )
+  {
+    assert (n <= bufsize);
+    r.append (b, 0, n);
+  }
+
+  assert (i == c.size ());
+  return r;
+}
+
+static bool
+invalid (const string& c)
+{
+  try
+  {
+    decompress (c, c.size (), 1024);
+    return false;
+  }
+  catch (const invalid_request& e)
+  {
+    assert (e.status == 400);
+    return true;
+  }
+}
+
+int
+main ()
+{
+  string s;
+  for (size_t i (0); s.size () < 512 * 1024; ++i)
+    s += "line " + to_string (i % 100) + " of the request content\n";
+
+  string c (compress (s));
+
+  // Output buffer smaller and bigger than the content.
+  //
+  assert (decompress (c, c.size (), 1) == s);
+  assert (decompress (c, c.size (), 100) == s);
+  assert (decompress (c, c.size (), 4096) == s);
+  assert (decompress (c, c.size (), s.size () * 2) == s);
+
+  // Input chunks smaller than the output buffer.
+  //
+  assert (decompress (c, 1, 4096) == s);
+  assert (decompress (c, 7, 100) == s);
+
+  // Multiple members.
+  //
+  {
+    string c2 (c + compress ("abc"));
+    assert (decompress (c2, c2.size (), 100) == s + "abc");
+    assert (decompress (c2, 3, 100) == s + "abc");
+  }
+
+  // Empty content.
+  //
+  assert (decompress ("", 1, 100) == "");
+  assert (decompress (compress (""), 1, 100) == "");
+
+  // Truncated and invalid content.
+  //
+  assert (invalid (c.substr (0, c.size () - 1)));
+  assert (invalid (c.substr (0, c.size () / 2)));
+  assert (invalid ("abc"));
+}
@@ -0,0 +1,164 @@
+// file      : tests/web/url-encoding/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <string>
+#include <vector>
+#include <cstddef>   // size_t
+#include <iostream>
+#include <stdexcept> // invalid_argument
+
+#include <web/server/mime-url-encoding.hxx>
+
+#include <tests/benchmark.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace web;
+using namespace brep;
+
+// Straightforward character-by-character encoder used as a reference.
+//
+static string
+reference_encode (const string& v, bool query)
+{
+  static const char digits[] = "0123456789ABCDEF";
+
+  string r;
+  for (char c: v)
+  {
+    if ((c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') ||
+        c == '-' || c == '.' || c == '_' || c == '~')
+      r += c;
+    else if (query && c == ' ')
+      r += '+';
+    else
+    {
+      unsigned char u (c);
+      r += '%';
+      r += digits[u >> 4];
+      r += digits[u & 0x0F];
+    }
+  }
+  return r;
+}
+
+static string
+decode (const string& v, bool query = true, bool trim = false)
+{
+  return mime_url_decode (v.c_str (), v.c_str () + v.size (), trim, query);
+}
+
+static bool
+invalid (const string& v)
+{
+  try
+  {
+    decode (v);
+    return false;
+  }
+  catch (const invalid_argument&)
+  {
+    return true;
+  }
+}
+
+// Usage: argv[0] [--benchmark <iterations>]
+//
+int
+main (int argc, char* argv[])
+{
+  size_t n (benchmark_iterations (argc, argv));
+
+  // Encoding.
+  //
+  assert (mime_url_encode ("") == "");
+  assert (mime_url_encode ("libfoo-1.2.3_a~b") == "libfoo-1.2.3_a~b");
+  assert (mime_url_encode ("a b+c", true) == "a+b%2Bc");
+  assert (mime_url_encode ("a b+c", false) == "a%20b%2Bc");
+  assert (mime_url_encode ("x/y?z=1&w") == "x%2Fy%3Fz%3D1%26w");
+  assert (mime_url_encode ("\xD0\x90") == "%D0%90");
+
+  {
+    string r ("?q=");
+    mime_url_encode ("a b", 3, r);
+    assert (r == "?q=a+b");
+  }
+
+  // Decoding.
+  //
+  assert (decode ("") == "");
+  assert (decode ("a+b%2Bc") == "a b+c");
+  assert (decode ("a+b%2bc", false) == "a+b+c");
+  assert (decode ("%D0%90") == "\xD0\x90");
+  assert (decode ("  a+b  ", true, true) == "a b");
+  assert (decode ("   ", true, true) == "");
+  assert (invalid ("%"));
+  assert (invalid ("%2"));
+  assert (invalid ("a%2x"));
+  assert (invalid ("%g0"));
+
+  // Round trip for all the byte values.
+  //
+  {
+    string v;
+    for (size_t i (0); i != 256; ++i)
+      v += static_cast<char> (i);
+
+    for (bool q: {true, false})
+    {
+      string e (mime_url_encode (v, q));
+      assert (e == reference_encode (v, q));
+      assert (decode (e, q) == v);
+    }
+  }
+
+  if (n == 0)
+    return 0;
+
+  // Benchmark encoding of the typical page link components.
+  //
+  vector<string> vs ({"libbutl",
+                      "libstudxml",
+                      "build2-toolchain",
+                      "1.2.3-a.1+2",
+                      "x86_64-linux-gnu",
+                      "linux_debian_12-gcc_13",
+                      "default",
+                      "some search query"});
+
+  auto bench = [&vs, n] (auto&& f)
+  {
+    return measure (n,
+                    [&vs, &f] ()
+                    {
+                      size_t r (0);
+                      for (const string& v: vs)
+                        r += f (v);
+                      return r;
+                    }) / vs.size () * 1000;
+  };
+
+  cout << "reference: "
+       << bench ([] (const string& v)
+                 {
+                   return reference_encode (v, true).size ();
+                 })
+       << " ns/value" << endl
+       << "encode:    "
+       << bench ([] (const string& v) {return mime_url_encode (v).size ();})
+       << " ns/value" << endl;
+
+  string b;
+  cout << "append:    "
+       << bench ([&b] (const string& v)
+                 {
+                   b.clear ();
+                   mime_url_encode (v.c_str (), v.size (), b);
+                   return b.size ();
+                 })
+       << " ns/value" << endl;
+}
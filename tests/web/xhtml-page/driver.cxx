@@ -0,0 +1,230 @@
+// file      : tests/web/xhtml-page/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <string>
+#include <vector>
+#include <memory>    // shared_ptr, make_shared()
+#include <sstream>
+#include <cstddef>   // size_t
+#include <iostream>
+
+#include <libstudxml/serializer.hxx>
+
+#include <web/xhtml/fragment.hxx>
+#include <web/xhtml/serialization.hxx>
+
+#include <web/server/mime-url-encoding.hxx>
+
+#include <tests/benchmark.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace xml;
+using namespace web;
+using namespace web::xhtml;
+using namespace brep;
+
+// Mimic the builds page row data.
+//
+struct build_row
+{
+  string package_name;
+  string package_version;
+  string target;
+  string target_config;
+  string package_config;
+  string toolchain_name;
+  string toolchain_version;
+  string timestamp;
+};
+
+// Pre-rendered XHTML, as produced for the package descriptions.
+//
+static const string description (
+  "<p>A <em>test</em> package with <a href=\"https://example.org\">home "
+  "page</a>.</p><ul><li>item 1</li><li>item 2</li></ul>");
+
+// Compose the log URL with the temporary strings, as it used to be done.
+//
+static string
+log_url_temporaries (const build_row& b)
+{
+  return "https://example.org/@" +
+    mime_url_encode (b.package_name, false) + '/'   +
+    b.package_version + "/log/"                      +
+    mime_url_encode (b.target, false) + '/'          +
+    mime_url_encode (b.target_config, false) + '/'   +
+    mime_url_encode (b.package_config, false) + '/'  +
+    mime_url_encode (b.toolchain_name, false) + '/'  +
+    b.toolchain_version;
+}
+
+// Compose the log URL in a single buffer.
+//
+static string
+log_url_buffer (const build_row& b)
+{
+  string url;
+  url.reserve (256);
+
+  auto add = [&url] (const string& v)
+  {
+    mime_url_encode (v.c_str (), v.size (), url, false /* query */);
+    url += '/';
+  };
+
+  url += "https://example.org/@";
+  add (b.package_name);
+  url += b.package_version;
+  url += "/log/";
+  add (b.target);
+  add (b.target_config);
+  add (b.package_config);
+  add (b.toolchain_name);
+  url += b.toolchain_version;
+  return url;
+}
+
+static void
+value (serializer& s, const char* n, const string& v)
+{
+  s << TR(CLASS=n)
+    <<   TH << n << ~TH
+    <<   TD << SPAN(CLASS="value") << v << ~SPAN << ~TD
+    << ~TR;
+}
+
+// The description fragment rendering mode: re-parse it for each row, replay
+// the fragment parsed once, or splice the raw fragment serialized once.
+//
+enum class mode {reparse, parsed, raw};
+
+// Render the builds page, composing URLs with temporaries for each row in
+// the reparse mode and in a single buffer otherwise. Return the page.
+//
+// Note that we disable indentation for the page to be the same in all the
+// modes (the raw fragment doesn't affect the serializer indentation state).
+//
+static string
+render (const vector<build_row>& rows, mode m)
+{
+  ostringstream os;
+  serializer s (os, "builds", 0 /* indentation */);
+
+  shared_ptr<const fragment> cf;
+
+  if (m != mode::reparse)
+  {
+    cf = make_shared<fragment> (description, "description");
+
+    if (m == mode::raw)
+      cf = make_shared<fragment> (fragment::raw (cf->markup ()));
+  }
+
+  s << HTML
+    <<   BODY
+    <<     DIV(ID="content");
+
+  for (const build_row& b: rows)
+  {
+    s << TABLE(CLASS="proplist build")
+      <<   TBODY;
+
+    value (s, "name", b.package_name);
+    value (s, "version", b.package_version);
+    value (s, "toolchain", b.toolchain_name + '-' + b.toolchain_version);
+    value (s, "target", b.target);
+    value (s, "tgt config", b.target_config);
+    value (s, "pkg config", b.package_config);
+    value (s, "timestamp", b.timestamp);
+
+    s << TR(CLASS="result")
+      <<   TH << "result" << ~TH
+      <<   TD
+      <<     SPAN(CLASS="value")
+      <<       A
+      <<         HREF
+      <<           (m == mode::reparse
+                    ? log_url_temporaries (b)
+                    : log_url_buffer (b))
+      <<         ~HREF
+      <<         "log"
+      <<       ~A
+      <<     ~SPAN
+      <<   ~TD
+      << ~TR
+      << TR(CLASS="description")
+      <<   TD
+      <<     DIV(CLASS="markdown");
+
+    if (m == mode::reparse)
+      s << fragment (description, "description");
+    else
+      (*cf) (s, os);
+
+    s <<     ~DIV
+      <<   ~TD
+      << ~TR;
+
+    s <<   ~TBODY
+      << ~TABLE;
+  }
+
+  s <<     ~DIV
+    <<   ~BODY
+    << ~HTML;
+
+  return os.str ();
+}
+
+// Usage: argv[0] [--benchmark <pages>]
+//
+// Render a 1000-row builds page and, if requested, benchmark its rendering.
+//
+int
+main (int argc, char* argv[])
+{
+  size_t n (benchmark_iterations (argc, argv));
+
+  vector<build_row> rows;
+  for (size_t i (0); i != 1000; ++i)
+    rows.push_back (build_row {"libfoo-" + to_string (i % 50),
+                               "1.2." + to_string (i % 7) + "+1",
+                               "x86_64-linux-gnu",
+                               "linux_debian_12-gcc_13",
+                               "default",
+                               "public",
+                               "0.17.0",
+                               "2024-01-01 00:00:00 UTC"});
+
+  // Both variants must produce the same page.
+  //
+  for (const build_row& r: rows)
+    assert (log_url_temporaries (r) == log_url_buffer (r));
+
+  string p (render (rows, mode::raw));
+  assert (p == render (rows, mode::parsed));
+  assert (p == render (rows, mode::reparse));
+
+  assert (p.find ("<em>test</em>") != string::npos);
+  assert (p.find ("https://example.org/@libfoo-1/1.2.1+1/log/"
+                  "x86_64-linux-gnu/linux_debian_12-gcc_13/default/public/"
+                  "0.17.0") != string::npos);
+
+  if (n == 0)
+    return 0;
+
+  auto page = [&rows] (mode m)
+  {
+    return [&rows, m] () {return render (rows, m).size ();};
+  };
+
+  cout << "reparse: " << measure (n, page (mode::reparse)) << " us/page"
+       << endl
+       << "parsed:  " << measure (n, page (mode::parsed)) << " us/page"
+       << endl
+       << "raw:     " << measure (n, page (mode::raw)) << " us/page"
+       << endl;
+}
@@ -0,0 +1,126 @@
+// file      : tests/web/zstd-decompressor/driver.cxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#include <zstd.h>
+
+#include <string>
+#include <cstddef>   // size_t
+#include <cstring>   // memcpy()
+#include <algorithm> // min()
+
+#include <web/server/module.hxx> // invalid_request
+#include <web/server/zstd-decompressor.hxx>
+
+#undef NDEBUG
+#include <cassert>
+
+using namespace std;
+using namespace web;
+
+static string
+compress (const string& s)
+{
+  string r (ZSTD_compressBound (s.size ()), '\0');
+
+  size_t n (ZSTD_compress (&r[0], r.size (), s.data (), s.size (), 3));
+  assert (!ZSTD_isError (n));
+
+  r.resize (n);
+  return r;
+}
+
+// Decompress the content, feeding it to the decompressor in chunks of the
+// specified size and reading it into the output buffer of the specified
+// size.
+//
+static string
+decompress (const string& c, size_t chunk, size_t bufsize)
+{
+  zstd_decompressor d;
+
+  size_t i (0);
+  auto read_block = [&c, chunk, &i] (char* p, size_t n)
+  {
+    n = min (min (n, chunk), c.size () - i);
+    memcpy (p, c.data () + i, n);
+    i += n;
+    return n;
+  };
+
+  string r;
+  string b (bufsize, '\0');
+
+  for (size_t n; (n = d.read (&b[0], b.size (), read_block)) != 0; )
+  {
+    assert (n <= bufsize);
+    r.append (b, 0, n);
+  }
+
+  assert (i == c.size ());
+  return r;
+}
+
+static bool
+invalid (const string& c)
+{
+  try
+  {
+    decompress (c, c.size (), 1024);
+    return false;
+  }
+  catch (const invalid_request& e)
+  {
+    assert (e.status == 400);
+    return true;
+  }
+}
+
+int
+main ()
+{
+  // Content that is decompressed into multiple full blocks (128KB each).
+  // Note that the last block being full makes sure that the decompressor
+  // consumes all the input while still holding most of the block
+  // decompressed data.
+  //
+  string s;
+  for (size_t i (0); s.size () < 512 * 1024; ++i)
+    s += "line " + to_string (i % 100) + " of the request content\n";
+
+  s.resize (512 * 1024);
+
+  string c (compress (s));
+
+  // Output buffer smaller than the zstd block.
+  //
+  assert (decompress (c, c.size (), 1) == s);
+  assert (decompress (c, c.size (), 100) == s);
+  assert (decompress (c, c.size (), 4096) == s);
+
+  // Output buffer bigger than the content.
+  //
+  assert (decompress (c, c.size (), s.size () * 2) == s);
+
+  // Input chunks smaller than the output buffer.
+  //
+  assert (decompress (c, 1, 4096) == s);
+  assert (decompress (c, 7, 100) == s);
+
+  // Multiple frames.
+  //
+  {
+    string c2 (c + compress ("abc"));
+    assert (decompress (c2, c2.size (), 100) == s + "abc");
+  }
+
+  // Empty content.
+  //
+  assert (decompress ("", 1, 100) == "");
+  assert (decompress (compress (""), 1, 100) == "");
+
+  // Truncated and invalid content.
+  //
+  assert (invalid (c.substr (0, c.size () - 1)));
+  assert (invalid (c.substr (0, c.size () / 2)));
+  assert (invalid ("abc"));
+}
@@ -6,7 +6,8 @@
 #include <apr.h>         // APR_SIZE_MAX
 #include <apr_errno.h>   // apr_status_t, APR_SUCCESS, APR_E*, apr_strerror()
 #include <apr_tables.h>  // apr_table_*, apr_table_*(), apr_array_header_t
-#include <apr_strings.h> // apr_pstrdup()
+#include <apr_file_io.h> // apr_file_*(), apr_temp_dir_get()
+#include <apr_strings.h> // apr_pstrdup(), apr_pstrcat()
 #include <apr_buckets.h> // apr_bucket*, apr_bucket_*(), apr_brigade_*(),
                          // APR_BRIGADE_*()
 
@@ -19,6 +20,7 @@
 #include <apreq2/apreq_parser.h> // apreq_parser_t, apreq_parser_make()
 
 #include <ctime>     // strftime(), time_t
+#include <cstdlib>   // strtod()
 #include <vector>
 #include <chrono>
 #include <memory>    // unique_ptr
@@ -34,7 +36,7 @@
 #include <streambuf>
 #include <algorithm> // min()
 
-#include <libbutl/utility.hxx>   // icasecmp()
+#include <libbutl/utility.hxx>   // icasecmp(), trim()
 #include <libbutl/optional.hxx>
 #include <libbutl/timestamp.hxx>
 
@@ -57,6 +59,12 @@ namespace web
     // Extend the Apache stream with checking for the read limit and caching
     // the content if requested. Replay the cached content after rewind.
     //
+    // Keep the first memory limit bytes of the cached content in memory and
+    // spool the rest to a temporary file, so that large requests can be
+    // replayed without holding the whole content in memory. The file is
+    // allocated in the request pool and is removed at the end of the request
+    // processing.
+    //
     class istreambuf_cache: public istreambuf
     {
       enum class mode
@@ -68,13 +76,17 @@ namespace web
 
     public:
       istreambuf_cache (size_t read_limit, size_t cache_limit,
+                        size_t memory_limit,
                         request_rec* r,
                         stream_state& s,
+                        content_coding decompress =
+                          content_coding::identity,
                         size_t bufsize = 1024,
                         size_t putback = 1)
-          : istreambuf (r, s, bufsize, putback),
+          : istreambuf (r, s, bufsize, putback, decompress),
             read_limit_ (read_limit),
-            cache_limit_ (cache_limit)
+            cache_limit_ (cache_limit),
+            memory_limit_ (memory_limit != 0 ? memory_limit : 1024 * 1024)
       {
       }
 
@@ -96,7 +108,7 @@ namespace web
       }
 
       void
-      limits (size_t read_limit, size_t cache_limit)
+      limits (size_t read_limit, size_t cache_limit, size_t memory_limit)
       {
         if (read_limit > 0)
           read_limit_ = read_limit;
@@ -112,20 +124,41 @@ namespace web
 
           cache_limit_ = cache_limit;
         }
+
+        // Note that the cached chunks are kept in memory or spooled
+        // independently and so the memory limit can be changed at any time.
+        //
+        if (memory_limit > 0)
+          memory_limit_ = memory_limit;
       }
 
-      size_t read_limit  () const noexcept {return read_limit_;}
-      size_t cache_limit () const noexcept {return cache_limit_;}
+      size_t read_limit   () const noexcept {return read_limit_;}
+      size_t cache_limit  () const noexcept {return cache_limit_;}
+      size_t memory_limit () const noexcept {return memory_limit_;}
 
     private:
+      struct chunk;
+
       virtual int_type
       underflow ();
 
+      // Save the get area (including the putback area) into the spool file,
+      // creating it if required, and return the data position in the file.
+      //
+      apr_off_t
+      spool ();
+
+      // Read the spooled chunk data into the replay buffer.
+      //
+      void
+      unspool (const chunk&);
+
     private:
       // Limits
       //
       size_t read_limit_;
       size_t cache_limit_;
+      size_t memory_limit_;
 
       // State
       //
@@ -135,12 +168,25 @@ namespace web
 
       // Cache
       //
+      // If the chunk is spooled, then the data is empty and the position and
+      // size refer to the data in the spool file.
+      //
       struct chunk
       {
         vector<char> data;
         size_t offset;
 
-        chunk (vector<char>&& d, size_t o): data (move (d)), offset (o) {}
+        apr_off_t position = 0;
+        size_t size;
+
+        chunk (vector<char>&& d, size_t o)
+            : data (move (d)), offset (o), size (data.size ()) {}
+
+        chunk (apr_off_t p, size_t s, size_t o)
+            : offset (o), position (p), size (s) {}
+
+        bool
+        spooled () const {return data.empty () && size != 0;}
 
         // Make the type move constructible-only to avoid copying of chunks on
         // vector growth.
@@ -151,6 +197,12 @@ namespace web
       vector<chunk> cache_;
       size_t cache_size_ = 0;
       size_t replay_pos_ = 0;
+
+      // Spool file and the buffer for replaying the spooled chunks.
+      //
+      apr_file_t* spool_ = nullptr;
+      apr_off_t spool_size_ = 0;
+      vector<char> replay_buf_;
     };
 
     istreambuf_cache::int_type istreambuf_cache::
@@ -164,8 +216,17 @@ namespace web
         if (replay_pos_ < cache_.size ())
         {
           chunk& ch (cache_[replay_pos_++]);
-          char*  p  (ch.data.data ());
-          setg (p, p + ch.offset, p + ch.data.size ());
+          char* p;
+
+          if (ch.spooled ())
+          {
+            unspool (ch);
+            p = replay_buf_.data ();
+          }
+          else
+            p = ch.data.data ();
+
+          setg (p, p + ch.offset, p + ch.size);
           return traits_type::to_int_type (*gptr ());
         }
 
@@ -184,13 +245,19 @@ namespace web
         size_t pb (0);
 
         // Restore putback area if there is any cached data. Thanks to
-        // istreambuf, it's all in a single chunk.
+        // istreambuf, it's all in a single chunk. Note that if this chunk is
+        // spooled, then it is the last one replayed and so its data is in
+        // the replay buffer.
         //
         if (!cache_.empty ())
         {
           chunk& ch (cache_.back ());
-          pb = min (putback_, ch.data.size ());
-          memcpy (p - pb, ch.data.data () + ch.data.size () - pb, pb);
+          const char* d (ch.spooled ()
+                         ? replay_buf_.data ()
+                         : ch.data.data ());
+
+          pb = min (putback_, ch.size);
+          memcpy (p - pb, d + ch.size - pb, pb);
         }
 
         setg (p - pb, p, p);
@@ -232,10 +299,17 @@ namespace web
         //
         if (cache_size_ < cache_limit_)
         {
-          chunk ch (vector<char> (eback (), egptr ()),
-                    static_cast<size_t> (gptr () - eback ()));
+          size_t o (gptr () - eback ());
+
+          if (cache_size_ < memory_limit_)
+            cache_.emplace_back (vector<char> (eback (), egptr ()), o);
+          else
+          {
+            size_t n (egptr () - eback ());
+            apr_off_t p (spool ());
+            cache_.emplace_back (p, n, o);
+          }
 
-          cache_.emplace_back (move (ch));
           cache_size_ += rb;
         }
         else
@@ -245,6 +319,74 @@ namespace web
       return r;
     }
 
+    apr_off_t istreambuf_cache::
+    spool ()
+    {
+      apr_status_t r;
+
+      if (spool_ == nullptr)
+      {
+        const char* d;
+        if ((r = apr_temp_dir_get (&d, rec_->pool)) != APR_SUCCESS)
+          throw_internal_error (r, "apr_temp_dir_get");
+
+        // Note that apr_file_mktemp() modifies the template in place.
+        //
+        char* t (apr_pstrcat (rec_->pool, d, "/brep-XXXXXX", nullptr));
+
+        // Note that the file is removed when closed, which happens on the
+        // request pool cleanup.
+        //
+        if ((r = apr_file_mktemp (&spool_,
+                                  t,
+                                  APR_FOPEN_CREATE    |
+                                  APR_FOPEN_READ      |
+                                  APR_FOPEN_WRITE     |
+                                  APR_FOPEN_EXCL      |
+                                  APR_FOPEN_BINARY    |
+                                  APR_FOPEN_BUFFERED  |
+                                  APR_FOPEN_DELONCLOSE,
+                                  rec_->pool)) != APR_SUCCESS)
+          throw_internal_error (r, "apr_file_mktemp");
+      }
+
+      // Note that we may have read from the file (during replay) since the
+      // last write.
+      //
+      apr_off_t p (spool_size_);
+      if ((r = apr_file_seek (spool_, APR_SET, &p)) != APR_SUCCESS)
+        throw_internal_error (r, "apr_file_seek");
+
+      size_t n (egptr () - eback ());
+      if ((r = apr_file_write_full (spool_, eback (), n, nullptr)) !=
+          APR_SUCCESS)
+        throw_internal_error (r, "apr_file_write_full");
+
+      p = spool_size_;
+      spool_size_ += n;
+      return p;
+    }
+
+    void istreambuf_cache::
+    unspool (const chunk& ch)
+    {
+      assert (spool_ != nullptr);
+
+      apr_off_t p (ch.position);
+
+      apr_status_t r;
+      if ((r = apr_file_seek (spool_, APR_SET, &p)) != APR_SUCCESS)
+        throw_internal_error (r, "apr_file_seek");
+
+      replay_buf_.resize (ch.size);
+
+      if ((r = apr_file_read_full (spool_,
+                                   replay_buf_.data (),
+                                   ch.size,
+                                   nullptr)) != APR_SUCCESS)
+        throw_internal_error (r, "apr_file_read_full");
+    }
+
     // Stream interface for reading from the Apache's bucket brigade. Put back
     // is not supported.
     //
@@ -297,6 +439,22 @@ namespace web
         setg (nullptr, nullptr, nullptr);
       }
 
+      // Pass the unread data to the function bucket by bucket, without
+      // copying.
+      //
+      void
+      read (const request::upload_reader& f)
+      {
+        for (;;)
+        {
+          if (gptr () == egptr () && underflow () == traits_type::eof ())
+            break;
+
+          f (gptr (), egptr () - gptr ());
+          setg (eback (), egptr (), egptr ());
+        }
+      }
+
     private:
       virtual int_type
       underflow ()
@@ -389,6 +547,12 @@ namespace web
         buf_.rewind ();
         clear ();       // Clears *bit flags (in particular eofbit).
       }
+
+      void
+      read (const request::upload_reader& f)
+      {
+        buf_.read (f);
+      }
     };
 
     // request
@@ -465,6 +629,7 @@ namespace web
       rec_->status = HTTP_OK;
 
       ap_set_content_type (rec_, nullptr); // Unset the output content type.
+      apr_table_unset (rec_->headers_out, "Content-Encoding");
 
       // We don't need to rewind the input stream (which well may fail if
       // unbuffered) if the form data is already read.
@@ -490,15 +655,34 @@ namespace web
     }
 
     istream& request::
-    content (size_t limit, size_t buffer)
+    content (size_t limit, size_t buffer, size_t memory)
     {
       // Create the input stream/streambuf if not present, otherwise adjust the
       // limits.
       //
       if (in_ == nullptr)
       {
+        // Decompress the zstd- or gzip-compressed content. Note that the
+        // read limit applies to the decompressed content.
+        //
+        content_coding decompress (content_coding::identity);
+
+        if (const char* ce = apr_table_get (rec_->headers_in,
+                                            "Content-Encoding"))
+        {
+          if (icasecmp (ce, "zstd") == 0)
+            decompress = content_coding::zstd;
+          else if (icasecmp (ce, "gzip") == 0 || icasecmp (ce, "x-gzip") == 0)
+            decompress = content_coding::gzip;
+        }
+
         unique_ptr<istreambuf_cache> in_buf (
-          new istreambuf_cache (limit, buffer, rec_, *this));
+          new istreambuf_cache (limit,
+                                buffer,
+                                memory,
+                                rec_,
+                                *this,
+                                decompress));
 
         in_.reset (new istream (in_buf.get ()));
         in_buf_ = move (in_buf);
@@ -507,7 +691,7 @@ namespace web
       else
       {
         assert (in_buf_ != nullptr);
-        in_buf_->limits (limit, buffer);
+        in_buf_->limits (limit, buffer, memory);
       }
 
       return *in_;
@@ -544,12 +728,12 @@ namespace web
           if (!url_only && form_data (limit))
           {
             // After the form data is parsed we can clean it up for the
-            // application/x-www-form-urlencoded encoding but not for the
-            // multipart/form-data (see parse_multipart_parameters() for
-            // details).
+            // application/x-www-form-urlencoded encoding. The
+            // multipart/form-data is already parsed by form_data() (see
+            // parse_multipart_form_data() for details).
             //
             if (form_multipart_)
-              parse_multipart_parameters (*form_data_);
+              parse_multipart_parameters (form_params_);
             else
             {
               // Make the character vector a NULL-terminated string.
@@ -590,8 +774,14 @@ namespace web
           {
             form_multipart_ = icasecmp ("multipart/form-data", ct, 19) == 0;
 
-            if (form_multipart_ ||
-                icasecmp ("application/x-www-form-urlencoded", ct, 33) == 0)
+            // Parse the multipart form data while reading it rather than
+            // caching it, so that the potentially large uploads don't end up
+            // in memory (see parse_multipart_form_data() for details).
+            //
+            if (form_multipart_)
+              form_params_ = parse_multipart_form_data (content (limit));
+            else if (icasecmp ("application/x-www-form-urlencoded", ct, 33) ==
+                     0)
               *form_data_ = vector<char> (
                 istreambuf_iterator<char> (content (limit)),
                 istreambuf_iterator<char> ());
@@ -599,7 +789,9 @@ namespace web
         }
       }
 
-      return !form_data_->empty ();
+      return form_multipart_
+        ? form_params_ != nullptr
+        : !form_data_->empty ();
     }
 
     void request::
@@ -635,11 +827,9 @@ namespace web
       }
     }
 
-    void request::
-    parse_multipart_parameters (const vector<char>& body)
+    apr_table_t* request::
+    parse_multipart_form_data (istream& is)
     {
-      assert (parameters_ != nullptr && uploads_ == nullptr);
-
       auto throw_bad_request = [] (apr_status_t s,
                                    status_code sc = HTTP_BAD_REQUEST)
       {
@@ -647,21 +837,12 @@ namespace web
         throw invalid_request (sc, apr_strerror (s, buf, sizeof (buf)));
       };
 
-      // Create the file upload stream list, filling it with NULLs for the
-      // parameters parsed from the URL query part.
-      //
-      uploads_.reset (
-        new vector<unique_ptr<istream_buckets>> (parameters_->size ()));
-
       // All the required objects (parser, input/output buckets, etc.) will be
       // allocated in the request memory pool and so will have the HTTP
       // request duration lifetime.
       //
       apr_pool_t* pool (rec_->pool);
 
-      // Create the input bucket brigade containing a single bucket that
-      // references the form data.
-      //
       apr_bucket_alloc_t* ba (apr_bucket_alloc_create (pool));
       if (ba == nullptr)
         throw_internal_error (APR_ENOMEM, "apr_bucket_alloc_create");
@@ -670,36 +851,26 @@ namespace web
       if (bb == nullptr)
         throw_internal_error (APR_ENOMEM, "apr_brigade_create");
 
-      apr_bucket* b (
-        apr_bucket_immortal_create (body.data (), body.size (), ba));
-
-      if (b == nullptr)
-        throw_internal_error (APR_ENOMEM, "apr_bucket_immortal_create");
-
-      APR_BRIGADE_INSERT_TAIL (bb, b);
-
-      if ((b = apr_bucket_eos_create (ba)) == nullptr)
-        throw_internal_error (APR_ENOMEM, "apr_bucket_eos_create");
-
-      APR_BRIGADE_INSERT_TAIL (bb, b);
+      const char* td;
+      apr_status_t r (apr_temp_dir_get (&td, pool));
+      if (r != APR_SUCCESS)
+        throw_internal_error (r, "apr_temp_dir_get");
 
-      // Make sure that the parser will not swap the parsed data to disk
-      // passing the maximum possible value for the brigade limit. This way
-      // the resulting buckets will reference the form data directly, making
-      // no copies. This why we should not reset the form data cache after
-      // the parsing.
-      //
-      // Note that in future we may possibly setup the parser to read from the
-      // Apache internals directly and enable swapping the data to disk to
-      // minimize memory consumption.
+      // Let the parser spool the upload data exceeding the cached request
+      // content memory limit to a temporary file (see istreambuf_cache for
+      // details). The resulting upload buckets reference either the parser's
+      // copies of the data in memory or the file, which is removed on the
+      // request pool cleanup.
       //
+      assert (in_buf_ != nullptr);
+
       apreq_parser_t* parser (
         apreq_parser_make (pool,
                            ba,
                            apr_table_get (rec_->headers_in, "Content-Type"),
                            apreq_parse_multipart,
-                           APR_SIZE_MAX /* brigade_limit */,
-                           nullptr /* temp_dir */,
+                           in_buf_->memory_limit () /* brigade_limit */,
+                           td,
                            nullptr /* hook */,
                            nullptr /* ctx */));
 
@@ -713,11 +884,65 @@ namespace web
       if (params == nullptr)
         throw_internal_error (APR_ENOMEM, "apr_table_make");
 
-      // Parse the form data.
+      // Feed the parser the form data chunk by chunk, completing the input
+      // with the end-of-stream bucket. Note that the heap buckets copy the
+      // data, since the parser may hold on to some of it between the calls.
       //
-      apr_status_t r (apreq_parser_run (parser, params, bb));
-      if (r != APR_SUCCESS)
-        throw_bad_request (r);
+      streambuf& sb (*is.rdbuf ());
+      char buf[8192];
+      bool empty (true);
+
+      for (;;)
+      {
+        size_t n (static_cast<size_t> (sb.sgetn (buf, sizeof (buf))));
+
+        if (n == 0 && empty)
+          return nullptr;
+
+        apr_bucket* b (n != 0
+                       ? apr_bucket_heap_create (buf, n, nullptr, ba)
+                       : apr_bucket_eos_create (ba));
+
+        if (b == nullptr)
+          throw_internal_error (APR_ENOMEM,
+                                n != 0
+                                ? "apr_bucket_heap_create"
+                                : "apr_bucket_eos_create");
+
+        APR_BRIGADE_INSERT_TAIL (bb, b);
+
+        // Note that the parser returns APR_INCOMPLETE until it sees the
+        // end-of-stream bucket.
+        //
+        r = apreq_parser_run (parser, params, bb);
+
+        if (n == 0)
+        {
+          if (r != APR_SUCCESS)
+            throw_bad_request (r);
+
+          break;
+        }
+
+        if (r != APR_SUCCESS && r != APR_INCOMPLETE)
+          throw_bad_request (r);
+
+        empty = false;
+      }
+
+      return params;
+    }
+
+    void request::
+    parse_multipart_parameters (const apr_table_t* params)
+    {
+      assert (parameters_ != nullptr && uploads_ == nullptr);
+
+      // Create the file upload stream list, filling it with NULLs for the
+      // parameters parsed from the URL query part.
+      //
+      uploads_.reset (
+        new vector<unique_ptr<istream_buckets>> (parameters_->size ()));
 
       // Fill the parameter and file upload stream lists.
       //
@@ -802,6 +1027,14 @@ namespace web
       return *r;
     }
 
+    void request::
+    read_upload (const string& name, const upload_reader& f)
+    {
+      // Note that all the upload streams are istream_buckets.
+      //
+      static_cast<istream_buckets&> (open_upload (name)).read (f);
+    }
+
     const name_values& request::
     headers ()
     {
@@ -921,7 +1154,17 @@ namespace web
       unique_ptr<streambuf> out_buf (
         buffer
         ? static_cast<streambuf*> (new stringbuf ())
-        : static_cast<streambuf*> (new ostreambuf (rec_, *this)));
+        : static_cast<streambuf*> (new ostreambuf (rec_, *this, compress_)));
+
+      // Note that for the buffered content the encoding header is set by
+      // flush(), if required.
+      //
+      if (!buffer && compress_ != content_coding::identity)
+        apr_table_setn (rec_->headers_out,
+                        "Content-Encoding",
+                        content_encoding (compress_));
+      else
+        apr_table_unset (rec_->headers_out, "Content-Encoding");
 
       out_.reset (new ostream (out_buf.get ()));
       out_buf_ = move (out_buf);
@@ -952,9 +1195,99 @@ namespace web
         out_.reset ();
         out_buf_.reset ();
         ap_set_content_type (rec_, nullptr);
+        apr_table_unset (rec_->headers_out, "Content-Encoding");
       }
     }
 
+    // Return true if the specified content coding is acceptable according
+    // to the Accept-Encoding request header value. Note that we don't
+    // distinguish between the non-zero quality values (and thus prefer
+    // zstd over gzip, if both are acceptable, regardless of the quality
+    // values; see compress() for details).
+    //
+    static bool
+    accept_encoding (const string& h, const char* coding)
+    {
+      optional<bool> r;   // Explicitly (un)acceptable.
+      optional<bool> any; // Any coding (un)acceptable.
+
+      for (size_t b (0), n (h.size ()); b < n; )
+      {
+        size_t e (h.find (',', b));
+        if (e == string::npos)
+          e = n;
+
+        string v (h, b, e - b);
+        b = e + 1;
+
+        double q (1);
+        size_t p (v.find (';'));
+
+        if (p != string::npos)
+        {
+          // Only the quality parameter is defined for Accept-Encoding.
+          //
+          string ps (trim (string (v, p + 1)));
+
+          if (ps.size () > 2 && (ps[0] == 'q' || ps[0] == 'Q') && ps[1] == '=')
+            q = strtod (ps.c_str () + 2, nullptr);
+
+          v.resize (p);
+        }
+
+        trim (v);
+
+        if (icasecmp (v, coding) == 0)
+          r = q > 0;
+        else if (v == "*")
+          any = q > 0;
+      }
+
+      return r ? *r : any ? *any : false;
+    }
+
+    bool request::
+    compress ()
+    {
+      if (state_ >= request_state::writing)
+        throw sequence_error ("web::apache::request::compress");
+
+      // The response depends on the Accept-Encoding request header
+      // regardless of whether it ends up being compressed or not.
+      //
+      apr_table_mergen (rec_->headers_out, "Vary", "Accept-Encoding");
+
+      // Prefer zstd, which compresses better and faster, if acceptable.
+      //
+      const char* ae (apr_table_get (rec_->headers_in, "Accept-Encoding"));
+
+      compress_ = ae == nullptr                ? content_coding::identity :
+                  accept_encoding (ae, "zstd") ? content_coding::zstd     :
+                  accept_encoding (ae, "gzip") ? content_coding::gzip     :
+                                                 content_coding::identity;
+
+      return compress_ != content_coding::identity;
+    }
+
+    size_t request::
+    content_size () const
+    {
+      // Note that we query the put position of the buffered content rather
+      // than its size not to copy the buffer (stringbuf::view() is only
+      // available since C++20).
+      //
+      if (stringbuf* b = dynamic_cast<stringbuf*> (out_buf_.get ()))
+      {
+        streampos p (b->pubseekoff (0, ios::cur, ios::out));
+        return p != streampos (-1) ? static_cast<size_t> (p) : 0;
+      }
+
+      if (const ostreambuf* b = dynamic_cast<ostreambuf*> (out_buf_.get ()))
+        return b->size ();
+
+      return 0;
+    }
+
     void request::
     cookie (const char* name,
             const char* value,
@@ -1001,5 +1334,18 @@ namespace web
       state (request_state::headers);
       apr_table_add (rec_->err_headers_out, "Set-Cookie", s.c_str ());
     }
+
+    void request::
+    header (const char* name, const char* value, bool error)
+    {
+      state (request_state::headers);
+
+      // Note that Apache discards headers_out but not err_headers_out for
+      // the error responses.
+      //
+      apr_table_set (error ? rec_->err_headers_out : rec_->headers_out,
+                     name,
+                     value);
+    }
   }
 }
@@ -4,6 +4,8 @@
 #ifndef WEB_SERVER_APACHE_REQUEST_HXX
 #define WEB_SERVER_APACHE_REQUEST_HXX
 
+#include <apr_tables.h> // apr_table_t
+
 #include <httpd.h> // request_rec, HTTP_*, OK, M_POST
 
 #include <chrono>
@@ -97,7 +99,9 @@ namespace web
       // Get request body data stream.
       //
       virtual std::istream&
-      content (std::size_t limit = 0, std::size_t buffer = 0);
+      content (std::size_t limit = 0,
+               std::size_t buffer = 0,
+               std::size_t memory = 0);
 
       // Get request parameters.
       //
@@ -112,6 +116,9 @@ namespace web
       virtual std::istream&
       open_upload (const std::string& name);
 
+      virtual void
+      read_upload (const std::string& name, const upload_reader&);
+
       // Get request headers.
       //
       virtual const name_values&
@@ -150,12 +157,30 @@ namespace web
               bool secure = false,
               bool buffer = true);
 
+      // Set response header.
+      //
+      virtual void
+      header (const char* name, const char* value, bool error = false);
+
+      // Compress response content if the client accepts the zstd or gzip
+      // content coding, preferring zstd if both are accepted.
+      //
+      virtual bool
+      compress ();
+
+      virtual std::size_t
+      content_size () const;
+
     private:
-      // On the first call cache the application/x-www-form-urlencoded or
-      // multipart/form-data form data for the subsequent parameters parsing
-      // and set the multipart flag accordingly. Don't cache if the request is
-      // in the reading or later state. Return true if the cache contains the
-      // form data.
+      // On the first call cache the application/x-www-form-urlencoded form
+      // data or parse the multipart/form-data form data for the subsequent
+      // parameters parsing and set the multipart flag accordingly. Don't
+      // cache/parse if the request is in the reading or later state. Return
+      // true if the form data is cached/parsed.
+      //
+      // Note that the multipart form data is parsed while being read, with
+      // the large uploads spooled to temporary files, so that the request
+      // content is not held in memory.
       //
       // Note that the function doesn't change the content buffering (see
       // content() function for details) nor rewind the content stream after
@@ -169,8 +194,15 @@ namespace web
       void
       parse_url_parameters (const char* args);
 
+      // Parse the multipart/form-data request content and return the
+      // parsed parameters table or NULL if the content is empty. Throw
+      // invalid_request if the content is malformed.
+      //
+      apr_table_t*
+      parse_multipart_form_data (std::istream&);
+
       void
-      parse_multipart_parameters (const std::vector<char>& body);
+      parse_multipart_parameters (const apr_table_t*);
 
       // Return a list of the upload input streams. Throw sequence_error if
       // the parameters() function was not called yet. Throw invalid_argument
@@ -214,16 +246,24 @@ namespace web
       std::unique_ptr<name_values> headers_;
       std::unique_ptr<name_values> cookies_;
 
-      // Form data cache. Is empty if the body doesn't contain the form data.
+      // Form data cache. Is empty if the body doesn't contain the
+      // application/x-www-form-urlencoded form data.
       //
       std::unique_ptr<std::vector<char>> form_data_;
-      bool form_multipart_; // Meaningless if form_data_ is NULL or empty;
+      bool form_multipart_ = false;
+
+      // Parsed multipart/form-data parameters. Is NULL if the body doesn't
+      // contain the multipart form data. Allocated in the request pool.
+      //
+      apr_table_t* form_params_ = nullptr;
 
       std::unique_ptr<istreambuf_cache> in_buf_;
       std::unique_ptr<std::istream> in_;
 
       std::unique_ptr<std::streambuf> out_buf_;
       std::unique_ptr<std::ostream> out_;
+
+      content_coding compress_ = content_coding::identity;
     };
   }
 }
@@ -1,6 +1,7 @@
 // file      : web/server/apache/request.ixx -*- C++ -*-
 // license   : MIT; see accompanying LICENSE file
 
+#include <apr_tables.h>    // apr_table_setn()
 #include <http_protocol.h> // ap_*()
 
 #include <sstream> // stringbuf
@@ -22,10 +23,23 @@ namespace web
         {
           try
           {
-            state (request_state::writing);
+            if (compress_ != content_coding::identity)
+            {
+              apr_table_setn (rec_->headers_out,
+                              "Content-Encoding",
+                              content_encoding (compress_));
 
-            if (ap_rwrite (s.c_str (), s.length (), rec_) < 0)
-              rec_->status = HTTP_REQUEST_TIME_OUT;
+              ostreambuf b (rec_, *this, compress_);
+              b.sputn (s.c_str (), s.size ());
+              b.finish ();
+            }
+            else
+            {
+              state (request_state::writing);
+
+              if (ap_rwrite (s.c_str (), s.length (), rec_) < 0)
+                rec_->status = HTTP_REQUEST_TIME_OUT;
+            }
           }
           catch (const invalid_request& e)
           {
@@ -36,6 +50,23 @@ namespace web
         out_.reset ();
         out_buf_.reset ();
       }
+      else if (ostreambuf* b = dynamic_cast<ostreambuf*> (out_buf_.get ()))
+      {
+        // Response content is unbuffered. Write the last chunk, if any, and
+        // complete the compressed stream, if the content is compressed.
+        //
+        try
+        {
+          b->finish ();
+        }
+        catch (const invalid_request& e)
+        {
+          rec_->status = e.status;
+        }
+
+        out_.reset ();
+        out_buf_.reset ();
+      }
 
       return rec_->status == HTTP_OK || state_ >= request_state::writing
         ? OK
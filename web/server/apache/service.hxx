@@ -159,7 +159,12 @@ namespace web
       worker_initializer (apr_pool_t*, server_rec* s) noexcept
       {
         auto srv (instance<H> ());
-        log l (s, srv);
+
+        // Note that the log is kept alive for the worker process lifetime,
+        // so that the handler exemplars can also issue diagnostics outside
+        // of the request handling (for example, from background threads).
+        //
+        static log l (s, srv);
         srv->template init_worker<H> (l);
       }
 
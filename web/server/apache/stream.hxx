@@ -7,18 +7,52 @@
 #include <httpd.h>         // request_rec, HTTP_*
 #include <http_protocol.h> // ap_*()
 
+#include <zlib.h>
+#include <zstd.h>
+
 #include <ios>       // streamsize
+#include <memory>    // unique_ptr
+#include <string>
 #include <vector>
 #include <cstring>   // memmove(), size_t
+#include <stdexcept> // runtime_error
 #include <streambuf>
 #include <algorithm> // min(), max()
 
 #include <web/server/module.hxx> // invalid_request
+#include <web/server/gzip-decompressor.hxx>
+#include <web/server/zstd-decompressor.hxx>
 
 namespace web
 {
   namespace apache
   {
+    // Content coding (see the Content-Encoding and Accept-Encoding HTTP
+    // headers).
+    //
+    enum class content_coding
+    {
+      identity, // No compression.
+      zstd,
+      gzip
+    };
+
+    // Return the Content-Encoding header value for the content coding or
+    // NULL for identity.
+    //
+    inline const char*
+    content_encoding (content_coding c)
+    {
+      switch (c)
+      {
+      case content_coding::identity: return nullptr;
+      case content_coding::zstd:     return "zstd";
+      case content_coding::gzip:     return "gzip";
+      }
+
+      return nullptr;
+    }
+
     // Object of a class implementing this interface is intended for keeping
     // the state of communication with the client.
     //
@@ -50,64 +84,279 @@ namespace web
       stream_state& state_;
     };
 
+    // Write the content to the client in chunks of the specified size. The
+    // content is accumulated in the buffer and only passed to Apache when the
+    // buffer is full or the stream is flushed. Note that the write state is
+    // only set when the first chunk is actually passed to Apache, so until
+    // then the response status can still be changed and the content written
+    // so far discarded (see request::status() for details).
+    //
+    // If requested, compress the content using the zstd or gzip algorithm.
+    // In this case finish() must be called after the content is written to
+    // complete the compressed stream.
+    //
     class ostreambuf: public rbuf
     {
     public:
-      ostreambuf (request_rec* r, stream_state& s): rbuf (r, s) {}
+      ostreambuf (request_rec* r,
+                  stream_state& s,
+                  content_coding compress = content_coding::identity,
+                  size_t bufsize = 8192)
+          : rbuf (r, s), buf_ (std::max (bufsize, (size_t)1))
+      {
+        switch (compress)
+        {
+        case content_coding::identity: break;
+        case content_coding::zstd:
+          {
+            zctx_.reset (ZSTD_createCCtx ());
+
+            if (zctx_ == nullptr)
+              throw std::runtime_error (
+                "unable to create zstd compression context");
+
+            zbuf_.resize (ZSTD_CStreamOutSize ());
+            break;
+          }
+        case content_coding::gzip:
+          {
+            gzs_.reset (new z_stream ());
+
+            // Produce the gzip format (rather than zlib or raw deflate).
+            //
+            if (deflateInit2 (gzs_.get (),
+                              Z_DEFAULT_COMPRESSION,
+                              Z_DEFLATED,
+                              16 + MAX_WBITS,
+                              8 /* memLevel */,
+                              Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+              gzs_.reset ();
+              throw std::runtime_error (
+                "unable to initialize gzip compression stream");
+            }
+
+            zbuf_.resize (16384);
+            break;
+          }
+        }
+
+        setp (buf_.data (), buf_.data () + buf_.size ());
+      }
+
+      // Pass the buffered content, if any, to Apache. Note that if the
+      // content is compressed, then the compressor is flushed as well, so
+      // that every chunk reaches the client without delay.
+      //
+      void
+      flush_buffer ()
+      {
+        write (pbase (), pptr () - pbase (), false /* end */);
+        setp (buf_.data (), buf_.data () + buf_.size ());
+      }
+
+      // Pass the buffered content, if any, to Apache and complete the
+      // compressed stream, if the content is compressed.
+      //
+      void
+      finish ()
+      {
+        write (pbase (), pptr () - pbase (), true /* end */);
+        setp (buf_.data (), buf_.data () + buf_.size ());
+      }
+
+      // Return the size of the content written so far (before compression,
+      // if any).
+      //
+      size_t
+      size () const
+      {
+        return size_ + static_cast<size_t> (pptr () - pbase ());
+      }
 
     private:
       virtual int_type
       overflow (int_type c)
       {
+        flush_buffer ();
+
         if (c != traits_type::eof ())
         {
-          state_.set_write_state ();
-
-          char chr (c);
-
-          // Throwing allows to distinguish comm failure from other IO error
-          // conditions.
-          //
-          if (ap_rwrite (&chr, sizeof (chr), rec_) == -1)
-            throw invalid_request (HTTP_REQUEST_TIME_OUT);
+          *pptr () = traits_type::to_char_type (c);
+          pbump (1);
         }
 
-        return c;
+        return traits_type::not_eof (c);
       }
 
       virtual std::streamsize
       xsputn (const char* s, std::streamsize num)
       {
-        state_.set_write_state ();
+        size_t n (static_cast<size_t> (num));
 
-        if (ap_rwrite (s, num, rec_) < 0)
-          throw invalid_request (HTTP_REQUEST_TIME_OUT);
+        // Append the data to the buffer if it fits. Otherwise, write out the
+        // buffered data and either buffer the new data or, if it is too
+        // large, write it directly, bypassing the buffer.
+        //
+        if (n > static_cast<size_t> (epptr () - pptr ()))
+        {
+          flush_buffer ();
+
+          if (n >= buf_.size ())
+          {
+            write (s, n, false /* end */);
+            return num;
+          }
+        }
 
+        std::memcpy (pptr (), s, n);
+        pbump (static_cast<int> (n));
         return num;
       }
 
       virtual int
       sync ()
       {
+        flush_buffer ();
+
         if (ap_rflush (rec_) < 0)
           throw invalid_request (HTTP_REQUEST_TIME_OUT);
 
         return 0;
       }
+
+      // Compress the data, if requested, and pass it to Apache. Flush the
+      // compressor or, if end is true, complete the compressed stream.
+      //
+      void
+      write (const char* s, size_t n, bool end)
+      {
+        size_ += n;
+
+        if (gzs_ != nullptr)
+        {
+          z_stream& z (*gzs_);
+
+          z.next_in = reinterpret_cast<Bytef*> (const_cast<char*> (s));
+          z.avail_in = static_cast<uInt> (n);
+
+          int f (end ? Z_FINISH : Z_SYNC_FLUSH);
+
+          for (;;)
+          {
+            z.next_out = reinterpret_cast<Bytef*> (zbuf_.data ());
+            z.avail_out = static_cast<uInt> (zbuf_.size ());
+
+            int r (deflate (&z, f));
+
+            // Note that Z_BUF_ERROR is not fatal and just means that there
+            // was nothing to flush.
+            //
+            if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+              throw std::runtime_error (
+                "unable to compress response content: " +
+                std::string (z.msg != nullptr ? z.msg : "error"));
+
+            write (zbuf_.data (), zbuf_.size () - z.avail_out);
+
+            // Note that the input is fully consumed and flushed if the
+            // output buffer is not filled up or, when finishing, the end of
+            // the stream is reached.
+            //
+            if (end ? r == Z_STREAM_END : z.avail_out != 0)
+              break;
+          }
+
+          return;
+        }
+
+        if (zctx_ == nullptr)
+        {
+          write (s, n);
+          return;
+        }
+
+        ZSTD_EndDirective e (end ? ZSTD_e_end : ZSTD_e_flush);
+        ZSTD_inBuffer in {s, n, 0};
+
+        for (;;)
+        {
+          ZSTD_outBuffer out {zbuf_.data (), zbuf_.size (), 0};
+
+          size_t r (ZSTD_compressStream2 (zctx_.get (), &out, &in, e));
+
+          if (ZSTD_isError (r))
+            throw std::runtime_error (
+              std::string ("unable to compress response content: ") +
+              ZSTD_getErrorName (r));
+
+          write (zbuf_.data (), out.pos);
+
+          // Note that the input is fully consumed and flushed when the
+          // returned value is zero.
+          //
+          if (r == 0)
+            break;
+        }
+      }
+
+      void
+      write (const char* s, size_t n)
+      {
+        if (n != 0)
+        {
+          state_.set_write_state ();
+
+          // Throwing allows to distinguish comm failure from other IO error
+          // conditions.
+          //
+          if (ap_rwrite (s, static_cast<int> (n), rec_) < 0)
+            throw invalid_request (HTTP_REQUEST_TIME_OUT);
+        }
+      }
+
+    private:
+      std::vector<char> buf_;
+      size_t size_ = 0;
+
+      struct zctx_deleter
+      {
+        void operator() (ZSTD_CCtx* c) const {ZSTD_freeCCtx (c);}
+      };
+
+      struct gzs_deleter
+      {
+        void operator() (z_stream* s) const {deflateEnd (s); delete s;}
+      };
+
+      std::unique_ptr<ZSTD_CCtx, zctx_deleter> zctx_;
+      std::unique_ptr<z_stream, gzs_deleter> gzs_;
+      std::vector<char> zbuf_; // Compressed data buffer.
     };
 
+    // Read the content from the client. If requested, decompress the zstd-
+    // or gzip-compressed content (see the Content-Encoding request header).
+    //
     class istreambuf: public rbuf
     {
     public:
       istreambuf (request_rec* r,
                   stream_state& s,
                   size_t bufsize = 1024,
-                  size_t putback = 1)
+                  size_t putback = 1,
+                  content_coding decompress = content_coding::identity)
           : rbuf (r, s),
             bufsize_ (std::max (bufsize, (size_t)1)),
             putback_ (std::min (putback, bufsize_ - 1)),
             buf_ (bufsize_)
       {
+        switch (decompress)
+        {
+        case content_coding::identity:                                  break;
+        case content_coding::zstd: zd_.reset (new zstd_decompressor ()); break;
+        case content_coding::gzip: gd_.reset (new gzip_decompressor ()); break;
+        }
+
         char* p (buf_.data () + putback_);
         setg (p, p, p);
       }
@@ -125,22 +374,48 @@ namespace web
         std::memmove (buf_.data () + putback_ - pb, gptr () - pb, pb);
 
         char* p (buf_.data () + putback_);
-        int rb (ap_get_client_block (rec_, p, bufsize_ - putback_));
+        size_t rb (read (p, bufsize_ - putback_));
 
         if (rb == 0)
           return traits_type::eof ();
 
+        setg (p - pb, p, p + rb);
+        return traits_type::to_int_type (*gptr ());
+      }
+
+    private:
+      // Read up to the specified number of bytes into the buffer, decompress
+      // them if requested. Return 0 on the end of the content.
+      //
+      size_t
+      read (char* p, size_t n)
+      {
+        auto rb = [this] (char* b, size_t s) {return read_block (b, s);};
+
+        return zd_ != nullptr ? zd_->read (p, n, rb) :
+               gd_ != nullptr ? gd_->read (p, n, rb) :
+               read_block (p, n);
+      }
+
+      size_t
+      read_block (char* p, size_t n)
+      {
+        int rb (ap_get_client_block (rec_, p, n));
+
         if (rb < 0)
           throw invalid_request (HTTP_REQUEST_TIME_OUT);
 
-        setg (p - pb, p, p + rb);
-        return traits_type::to_int_type (*gptr ());
+        return static_cast<size_t> (rb);
       }
 
     protected:
       size_t bufsize_;
       size_t putback_;
       std::vector<char> buf_;
+
+    private:
+      std::unique_ptr<zstd_decompressor> zd_;
+      std::unique_ptr<gzip_decompressor> gd_;
     };
   }
 }
@@ -0,0 +1,135 @@
+// file      : web/server/gzip-decompressor.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef WEB_SERVER_GZIP_DECOMPRESSOR_HXX
+#define WEB_SERVER_GZIP_DECOMPRESSOR_HXX
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>   // size_t
+#include <stdexcept> // runtime_error
+
+#include <web/server/module.hxx> // invalid_request
+
+namespace web
+{
+  // Incremental decompressor of the gzip-compressed request content.
+  //
+  // Note that the interface is the same as of zstd_decompressor (see
+  // zstd-decompressor.hxx for details).
+  //
+  class gzip_decompressor
+  {
+  public:
+    // Throw runtime_error if unable to initialize the decompression stream.
+    //
+    gzip_decompressor ()
+        : buf_ (16384)
+    {
+      // Only accept the gzip format (rather than zlib or raw deflate).
+      //
+      if (inflateInit2 (&zs_, 16 + MAX_WBITS) != Z_OK)
+        throw std::runtime_error (
+          "unable to initialize gzip decompression stream");
+    }
+
+    ~gzip_decompressor () {inflateEnd (&zs_);}
+
+    gzip_decompressor (const gzip_decompressor&) = delete;
+    gzip_decompressor& operator= (const gzip_decompressor&) = delete;
+
+    // Decompress up to the specified number of bytes into the buffer,
+    // reading the compressed content with the size_t read_block (char*,
+    // size_t) function which returns 0 on the end of the content. Return 0
+    // on the end of the decompressed content.
+    //
+    // Throw invalid_request (400) if the content is invalid or truncated.
+    //
+    template <typename F>
+    std::size_t
+    read (char* p, std::size_t n, F&& read_block)
+    {
+      for (;;)
+      {
+        // Similar to zstd_decompressor, drain the decompressed data the
+        // stream may still hold if the output buffer was filled up by the
+        // previous call before reading more input.
+        //
+        if (zs_.avail_in == 0 && !flush_)
+        {
+          std::size_t rb (read_block (buf_.data (), buf_.size ()));
+
+          if (rb == 0)
+          {
+            // Fail if the end of the content is reached in the middle of the
+            // gzip member.
+            //
+            if (!end_)
+              throw invalid_request (400,
+                                     "truncated compressed request content");
+
+            return 0;
+          }
+
+          zs_.next_in = reinterpret_cast<Bytef*> (buf_.data ());
+          zs_.avail_in = static_cast<uInt> (rb);
+        }
+
+        // Start the next member, if the content is a concatenation of
+        // multiple gzip members (see RFC 1952 for details).
+        //
+        if (end_ && zs_.avail_in != 0)
+        {
+          if (inflateReset (&zs_) != Z_OK)
+            throw invalid_request (400, "invalid compressed request content");
+
+          end_ = false;
+        }
+
+        zs_.next_out = reinterpret_cast<Bytef*> (p);
+        zs_.avail_out = static_cast<uInt> (n);
+
+        int r (inflate (&zs_, Z_NO_FLUSH));
+
+        // Note that Z_BUF_ERROR is not fatal and just means that no progress
+        // was possible (no more input while the output buffer is filled up,
+        // etc).
+        //
+        if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+          throw invalid_request (400,
+                                 std::string (
+                                   "invalid compressed request content: ") +
+                                 (zs_.msg != nullptr ? zs_.msg : "error"));
+
+        std::size_t w (n - zs_.avail_out); // Decompressed bytes.
+
+        // If the stream is at the end of the member, then it can't hold any
+        // more decompressed data. Otherwise, it may if the output buffer is
+        // filled up.
+        //
+        end_ = (r == Z_STREAM_END);
+        flush_ = (!end_ && zs_.avail_out == 0);
+
+        if (w != 0)
+          return w;
+
+        // Fail if no progress is possible with the input we have and the
+        // output buffer is not full (shouldn't happen but let's not loop
+        // forever).
+        //
+        if (r == Z_BUF_ERROR && zs_.avail_in != 0)
+          throw invalid_request (400, "invalid compressed request content");
+      }
+    }
+
+  private:
+    z_stream zs_ {};
+    std::vector<char> buf_;
+    bool end_ = true;    // gzip member is complete.
+    bool flush_ = false; // Stream may hold some decompressed data.
+  };
+}
+
+#endif // WEB_SERVER_GZIP_DECOMPRESSOR_HXX
@@ -4,37 +4,110 @@
 #include <web/server/mime-url-encoding.hxx>
 
 #include <string>
-#include <iterator> // back_inserter
-
-#include <libbutl/url.hxx>
+#include <cstring>   // strlen(), memchr()
+#include <stdexcept> // invalid_argument
 
 using namespace std;
-using namespace butl;
 
 namespace web
 {
-  inline static bool
-  encode_query (char& c)
+  // Character classes for URL encoding/decoding.
+  //
+  // Note that the tables are indexed with the unsigned char values and so
+  // the characters with the high bit set are always encoded.
+  //
+  enum: unsigned char
+  {
+    unreserved = 0x01, // ALPHA / DIGIT / "-" / "." / "_" / "~" (RFC3986).
+    special    = 0x02  // Characters requiring special decoding: '%', '+'.
+  };
+
+  struct char_table
   {
-    if (c == ' ')
+    unsigned char classes[256];
+    signed char   digits[256]; // Hex digit values or -1.
+
+    char_table ()
     {
-      c = '+';
-      return false;
+      for (size_t i (0); i != 256; ++i)
+      {
+        char c (static_cast<char> (i));
+
+        classes[i] = ((c >= 'a' && c <= 'z') ||
+                      (c >= 'A' && c <= 'Z') ||
+                      (c >= '0' && c <= '9') ||
+                      c == '-' || c == '.' || c == '_' || c == '~')
+          ? unreserved
+          : (c == '%' || c == '+' ? special : 0);
+
+        digits[i] = c >= '0' && c <= '9' ? c - '0'      :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 :
+                    -1;
+      }
     }
+  };
+
+  static const char_table table;
 
-    return !url::unreserved (c);
+  static const char hex_digits[] = "0123456789ABCDEF";
+
+  void
+  mime_url_encode (const char* v, size_t n, string& r, bool query)
+  {
+    const unsigned char* b (reinterpret_cast<const unsigned char*> (v));
+    const unsigned char* e (b + n);
+
+    // In the worst case every character is percent-encoded, however,
+    // normally the value contains mostly unreserved characters. Thus, we
+    // reserve just the value size which, in particular, preserves the small
+    // string optimization for short values.
+    //
+    r.reserve (r.size () + n);
+
+    while (b != e)
+    {
+      // Find the end of the run of the unreserved characters and append it
+      // as a whole. Note that this loop only consults the table and so can
+      // be unrolled/vectorized by the compiler.
+      //
+      const unsigned char* p (b);
+      for (; p != e && (table.classes[*p] & unreserved) != 0; ++p) ;
+
+      if (p != b)
+      {
+        r.append (reinterpret_cast<const char*> (b), p - b);
+
+        if ((b = p) == e)
+          break;
+      }
+
+      unsigned char c (*b++);
+
+      if (query && c == ' ')
+        r += '+';
+      else
+      {
+        char d[3] {'%', hex_digits[c >> 4], hex_digits[c & 0x0F]};
+        r.append (d, 3);
+      }
+    }
   }
 
   string
   mime_url_encode (const char* v, bool query)
   {
-    return query ? url::encode (v, encode_query) : url::encode (v);
+    string r;
+    mime_url_encode (v, strlen (v), r, query);
+    return r;
   }
 
   string
   mime_url_encode (const string& v, bool query)
   {
-    return query ? url::encode (v, encode_query) : url::encode (v);
+    string r;
+    mime_url_encode (v.c_str (), v.size (), r, query);
+    return r;
   }
 
   string
@@ -52,15 +125,61 @@ namespace web
     }
 
     string r;
-    if (!query)
-      url::decode (b, e, back_inserter (r));
-    else
-      url::decode (b, e, back_inserter (r),
-                   [] (char& c)
-                   {
-                     if (c == '+')
-                       c = ' ';
-                   });
+    r.reserve (e - b);
+
+    while (b != e)
+    {
+      // Find the end of the run of characters that don't require decoding
+      // and append it as a whole. In the non-query mode only the percent
+      // character is special and so we can use memchr().
+      //
+      const char* p;
+
+      if (query)
+      {
+        for (p = b;
+             p != e &&
+               (table.classes[static_cast<unsigned char> (*p)] & special) == 0;
+             ++p) ;
+      }
+      else
+      {
+        p = static_cast<const char*> (memchr (b, '%', e - b));
+
+        if (p == nullptr)
+          p = e;
+      }
+
+      if (p != b)
+      {
+        r.append (b, p - b);
+
+        if ((b = p) == e)
+          break;
+      }
+
+      if (*b == '+')
+      {
+        r += ' ';
+        ++b;
+        continue;
+      }
+
+      // Decode the percent-encoded sequence.
+      //
+      if (e - b < 3)
+        throw invalid_argument ("no hex digits");
+
+      signed char h (table.digits[static_cast<unsigned char> (b[1])]);
+      signed char l (table.digits[static_cast<unsigned char> (b[2])]);
+
+      if (h < 0 || l < 0)
+        throw invalid_argument ("invalid hex digit");
+
+      r += static_cast<char> ((h << 4) | l);
+      b += 3;
+    }
+
     return r;
   }
 }
@@ -5,6 +5,7 @@
 #define WEB_SERVER_MIME_URL_ENCODING_HXX
 
 #include <string>
+#include <cstddef> // size_t
 
 namespace web
 {
@@ -19,6 +20,13 @@ namespace web
   std::string
   mime_url_encode (const std::string&, bool query = true);
 
+  // As above but append the encoded value to the specified string. This
+  // way the caller can reuse the string buffer when encoding multiple
+  // values.
+  //
+  void
+  mime_url_encode (const char*, std::size_t, std::string&, bool query = true);
+
   // If the query flag is true, then convert plus characters to space
   // characters (see above). Throw std::invalid_argument if an invalid encoding
   // sequence is encountered.
@@ -9,6 +9,7 @@
 #include <vector>
 #include <iosfwd>
 #include <chrono>
+#include <functional>
 #include <memory>    // enable_shared_from_this
 #include <cstdint>   // uint16_t
 #include <cstddef>   // size_t
@@ -134,6 +135,19 @@ namespace web
     virtual std::istream&
     open_upload (const std::string& name) = 0;
 
+    // Read the upload data for the specified parameter name (see above for
+    // the semantics) and pass it to the specified function in contiguous
+    // blocks, as they are stored by the implementation. Compared to reading
+    // from the upload stream, this avoids copying the data into the
+    // intermediate buffers, which can be significant for large uploads.
+    //
+    // Note that the data is consumed from the respective upload stream.
+    //
+    using upload_reader = std::function<void (const char*, std::size_t)>;
+
+    virtual void
+    read_upload (const std::string& name, const upload_reader&) = 0;
+
     // Request headers.
     //
     // The implementation may add custom pseudo-headers reflecting additional
@@ -158,13 +172,25 @@ namespace web
     // is zero, then the buffer size is left unchanged (zero initially). If it
     // is impossible to increase the buffer size (because, for example, some
     // content is already read unbuffered), then the sequence_error is thrown.
+    // If the memory argument is zero, then the maximum size of the buffered
+    // content kept in memory is left unchanged (implementation-specific
+    // initially). Otherwise, the requested size is set and the buffered
+    // content beyond it may be kept by the implementation in a temporary
+    // file rather than in memory. The same applies to each upload of the
+    // multipart form data (see parameters() for details).
     //
     // Note that unread input content is discarded when any unbuffered content
     // is written, and any attempt to read it will result in the
     // sequence_error exception being thrown.
     //
+    // Also note that the compressed content (see the Content-Encoding request
+    // header) may be decompressed by the implementation transparently, in
+    // which case the limit applies to the decompressed content.
+    //
     virtual std::istream&
-    content (std::size_t limit, std::size_t buffer = 0) = 0;
+    content (std::size_t limit,
+             std::size_t buffer = 0,
+             std::size_t memory = 0) = 0;
   };
 
   class response
@@ -189,6 +215,15 @@ namespace web
     // that the user will be notified of an error or observe the
     // new status.
     //
+    // The unbuffered (streaming) content is sent to the client in
+    // fixed-size chunks as it is written, which keeps the memory usage
+    // bounded and reduces the time to first byte for large pages. The
+    // content is only considered written once the first chunk is
+    // sent. Thus, to be able to report errors properly, a handler that
+    // streams its response should perform all the fallible work (for
+    // example, database queries, which may also need to be retried)
+    // before it starts writing the content.
+    //
     virtual std::ostream&
     content (status_code code = 200,
              const std::string& type = "application/xhtml+xml;charset=utf-8",
@@ -212,6 +247,38 @@ namespace web
             const char* domain = nullptr,
             bool secure = false,
             bool buffer = true) = 0;
+
+    // Set response header, replacing the existing value, if any. Throw
+    // sequence_error if some unbuffered content has already been written.
+    //
+    // Note that the header is not discarded on the status change and so
+    // should only be set once the handler is certain of the response
+    // status. Also note that unless error is true, the header is only sent
+    // with the successful (2xx) responses. If it is true, then the header is
+    // also sent with the error responses (for example, Content-Range with
+    // 416).
+    //
+    virtual void
+    header (const char* name, const char* value, bool error = false) = 0;
+
+    // Compress the content if the client accepts the compressed response
+    // (according to the Accept-Encoding request header) and return true if
+    // that's the case. Throw sequence_error if some unbuffered content has
+    // already been written.
+    //
+    // Note that compression only applies to the content streams returned by
+    // the subsequent content() calls and so this function should normally
+    // be called before content().
+    //
+    virtual bool
+    compress () = 0;
+
+    // Return the size of the content written so far into the stream returned
+    // by the last content() call (before compression, if any). Return zero
+    // if no content has been written or it has been discarded.
+    //
+    virtual std::size_t
+    content_size () const = 0;
   };
 
   // A web server logging backend. The handler can use it to log
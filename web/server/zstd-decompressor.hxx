@@ -0,0 +1,106 @@
+// file      : web/server/zstd-decompressor.hxx -*- C++ -*-
+// license   : MIT; see accompanying LICENSE file
+
+#ifndef WEB_SERVER_ZSTD_DECOMPRESSOR_HXX
+#define WEB_SERVER_ZSTD_DECOMPRESSOR_HXX
+
+#include <zstd.h>
+
+#include <memory>    // unique_ptr
+#include <string>
+#include <vector>
+#include <cstddef>   // size_t
+#include <stdexcept> // runtime_error
+
+#include <web/server/module.hxx> // invalid_request
+
+namespace web
+{
+  // Incremental decompressor of the zstd-compressed request content.
+  //
+  class zstd_decompressor
+  {
+  public:
+    // Throw runtime_error if unable to create the decompression context.
+    //
+    zstd_decompressor ()
+        : ctx_ (ZSTD_createDCtx ())
+    {
+      if (ctx_ == nullptr)
+        throw std::runtime_error (
+          "unable to create zstd decompression context");
+
+      buf_.resize (ZSTD_DStreamInSize ());
+    }
+
+    // Decompress up to the specified number of bytes into the buffer,
+    // reading the compressed content with the size_t read_block (char*,
+    // size_t) function which returns 0 on the end of the content. Return 0
+    // on the end of the decompressed content.
+    //
+    // Throw invalid_request (400) if the content is invalid or truncated.
+    //
+    template <typename F>
+    std::size_t
+    read (char* p, std::size_t n, F&& read_block)
+    {
+      for (;;)
+      {
+        // Note that if the output buffer was filled up by the previous call
+        // then the decompressor may still hold some decompressed data even
+        // if all the input is consumed. Thus, we first drain it by calling
+        // the decompressor with no new input and only read more input (or
+        // detect the end of the content) once no more output is produced.
+        //
+        if (in_.pos == in_.size && !flush_)
+        {
+          std::size_t rb (read_block (buf_.data (), buf_.size ()));
+
+          if (rb == 0)
+          {
+            // Fail if the end of the content is reached in the middle of the
+            // compressed frame.
+            //
+            if (!end_)
+              throw invalid_request (400,
+                                     "truncated compressed request content");
+
+            return 0;
+          }
+
+          in_ = ZSTD_inBuffer {buf_.data (), rb, 0};
+        }
+
+        ZSTD_outBuffer out {p, n, 0};
+
+        std::size_t r (ZSTD_decompressStream (ctx_.get (), &out, &in_));
+
+        if (ZSTD_isError (r))
+          throw invalid_request (400,
+                                 std::string (
+                                   "invalid compressed request content: ") +
+                                 ZSTD_getErrorName (r));
+
+        end_ = (r == 0);
+        flush_ = (!end_ && out.pos == out.size);
+
+        if (out.pos != 0)
+          return out.pos;
+      }
+    }
+
+  private:
+    struct ctx_deleter
+    {
+      void operator() (ZSTD_DCtx* c) const {ZSTD_freeDCtx (c);}
+    };
+
+    std::unique_ptr<ZSTD_DCtx, ctx_deleter> ctx_;
+    std::vector<char> buf_;
+    ZSTD_inBuffer in_ {nullptr, 0, 0};
+    bool end_ = true;    // Compressed frame is complete.
+    bool flush_ = false; // Decompressor may hold some decompressed data.
+  };
+}
+
+#endif // WEB_SERVER_ZSTD_DECOMPRESSOR_HXX
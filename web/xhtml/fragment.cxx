@@ -4,7 +4,10 @@
 #include <web/xhtml/fragment.hxx>
 
 #include <string>
+#include <ostream>
+#include <sstream>
 #include <cassert>
+#include <utility> // move()
 
 #include <libstudxml/parser.hxx>
 #include <libstudxml/serializer.hxx>
@@ -102,9 +105,91 @@ namespace web
       events_.pop_back ();
     }
 
+    fragment fragment::
+    raw (string xhtml, bool truncated)
+    {
+      fragment r;
+      r.truncated = truncated;
+      r.raw_ = true;
+      r.markup_ = move (xhtml);
+      return r;
+    }
+
+    string fragment::
+    markup () const
+    {
+      if (raw_)
+        return markup_;
+
+      if (events_.empty ())
+        return string ();
+
+      // Serialize the fragment wrapping it with the root element, which
+      // declares the XHTML namespace as default (as does the <html> element),
+      // and then unwrap it.
+      //
+      ostringstream os;
+      {
+        serializer s (os, "fragment", 0 /* indentation */);
+
+        s.start_element (xmlns, "d");
+        s.namespace_decl (xmlns, "");
+        (*this) (s);
+        s.end_element ();
+      }
+
+      string r (os.str ());
+
+      size_t b (r.find ('>'));
+      size_t e (r.rfind ('<'));
+
+      assert (b != string::npos && e != string::npos && b < e);
+
+      return string (r, b + 1, e - b - 1);
+    }
+
+    size_t fragment::
+    memory_size () const
+    {
+      size_t r (sizeof (*this) + events_.capacity () * sizeof (events_[0]) +
+                markup_.capacity ());
+
+      for (const auto& e: events_)
+        r += e.second.capacity ();
+
+      return r;
+    }
+
+    void fragment::
+    operator() (serializer& s, ostream& os) const
+    {
+      if (!raw_)
+      {
+        (*this) (s);
+        return;
+      }
+
+      if (markup_.empty ())
+        return;
+
+      // Close the current element start tag, if any, writing the empty
+      // character data.
+      //
+      s.characters ("");
+
+      os.write (markup_.c_str (), markup_.size ());
+    }
+
     void fragment::
     operator() (serializer& s) const
     {
+      if (raw_)
+      {
+        fragment f (markup_, "raw-fragment");
+        f (s);
+        return;
+      }
+
       for (const auto& e: events_)
       {
         switch (e.first)
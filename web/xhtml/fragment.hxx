@@ -6,6 +6,7 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>  // ostream
 #include <utility> // pair
 
 #include <libstudxml/parser.hxx>
@@ -18,6 +19,11 @@ namespace web
     // A parsed (via xml::parser) XHTML fragment that can later be serialized
     // to xml::serializer.
     //
+    // Alternatively, a raw fragment which contains the trusted pre-rendered
+    // XHTML (normally produced by serializing a parsed fragment, see
+    // markup()) and which is spliced into the serializer output stream as is,
+    // without reparsing.
+    //
     class fragment
     {
     public:
@@ -37,13 +43,47 @@ namespace web
                 const std::string& input_name,
                 size_t length = 0);
 
+      // Create the raw fragment from the trusted XHTML. The fragment should
+      // be well-formed, in the same sense as above, and have all the special
+      // characters escaped. It is not parsed or validated.
+      //
+      static fragment
+      raw (std::string xhtml, bool truncated = false);
+
+      // Serialize the fragment. Note that the raw fragment is parsed on each
+      // call, so normally the following version should be used for it.
+      //
       void
       operator() (xml::serializer&) const;
 
+      // As above but write the raw fragment directly into the stream the
+      // serializer writes to, closing the current element start tag, if
+      // required. Note that the serializer indentation should be suspended
+      // not to end up with the messed up output.
+      //
+      void
+      operator() (xml::serializer&, std::ostream&) const;
+
+      // Return the fragment as XHTML, serializing it if it is not raw.
+      //
+      std::string
+      markup () const;
+
+      bool
+      raw () const {return raw_;}
+
       bool
-      empty () const {return events_.empty ();}
+      empty () const {return raw_ ? markup_.empty () : events_.empty ();}
+
+      // Return the approximate amount of memory occupied by the fragment.
+      //
+      size_t
+      memory_size () const;
 
     private:
+      bool raw_ = false;
+      std::string markup_; // Raw fragment XHTML.
+
       std::vector<std::pair<xml::parser::event_type, std::string>> events_;
     };
   }